@@ -0,0 +1,22 @@
+; Dsp restore code, see dsprestore.h
+; Origin: wherever LoadAPU puts the bootcode
+; Length: 12
+;
+; LoadAPU looks for room for this, the bootcode and the 128 dsp
+; registers in one place:
+;
+;   +0    this code
+;   +12   bootcode (77 bytes)
+;   +89   dsp register image
+;
+; apu_endTransfer jumps here instead of to the bootcode. The image
+; carries the muted FLG and KON=0 the dsploader used to write, so
+; nothing plays and the echo stays off until the bootcode sets the
+; real ones.
+
+p0000: MOV  X , #$0        ; dsp register, same order as the dsploader
+p0002: MOV  $f2 , X
+p0004: MOV  A , !$0000+X   ; $0005-$0006: image address
+p0007: MOV  $f3 , A
+p0009: INC  X
+p000a: BPL  p0002          ; until X reaches $80
@@ -0,0 +1,36 @@
+; Fast upload loader, see fastloader.h
+; Origin: $0002
+; Length: 42
+;
+; Takes over from the IPL rom for 0100-ffff: the host puts three
+; bytes on ports 1-3, then the handshake counter on port 0. The
+; loader stores the three bytes and echoes the counter on port 0.
+; 65280 bytes are exactly 21760 handshakes, so the pointer wraps to
+; 0000 on the last one and the loader jumps back into the rom, which
+; waits for a new $CC transfer like after reset. That last handshake
+; is not echoed: the rom overwrites Port0 with $AA right away, so the
+; host waits for the $AA instead.
+
+p0002: MOV  $0 , #$0       ; destination pointer ($00-$01)
+p0005: MOV  $1 , #$1       ; starts at $0100
+p0008: MOV  Y , #$0        ; always 0, [dp]+Y is the only indirect store
+p000a: MOV  X , #$0        ; handshake counter
+p000c: CMP  X , $f4        
+p000e: BNE  p000c          ; wait until Port0 equals the counter
+p0010: MOV  A , $f5        ; Port1
+p0012: MOV  [$0]+Y , A     
+p0014: INCW $0             
+p0016: MOV  A , $f6        ; Port2
+p0018: MOV  [$0]+Y , A     
+p001a: INCW $0             
+p001c: MOV  A , $f7        ; Port3
+p001e: MOV  [$0]+Y , A     
+p0020: INCW $0             ; sets Z when the pointer wraps to 0000
+p0022: BEQ  p0029          
+p0024: MOV  $f4 , X        ; acknowledge
+p0026: INC  X              
+p0027: BRA  p000c          
+
+; Re-enter the rom after its zero page clearing loop, as the
+; dsploader does
+p0029: JMP  $ffc9          
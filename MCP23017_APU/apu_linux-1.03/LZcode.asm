@@ -0,0 +1,125 @@
+; Compressed upload loader, see lzloader.h and spcpack.h
+; Origin: $0002
+; Length: 189
+;
+; Takes over from the IPL rom for 0200-ffff. The stream arrives like
+; with the fast loader: three bytes on ports 1-3, then the handshake
+; counter on port 0. The counter is echoed as soon as the bytes are
+; copied out, so the host sends the next three while the loader is
+; still expanding.
+;
+; The loader calls getb for every stream byte, so its stack in page 1
+; must stay intact: the stream starts at 0200 and the host sends page 1
+; through the rom once the loader is done.
+;
+; Zero page use: 00-01 destination, e2 bytes left in e4-e6, e3
+; handshake counter, e7 sum high byte, e8-eb copy source and distance.
+
+p0002: MOV  $0 , #$0       ; destination pointer, [00]+Y
+p0005: MOV  $1 , #$2       ; starts at 0200
+p0008: MOV  $e2 , #$0      ; bytes left in the port buffer
+p000b: MOV  $e3 , #$0      ; handshake counter
+p000e: MOV  Y , #$0
+
+; Control byte: 00-7f are c+1 literal bytes
+p0010: CALL p009b          ; control byte
+p0013: CMP  A , #$80
+p0015: BCS  p002a
+p0017: MOV  X , A
+p0018: INC  X              ; literal: c+1 bytes
+p0019: CALL p009b
+p001c: MOV  [$0]+Y , A
+p001e: INC  Y
+p001f: BNE  p0025
+p0021: INC  $1
+p0023: BEQ  p006e          ; wrapped past ffff
+p0025: DEC  X
+p0026: BNE  p0019
+p0028: BRA  p0010
+
+; 80-bf run, c0-ff copy, both (c & 3f) + 3 bytes long
+p002a: CMP  A , #$c0       ; C stays set for copies
+p002c: AND  A , #$3f
+p002e: MOV  X , A
+p002f: INC  X
+p0030: INC  X
+p0031: INC  X              ; (c & 3f) + 3 bytes
+p0032: BCS  p0045
+p0034: CALL p009b          ; run: the value
+p0037: MOV  [$0]+Y , A
+p0039: INC  Y
+p003a: BNE  p0040
+p003c: INC  $1
+p003e: BEQ  p006e
+p0040: DEC  X
+p0041: BNE  p0037
+p0043: BRA  p0010
+
+; Copy: the source pointer is set up so that [e8]+Y walks along
+; with [00]+Y, distance bytes behind it. Overlapping copies repeat
+; a pattern, as in any LZ77.
+p0045: CALL p009b          ; copy: distance back
+p0048: MOV  $ea , A
+p004a: CALL p009b
+p004d: MOV  $eb , A
+p004f: MOV  A , #$0        ; [e8]+Y = destination - distance
+p0051: SETC
+p0052: SBC  A , $ea
+p0054: MOV  $e8 , A
+p0056: MOV  A , $1
+p0058: SBC  A , $eb
+p005a: MOV  $e9 , A
+p005c: MOV  A , [$e8]+Y
+p005e: MOV  [$0]+Y , A
+p0060: INC  Y
+p0061: BNE  p0069
+p0063: INC  $1
+p0065: BEQ  p006e
+p0067: INC  $e9
+p0069: DEC  X
+p006a: BNE  p005c
+p006c: BRA  p0010
+
+; The pointer wrapped: everything is in place. Sum 0200-ffbf for
+; the host to compare, ffc0-ffff reads back as the rom.
+p006e: MOV  $1 , #$2       ; 16 bit sum of 0200-ffbf, the
+p0071: MOV  A , #$0        ; rom hides ffc0-ffff
+p0073: MOV  $e7 , #$0
+p0076: CLRC
+p0077: ADC  A , [$0]+Y
+p0079: BCC  p007d
+p007b: INC  $e7
+p007d: INC  Y
+p007e: BNE  p0076
+p0080: INC  $1
+p0082: CMP  $1 , #$ff
+p0085: BNE  p0076
+p0087: CLRC
+p0088: ADC  A , [$0]+Y
+p008a: BCC  p008e
+p008c: INC  $e7
+p008e: INC  Y
+p008f: CMP  Y , #$c0
+p0091: BNE  p0087
+p0093: MOV  $f6 , A        ; sum on ports 2 and 3,
+p0095: MOV  $f7 , $e7      ; the rom only sets 0 and 1
+p0098: JMP  $ffc9
+
+; getb: next stream byte in A, keeps X and Y. e4-e6 hold what is
+; left of the last three port bytes, e2 how many.
+p009b: DEC  $e2            ; next stream byte in A
+p009d: BPL  p00b6
+p009f: MOV  A , $e3
+p00a1: CMP  A , $f4
+p00a3: BNE  p00a1
+p00a5: MOV  $e4 , $f5
+p00a8: MOV  $e5 , $f6
+p00ab: MOV  $e6 , $f7
+p00ae: MOV  $f4 , A        ; ack at once, the host sends
+p00b0: INC  A              ; the next three meanwhile
+p00b1: MOV  $e3 , A
+p00b3: MOV  $e2 , #$2
+p00b6: MOV  A , $e4
+p00b8: MOV  $e4 , $e5
+p00bb: MOV  $e5 , $e6
+p00be: RET
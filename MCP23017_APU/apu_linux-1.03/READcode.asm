@@ -0,0 +1,47 @@
+; Snapshot transmit loader, see readloader.h
+; Origin: $0002
+; Length: 66
+;
+; The fast loader in reverse: the loader puts the bytes on the ports,
+; then the handshake counter on port 0, and waits for the host to
+; write the counter back. The dsp registers come first, read through
+; f2/f3, then 0100-ffff. The rom is switched off meanwhile so ffc0-ffff
+; reads the ram under it. The zero page is not sent: the rom cleared
+; it on reset and the loader lives there.
+
+p0002: MOV  X , #$0        ; handshake counter
+p0004: MOV  Y , #$0        ; dsp address
+
+; One dsp register per handshake, on port 1
+p0006: MOV  $f2 , Y
+p0008: MOV  A , $f3
+p000a: MOV  $f5 , A
+p000c: MOV  $f4 , X        ; register ready
+p000e: CMP  X , $f4
+p0010: BNE  p000e          ; wait for the host to echo it
+p0012: INC  X
+p0013: INC  Y
+p0014: BPL  p0006          ; 128 registers
+p0016: MOV  $f1 , #$0      ; rom off, ffc0-ffff reads the ram
+p0019: MOV  $0 , #$0       ; source pointer
+p001c: MOV  $1 , #$1       ; starts at 0100
+p001f: MOV  Y , #$0
+
+; 0100-ffff, three bytes per handshake on ports 1-3
+p0021: MOV  A , [$0]+Y
+p0023: MOV  $f5 , A
+p0025: INCW $0
+p0027: MOV  A , [$0]+Y
+p0029: MOV  $f6 , A
+p002b: INCW $0
+p002d: MOV  A , [$0]+Y
+p002f: MOV  $f7 , A
+p0031: INCW $0
+p0033: MOV  $f4 , X        ; bytes ready
+p0035: CMP  X , $f4
+p0037: BNE  p0035
+p0039: INC  X
+p003a: MOV  A , $1         ; 0000 once the pointer wraps
+p003c: BNE  p0021
+p003e: MOV  $f1 , #$80     ; rom back on
+p0041: JMP  $ffc9          ; back into the rom
@@ -0,0 +1,81 @@
+; Streaming loader, see streamloader.h
+; Origin: $0002
+; Length: 108
+;
+; Takes over from the IPL rom for 0100-ffff like the fast loader, but
+; does not echo every port 0 change. The host writes three bytes on
+; ports 1-3 and then a new value on port 0, and simply waits long
+; enough before the next three. The loader is never held up by
+; anything, so its cycle count tells how long that is.
+;
+; Data comes in blocks of 64 triples behind a header triple with the
+; address. At the end of a block the loader puts two running sums on
+; ports 1 and 2 and echoes port 0. A block that arrived damaged is
+; sent again, with the same header, so nothing else is needed to
+; rewind.
+;
+; Sums, per byte b, with the carry cleared at the start of a triple:
+;   s1 = s1 + b + C
+;   s2 = s2 + s1 + C
+
+p0002: MOV  X , #$0        ; last port 0 value seen
+
+; Calibration: once port 0 is 0, run a fixed delay and echo.
+; The host times it to learn how fast this spc700 runs.
+p0004: CMP  X , $f4        ; the rom left it non zero
+p0006: BNE  p0004
+p0008: MOV  $e0 , #$8      ; 12342 cycles
+p000b: MOV  Y , #$0
+p000d: DBNZ Y , p000d
+p000f: DBNZ $e0 , p000b
+p0012: MOV  $f4 , X        ; the host times this
+
+; Header triple: destination on ports 1-2, port 3 is 0 for a block
+; and anything else to finish.
+p0014: CMP  X , $f4        ; wait for port 0 to change
+p0016: BEQ  p0014
+p0018: MOV  X , $f4
+p001a: MOV  A , $f7        ; header: address, command
+p001c: BNE  p006b
+p001e: MOV  $0 , $f5
+p0021: MOV  $1 , $f6
+p0024: MOV  Y , #$0
+p0026: MOV  $e2 , #$0      ; running sums
+p0029: MOV  $e3 , #$0
+p002c: MOV  $e4 , #$40     ; 64 data triples follow
+
+; 64 data triples. 103 cycles at most from a change of port 0 back
+; to this poll, the host waits at least that long between triples.
+p002f: CMP  X , $f4
+p0031: BEQ  p002f
+p0033: MOV  X , $f4
+p0035: CLRC
+p0036: MOV  A , $f5
+p0038: MOV  [$0]+Y , A
+p003a: INC  Y
+p003b: ADC  A , $e2
+p003d: MOV  $e2 , A
+p003f: ADC  A , $e3
+p0041: MOV  $e3 , A
+p0043: MOV  A , $f6
+p0045: MOV  [$0]+Y , A
+p0047: INC  Y
+p0048: ADC  A , $e2
+p004a: MOV  $e2 , A
+p004c: ADC  A , $e3
+p004e: MOV  $e3 , A
+p0050: MOV  A , $f7
+p0052: MOV  [$0]+Y , A
+p0054: INC  Y
+p0055: ADC  A , $e2
+p0057: MOV  $e2 , A
+p0059: ADC  A , $e3
+p005b: MOV  $e3 , A
+p005d: DEC  $e4
+p005f: BNE  p002f
+p0061: MOV  $f5 , $e2      ; checkpoint: sums on ports
+p0064: MOV  $f6 , $e3      ; 1 and 2, then echo port 0
+p0067: MOV  $f4 , X
+p0069: BRA  p0014
+
+p006b: JMP  $ffc9          ; back into the rom
@@ -0,0 +1,49 @@
+; Page verifier, see verifyloader.h
+; Origin: $0002
+; Length: 55
+;
+; Run after an upload, before the zero page is sent again. For each
+; command the host puts a page on port 1 and the number of byte pairs
+; to sum on port 2 ($80 for the whole page, $60 for page ff which the
+; rom hides above ffc0), then the counter on port 0. The loader
+; answers with the 16 bit sum on ports 1-2 and the counter on port 0.
+;
+; The add chain never clears the carry: a carry out of the low byte
+; counts in the high byte and again in the next add. It saves a CLRC
+; per byte and the host does the same sum.
+;
+; Zero page use: 00-01 page pointer, e6 pairs left, e7 sum high byte.
+
+p0002: MOV  X , #$0        ; handshake counter
+p0004: MOV  $0 , #$0       ; pages start at xx00
+
+; Command: page on port 1, byte pairs on port 2, port 0 set to the
+; counter. Page 0 ends it.
+p0007: CMP  X , $f4
+p0009: BNE  p0007
+p000b: MOV  A , $f5        ; page, 0 to finish
+p000d: BEQ  p0036
+p000f: MOV  $1 , A
+p0011: MOV  $e6 , $f6      ; byte pairs, 1 to $80
+p0014: MOV  Y , #$0
+p0016: MOV  A , #$0
+p0018: MOV  $e7 , A
+p001a: CLRC
+
+; 15 cycles per byte, about 4 ms per page
+p001b: ADC  A , [$0]+Y     ; the carry is not cleared,
+p001d: BCC  p0021          ; it counts in the next add
+p001f: INC  $e7
+p0021: INC  Y
+p0022: ADC  A , [$0]+Y
+p0024: BCC  p0028
+p0026: INC  $e7
+p0028: INC  Y
+p0029: DBNZ $e6 , p001b    ; keeps the flags
+p002c: MOV  $f5 , A
+p002e: MOV  $f6 , $e7
+p0031: MOV  $f4 , X        ; sum ready
+p0033: INC  X
+p0034: BRA  p0007
+
+p0036: JMP  $ffc9          ; back into the rom
@@ -16,28 +16,108 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "apu.h"
 #include <time.h>
 #include <sys/time.h>
 #include "MCP23X17_outb-inb.h"
+#include "rt.h"
 
 //#define TRACE_RW
 
 extern int g_verbose; // from main.c
+extern int g_playing; // from main.c
+extern int g_exit_now; // from main.c
 
 /******************** G L O B A L S ************************************/
-static int port0=0;
-static APU_ops *apu_ops = NULL;
+struct apu_dev {
+	int port0;
+	APU_ops *ops;
+
+	/* streaming: time the loader needs per triple, and when the last
+	 * one was complete on the bus */
+	uint64_t stream_gap_ns;
+	uint64_t stream_last_ns;
+
+	/* the rom is idle and nothing was sent since a reset */
+	int fresh_reset;
+
+	apu_shadow shadow;
+
+	/* set by other threads, see apu_setCancel() */
+	int cancel;
+
+	int phase;
+	uint64_t phase_start_ns;
+	apu_stats stats[APU_PHASES];
+};
+
+/* the device of the calling thread, see apu_useDevice() */
+static apu_dev default_dev;
+static __thread apu_dev *dev = &default_dev;
+
+static rt_hist hist_read = RT_HIST_INIT("apu_read");
+static rt_hist hist_write = RT_HIST_INIT("apu_write");
+static rt_hist hist_handshake = RT_HIST_INIT("apu_writeHandshake");
+static rt_hist hist_wait = RT_HIST_INIT("apu_waitInport");
+
+const char *apu_phase_names[APU_PHASES] = {
+	"other", "loader", "dsp", "zero page", "ram", "verify"
+};
 
 void apu_setOps(APU_ops *ops)
 {
-	apu_ops = ops;
+	dev->ops = ops;
+}
+
+apu_dev *apu_newDevice(APU_ops *ops)
+{
+	apu_dev *d;
+
+	d = calloc(1, sizeof(apu_dev));
+	if (d == NULL) {
+		perror("calloc");
+		return NULL;
+	}
+	d->ops = ops;
+	return d;
+}
+
+void apu_freeDevice(apu_dev *d)
+{
+	if (d == NULL || d == &default_dev) { return; }
+	free(d->shadow.ram);
+	free(d);
+}
+
+void apu_useDevice(apu_dev *d)
+{
+	dev = d ? d : &default_dev;
+}
+
+apu_shadow *apu_getShadow(void)
+{
+	return &dev->shadow;
+}
+
+void apu_setCancel(apu_dev *d, int cancel)
+{
+	__atomic_store_n(&d->cancel, cancel, __ATOMIC_RELAXED);
+}
+
+int apu_cancelled(void)
+{
+	if (dev == &default_dev) {
+		return g_exit_now || !g_playing;
+	}
+	return __atomic_load_n(&dev->cancel, __ATOMIC_RELAXED);
 }
 
 static int SetPort0 (short data)
 {
-	port0=data;
+	dev->port0=data;
 	return 0;
 }
 
@@ -46,12 +126,34 @@ void apu_write (int address, unsigned char data)
 //#ifdef TRACE_RW
 //	printf("apu_write: a=%d, %02x\n", address, data);
 //#endif
-	apu_ops->write(address, data);	
+	uint64_t start = rt_stamp();
+
+	dev->stats[dev->phase].writes++;
+	dev->ops->write(address, data);	
+	rt_record(&hist_write, start);
+}
+
+void apu_writeBlock(const unsigned char *address, const unsigned char *data, int len)
+{
+	int i;
+
+	dev->stats[dev->phase].writes += len;
+	if (dev->ops->write_block) {
+		dev->ops->write_block(address, data, len);
+		return;
+	}
+	for (i=0; i<len; i++) {
+		dev->ops->write(address[i], data[i]);
+	}
 }
 
 unsigned char apu_read (int address)
 {
-	unsigned char tmp = apu_ops->read(address);
+	uint64_t start = rt_stamp();
+	unsigned char tmp = dev->ops->read(address);
+
+	rt_record(&hist_read, start);
+	dev->stats[dev->phase].reads++;
 //#ifdef TRACE_RW
 //	printf("apu_read: a=%d -> %02x\n", address, tmp);
 //#endif
@@ -67,15 +169,22 @@ int apu_writeHandshake(int address, int data)
 {
 //	int i;
 //	i = 0;
-	apu_write(address, data);
-	apu_write(0,port0);
+	uint64_t start = rt_stamp();
+	unsigned char ports[2], values[2];
+
+	ports[0] = address; values[0] = data;
+	ports[1] = 0; values[1] = dev->port0;
+	apu_writeBlock(ports, values, 2);
 	
-	if (!apu_waitInport(0, port0, 500)) {
+	/* a timeout is a sample too, the longest one */
+	if (!apu_waitInport(0, dev->port0, 500)) {
+		rt_record(&hist_handshake, start);
 		return 1;
 	}
-	port0++;
-	if (port0 == 256)
-		port0 = 0;
+	rt_record(&hist_handshake, start);
+	dev->port0++;
+	if (dev->port0 == 256)
+		dev->port0 = 0;
 
 	return 0;
 	
@@ -89,16 +198,276 @@ int apu_writeBytes(unsigned char *data, int len)
 #ifdef TRACE_RW
 	printf("apu_writeBytes: %d...\n", len);
 #endif
+	if (dev->ops->handshake_block) {
+		i = dev->ops->handshake_block(data, len, dev->port0, 500);
+		dev->port0 = (dev->port0 + i) & 0xff;
+		dev->stats[dev->phase].writes += 2 * i;
+		dev->stats[dev->phase].reads += i;
+		dev->stats[dev->phase].bytes += i;
+		return i != len;
+	}
 	for (i=0; i<len; i++) {
 		if (apu_writeHandshake(1, data[i])) { return 1; }
 	}
+	dev->stats[dev->phase].bytes += len;
+	return 0;
+}
+
+int apu_writeFast(const unsigned char *data, int len, int final)
+{
+	static const unsigned char ports[4] = { 1, 2, 3, 0 };
+	unsigned char values[4];
+	int i, ack;
+
+	for (i=0; i+3<=len; i+=3) {
+		values[0] = data[i];
+		values[1] = data[i+1];
+		values[2] = data[i+2];
+		values[3] = dev->port0;
+		apu_writeBlock(ports, values, 4);
+
+		ack = (final && i+3 >= len) ? 0xaa : dev->port0;
+		if (!apu_waitInport(0, ack, 500)) {
+			return 1;
+		}
+		dev->port0 = (dev->port0 + 1) & 0xff;
+	}
+	dev->stats[dev->phase].bytes += i;
+	return 0;
+}
+
+/* Take len bytes from the read loader (readloader.h), 'stride' per
+ * handshake on ports 1 and up */
+static int readHandshakes(unsigned char *data, int len, int stride, int final)
+{
+	int i, j;
+
+	for (i=0; i+stride<=len; i+=stride) {
+		if (!apu_waitInport(0, dev->port0, 500)) {
+			return 1;
+		}
+		for (j=0; j<stride; j++) {
+			data[i+j] = apu_read(1+j);
+		}
+		apu_write(0, dev->port0);
+		dev->port0 = (dev->port0 + 1) & 0xff;
+	}
+	if (final && !apu_waitInport(0, 0xaa, 500)) {
+		return 1;
+	}
+	return 0;
+}
+
+int apu_readBytes(unsigned char *data, int len)
+{
+	return readHandshakes(data, len, 1, 0);
+}
+
+int apu_readFast(unsigned char *data, int len, int final)
+{
+	return readHandshakes(data, len, 3, final);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void apu_setPhase(int phase)
+{
+	uint64_t now = now_ns();
+
+	if (dev->phase_start_ns) {
+		dev->stats[dev->phase].ns += now - dev->phase_start_ns;
+	}
+	dev->phase_start_ns = now;
+	dev->phase = phase;
+}
+
+void apu_addBytes(int count)
+{
+	dev->stats[dev->phase].bytes += count;
+}
+
+void apu_addRetries(int count)
+{
+	dev->stats[dev->phase].retries += count;
+}
+
+const apu_stats *apu_getStats(void)
+{
+	apu_setPhase(dev->phase);
+	return dev->stats;
+}
+
+void apu_resetStats(void)
+{
+	memset(dev->stats, 0, sizeof(dev->stats));
+	dev->phase = APU_PHASE_OTHER;
+	dev->phase_start_ns = now_ns();
+}
+
+/* Ports 1-3, then the next sequence number on port 0, no earlier than
+ * the loader can take them */
+static void streamTriple(unsigned char a, unsigned char b, unsigned char c)
+{
+	static const unsigned char ports[4] = { 1, 2, 3, 0 };
+	unsigned char values[4];
+
+	dev->port0 = (dev->port0 + 1) & 0xff;
+	values[0] = a;
+	values[1] = b;
+	values[2] = c;
+	values[3] = dev->port0;
+
+	while (now_ns() - dev->stream_last_ns < dev->stream_gap_ns)
+		;
+	apu_writeBlock(ports, values, 4);
+	dev->stream_last_ns = now_ns();
+}
+
+/* the loader's sums: two chained 8 bit adds per byte, the carry only
+ * kept within a triple */
+static unsigned short streamSums(const unsigned char *data, int len)
+{
+	unsigned int s1 = 0, s2 = 0, c = 0;
+	int i;
+
+	for (i=0; i<len; i++) {
+		if (i % 3 == 0)
+			c = 0;
+		s1 = data[i] + s1 + c;
+		c = s1 >> 8;
+		s1 &= 0xff;
+		s2 = s1 + s2 + c;
+		c = s2 >> 8;
+		s2 &= 0xff;
+	}
+	return s1 | (s2 << 8);
+}
+
+int apu_beginStream(int cal_cycles, int triple_cycles)
+{
+	uint64_t start, elapsed;
+
+	/* apu_endTransfer left port 0 non zero and the counter at 0 */
+	apu_write(0, dev->port0);
+	start = now_ns();
+	if (!apu_waitInport(0, dev->port0, 500)) {
+		return 1;
+	}
+	elapsed = now_ns() - start;
+
+	/* 25% for the clock jitter of the host */
+	dev->stream_gap_ns = elapsed * triple_cycles / cal_cycles * 5 / 4;
+	dev->stream_last_ns = now_ns();
+	if (g_verbose)
+		printf("Stream pace: %llu ns per 3 bytes\n", (unsigned long long)dev->stream_gap_ns);
+	return 0;
+}
+
+int apu_writeStream(unsigned short address, const unsigned char *data, int len)
+{
+	unsigned short sums;
+	int i;
+
+	streamTriple(address & 0xff, address >> 8, 0);
+	for (i=0; i+3<=len; i+=3) {
+		streamTriple(data[i], data[i+1], data[i+2]);
+	}
+
+	if (!apu_waitInport(0, dev->port0, 500)) {
+		return -1;
+	}
+	dev->stats[dev->phase].bytes += len;
+	sums = apu_read(1) | (apu_read(2) << 8);
+	return sums != streamSums(data, len);
+}
+
+int apu_endStream(void)
+{
+	streamTriple(0, 0, 1);
+	return !apu_waitInport(0, 0xaa, 500);
+}
+
+int apu_pageSum(unsigned char page, unsigned char pairs, unsigned short *sum)
+{
+	static const unsigned char ports[3] = { 1, 2, 0 };
+	unsigned char values[3];
+
+	values[0] = page;
+	values[1] = pairs;
+	values[2] = dev->port0;
+	apu_writeBlock(ports, values, 3);
+
+	if (!apu_waitInport(0, dev->port0, 500)) {
+		return 1;
+	}
+	*sum = apu_read(1) | (apu_read(2) << 8);
+	dev->port0 = (dev->port0 + 1) & 0xff;
+	return 0;
+}
+
+int apu_endPageSums(void)
+{
+	unsigned char ports[2] = { 1, 0 }, values[2];
+
+	values[0] = 0;
+	values[1] = dev->port0;
+	apu_writeBlock(ports, values, 2);
+	return !apu_waitInport(0, 0xaa, 500);
+}
+
+static int iplIdle(void)
+{
+	return apu_read(0) == 0xaa && apu_read(1) == 0xbb;
+}
+
+/* Poll for the rom's $AA $BB, back to back at first, then backing off
+ * so a missing apu does not keep a cpu busy for the whole timeout.
+ * Returns 0 once seen, -1 on timeout. */
+static int waitIPL(int timeout_ms)
+{
+	uint64_t start = now_ns(), elapsed;
+	unsigned int pause_us = 0;
+
+	while (!iplIdle()) {
+		elapsed = now_ns() - start;
+		if (elapsed > (uint64_t)timeout_ms * 1000000) {
+			return -1;
+		}
+		if (elapsed > APU_RESET_SPIN_US * 1000ULL) {
+			pause_us = pause_us ? pause_us * 2 : 50;
+			if (pause_us > 1000)
+				pause_us = 1000;
+			usleep(pause_us);
+		}
+	}
 	return 0;
 }
 
 void apu_reset(void)	//Reset the APU by whatever means it needs reset.
 {
-	apu_ops->reset();	
+	/* the backends only hold reset for APU_RESET_HOLD_US, the rom
+	 * then needs a few ms to clear the zero page */
+	dev->ops->reset();	
+	dev->fresh_reset = waitIPL(APU_RESET_TIMEOUT_MS) == 0;
+}
 
+int apu_resetIPL(void)
+{
+	if (iplIdle()) {
+		if (dev->fresh_reset)
+			return 0;
+		if (g_verbose)
+			printf("The apu waits in the IPL rom, not resetting it\n");
+		return 1;
+	}
+	apu_reset();
+	return dev->fresh_reset ? 0 : -1;
 }
 
 /* return false on timeout, otherwise true */
@@ -106,6 +475,7 @@ int apu_waitInport(int port, unsigned char data, int timeout_ms)
 {
 	struct timeval tv_before, tv_now;
 	int elaps_milli;
+	uint64_t start = rt_stamp();
 	gettimeofday(&tv_before, NULL);
 
 #ifdef TRACE_RW
@@ -113,6 +483,7 @@ int apu_waitInport(int port, unsigned char data, int timeout_ms)
 #endif
 	
 	while(apu_read(port)!=data) {
+		dev->stats[dev->phase].polls++;
 		//usleep(1);
 		gettimeofday(&tv_now, NULL);
 		elaps_milli = (tv_now.tv_sec - tv_before.tv_sec) * 1000;
@@ -121,14 +492,18 @@ int apu_waitInport(int port, unsigned char data, int timeout_ms)
 		{
 			if (g_verbose) 
 				printf("timeout after %d milli\n", elaps_milli);
+			rt_record(&hist_wait, start);
 			return 0;
 		}
 	}
+	rt_record(&hist_wait, start);
 	return 1;
 }
 
 int apu_initTransfer(unsigned short address)
 {
+	dev->fresh_reset = 0;
+
 	/* Initializing the transfer */
 	/* Wait for port 2140 to be $aa */
 	if (!apu_waitInport(0, 0xaa, 500)) {
@@ -197,6 +572,16 @@ void apu_endTransfer(unsigned short start_address)
 	i +=2; i &= 0xff;
 	if (!i) { i+=2 ; } // if it's 0, increase it again
 	apu_write(0, i);
+
+	/* the rom echoes the counter once it has read the address and
+	 * port 1, only then may the started code's ports be written */
+	if (!apu_waitInport(0, i, 500)) {
+		if (g_verbose)
+			printf("apu_endTransfer: no echo\n");
+	}
+
+	/* code started this way (the fast loader) counts from 0 */
+	SetPort0(0);
 }
 
 
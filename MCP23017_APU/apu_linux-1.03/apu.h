@@ -18,6 +18,8 @@
 #ifndef _apu_h__
 #define _apu_h__
 
+#include <stdint.h>
+
 
 typedef struct {
 	unsigned char (*read)(int address);
@@ -27,15 +29,97 @@ typedef struct {
 	 * return 0 on success. */
 	int (*init)(char *cmdline);
 	void (*shutdown)(void);
+
+	/* Optional bulk entries, left NULL by backends without them (apu.c
+	 * then falls back to read and write).
+	 *
+	 * write_block writes data[i] to port address[i], in order.
+	 *
+	 * handshake_block sends len bytes the way apu_writeBytes does:
+	 * each byte goes to port 1, the running counter (starting at
+	 * 'counter') to port 0, then port 0 is polled until the counter
+	 * comes back. Returns how many bytes were acknowledged before a
+	 * timeout_ms timeout, len on success. */
+	void (*write_block)(const unsigned char *address, const unsigned char *data, int len);
+	int (*handshake_block)(const unsigned char *data, int len, int counter, int timeout_ms);
 } APU_ops;
 
 
 void apu_setOps(APU_ops *ops);
 
+/* Everything below works on the device of the calling thread, one
+ * created by apu_newDevice() and bound with apu_useDevice(), or a
+ * default one. Each device has its own handshake counter, stream pace
+ * and upload shadow. A device must be driven by one thread at a time,
+ * and the mcp23x17 backend keeps its bus state per thread too, so one
+ * thread per device (see apudev.h) is the way to run several apus. */
+typedef struct apu_dev apu_dev;
+
+/* returns NULL on error */
+apu_dev *apu_newDevice(APU_ops *ops);
+void apu_freeDevice(apu_dev *d);
+
+/* NULL binds the default device again */
+void apu_useDevice(apu_dev *d);
+
+/* What the apu ram holds after the last upload, for the delta mode of
+ * apuplay.c. ram is allocated by the user and freed with the device. */
+typedef struct {
+	unsigned char *ram;
+	int valid;
+} apu_shadow;
+
+apu_shadow *apu_getShadow(void);
+
+/* Stopping an upload from another thread. While the flag of a device
+ * is set, the uploads of apuplay.c on it give up at their next check
+ * and return 1. apu_cancelled() is that check, for the device of the
+ * calling thread. The default device has no flag of its own: it
+ * follows the player's ^C (g_playing and g_exit_now of main.c), which
+ * only the thread driving it reads. */
+void apu_setCancel(apu_dev *d, int cancel);
+int apu_cancelled(void);
+
+/* Upload statistics, per device. apuplay.c names the phase it is in
+ * and the bus accesses, the payload bytes and the time are counted
+ * against it. A poll is a read of a port that did not have the
+ * awaited value yet, a retry a block or page sent again. Backends
+ * handshaking whole blocks on their own (handshake_block) are counted
+ * as 2 writes and 1 read per byte, their polls are not seen. */
+#define APU_PHASE_OTHER		0	/* resets, transfer setup, start */
+#define APU_PHASE_LOADER	1	/* dsploader, fastloader and the like */
+#define APU_PHASE_DSP		2	/* the dsp registers */
+#define APU_PHASE_ZEROPAGE	3
+#define APU_PHASE_RAM		4	/* 0x100-0xffff */
+#define APU_PHASE_VERIFY	5	/* page sums and the pages sent again */
+#define APU_PHASES		6
+
+typedef struct {
+	unsigned long reads;
+	unsigned long writes;
+	unsigned long polls;
+	unsigned long retries;
+	unsigned long bytes;
+	uint64_t ns;
+} apu_stats;
+
+extern const char *apu_phase_names[APU_PHASES];
+
+void apu_setPhase(int phase);
+void apu_addBytes(int count);
+void apu_addRetries(int count);
+
+/* APU_PHASES entries, the current phase's time counted up to now */
+const apu_stats *apu_getStats(void);
+void apu_resetStats(void);
+
 unsigned char apu_read(int address);
 
 void apu_write(int address, unsigned char data);
 
+/* write data[i] to port address[i] for i < len */
+void apu_writeBlock(const unsigned char *address, const unsigned char *data, int len);
+
 /* Write to address 'address', write the previously
  * read value from port0 back to port 0 and wait
  * for port0 value to be different from the written one.
@@ -45,9 +129,68 @@ int apu_writeHandshake(int address, int data);
 /* Write many bytes using handshake (see apu_writeHandshake) */
 int apu_writeBytes(unsigned char *data, int len);
 
-/* reset the apu */
+/* Write many bytes to the fast loader (fastloader.h), three per
+ * handshake on ports 1 to 3. len must be a multiple of 3. The
+ * counter starts over at 0 after apu_endTransfer. With 'final' set,
+ * the last handshake is the one after which the loader returns to
+ * the IPL rom, and is acknowledged by its $AA. */
+int apu_writeFast(const unsigned char *data, int len, int final);
+
+/* Read from the read loader (readloader.h), which puts bytes on the
+ * ports and its counter on port 0, and waits for the host to write the
+ * counter back. apu_readBytes takes one byte per handshake from port
+ * 1, apu_readFast three from ports 1 to 3 (len must be a multiple of
+ * 3). With 'final' set, the $AA of the rom is awaited after the last
+ * handshake. Return 0 on success, 1 on timeout. */
+int apu_readBytes(unsigned char *data, int len);
+int apu_readFast(unsigned char *data, int len, int final);
+
+/* Write to the stream loader (streamloader.h), which has no handshake
+ * per byte: the host writes three bytes and a new port 0 value no
+ * faster than the loader's cycle count allows.
+ *
+ * apu_beginStream times a delay of 'cal_cycles' spc700 cycles to get
+ * the pace for 'triple_cycles' per three bytes. Returns 0 on success,
+ * 1 on timeout.
+ *
+ * apu_writeStream sends one block to 'address'. The loader then
+ * reports sums of what it got. Returns 0 when they match, 1 when they
+ * do not and the block must be sent again, -1 when the loader is lost.
+ *
+ * apu_endStream makes the loader return to the IPL rom. Returns 0 on
+ * success, 1 on timeout. */
+int apu_beginStream(int cal_cycles, int triple_cycles);
+int apu_writeStream(unsigned short address, const unsigned char *data, int len);
+int apu_endStream(void);
+
+/* Ask the page verifier (verifyloader.h) for the sum of 'pairs' * 2
+ * bytes from the start of 'page', 0x80 pairs for the whole page. 0
+ * would count 256 pairs: Y wraps and the page is summed twice.
+ * Returns 0 with the sum in *sum, 1 on timeout.
+ *
+ * apu_endPageSums makes the verifier return to the IPL rom. Returns 0
+ * on success, 1 on timeout. */
+int apu_pageSum(unsigned char page, unsigned char pairs, unsigned short *sum);
+int apu_endPageSums(void);
+
+/* reset the apu, returns once the IPL rom is ready (or after
+ * APU_RESET_TIMEOUT_MS) */
 void apu_reset(void);
 
+/* Reset the apu unless the IPL rom already waits for a transfer.
+ *
+ * returns 0 when the apu was reset, or is still as a reset left it,
+ * 1 when the reset was skipped and the dsp is in whatever state the
+ * last program left it (echo writes may be on), -1 if the rom did not
+ * show up */
+int apu_resetIPL(void);
+
+/* /RESET low time used by the backends, and how long the rom may take
+ * to come up after it. Polled back to back for APU_RESET_SPIN_US. */
+#define APU_RESET_HOLD_US	1000
+#define APU_RESET_TIMEOUT_MS	200
+#define APU_RESET_SPIN_US	5000
+
 /* wait for a port to contain given value, with timeout */
 int apu_waitInport(int port, unsigned char data, int timeout_ms);
 
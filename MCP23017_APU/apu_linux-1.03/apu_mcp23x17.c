@@ -0,0 +1,469 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <wiringPi.h>
+#include <wiringPiI2C.h>
+#include <wiringPiSPI.h>
+#include "apu_mcp23x17.h"
+
+/* The parallel port layer (apu_ppio.c + MCP23X17_outb-inb.c) turns every
+ * apu_write into a handful of control port writes, each one remapped bit
+ * by bit and sent to the expander on its own. Here the expander runs in
+ * byte mode (IOCON.SEQOP) with BANK=0, where the register pointer toggles
+ * between GPIOA and GPIOB: a single bus transfer starting at GPIOA can
+ * set the address, put the data on port B, pulse /WR, and go on with
+ * the next port write.
+ */
+
+#define BUS_GPIO	0
+#define BUS_SPI		1
+#define BUS_I2C		2
+
+#define MCP_ADDR	0x20
+#define CMD_WRITE	0x40
+#define CMD_READ	0x41
+
+#define IODIRA		0x00
+#define IODIRB		0x01
+#define IOCON		0x0A
+#define GPIOA		0x12
+#define GPIOB		0x13
+
+#define IOCON_SEQOP	0x20
+#define IOCON_HAEN	0x08	/* spi: the chip compares its A2-A0 pins */
+
+/* control lines on port A, same wiring as MCP23X17_outb-inb.c */
+#define CTL_PA0		0x80
+#define CTL_PA1		0x40
+#define CTL_WR		0x20	/* active low */
+#define CTL_RD		0x10	/* active low */
+#define CTL_LED		0x08
+#define CTL_RESET	0x01	/* active low */
+
+#define CTL_ADDR	(CTL_PA0 | CTL_PA1)
+#define CTL_IDLE	(CTL_WR | CTL_RD | CTL_LED | CTL_RESET)
+
+/* wiringPi pin numbers of the GPIO board */
+#define GPIO_RD_PIN	4
+#define GPIO_WR_PIN	5
+#define GPIO_ADDR_0	6
+#define GPIO_ADDR_1	10
+#define GPIO_RESET	1
+#define GPIO_LVLSFT_EN	11
+#define GPIO_DATA_DIR	8
+
+/* /WR low time on the GPIO board. The level shifters need far less than
+ * the 20 + 40 us the parallel port emulation waits per access. */
+#define GPIO_STROBE_US	1
+
+#define DEFAULT_I2C_DEVICE	"/dev/i2c-0"
+
+/* port writes per bus transfer, 4 bytes each */
+#define MAX_BLOCK_WRITES	16
+
+/* GPIOA/GPIOB pairs per port write, at most 3 */
+#define MAX_BLOCK_SEQ	(MAX_BLOCK_WRITES * 6)
+
+static const int gpio_data_pins[8] = { 14, 13, 12, 3, 2, 0, 7, 9 };
+
+/* One board per thread, see apu.h. The GPIO header has room for one
+ * only, several boards hang on i2c or spi at different addresses. */
+static __thread int bus = BUS_GPIO;
+static __thread int i2c_fd = -1;
+static __thread unsigned char spi_addr = 0;	/* A2-A0 << 1 in the opcode */
+static __thread int spi_haen = 0;		/* set when an address was given */
+static __thread unsigned char ctl = CTL_IDLE;	/* last control byte sent */
+static __thread int data_input = -1;		/* data port direction, -1 unknown */
+
+static void reg_write(unsigned char reg, const unsigned char *values, int count)
+{
+	unsigned char buf[2 + MAX_BLOCK_SEQ];
+	static int warned = 0;
+
+	if (bus == BUS_SPI) {
+		buf[0] = CMD_WRITE | spi_addr;
+		buf[1] = reg;
+		memcpy(buf + 2, values, count);
+		wiringPiSPIDataRW(0, buf, count + 2);
+		return;
+	}
+
+	buf[0] = reg;
+	memcpy(buf + 1, values, count);
+	if (write(i2c_fd, buf, count + 1) != count + 1 && !warned) {
+		perror("apu_mcp23x17: i2c write");
+		warned = 1;
+	}
+}
+
+static unsigned char reg_read(unsigned char reg)
+{
+	unsigned char buf[3];
+
+	if (bus == BUS_SPI) {
+		buf[0] = CMD_READ | spi_addr;
+		buf[1] = reg;
+		buf[2] = 0;
+		wiringPiSPIDataRW(0, buf, 3);
+		return buf[2];
+	}
+	return wiringPiI2CReadReg8(i2c_fd, reg);
+}
+
+static void gpio_control(unsigned char value)
+{
+	unsigned char changed = value ^ ctl;
+
+	if (changed & CTL_PA0)
+		digitalWrite(GPIO_ADDR_0, (value & CTL_PA0) != 0);
+	if (changed & CTL_PA1)
+		digitalWrite(GPIO_ADDR_1, (value & CTL_PA1) != 0);
+	if (changed & CTL_RD)
+		digitalWrite(GPIO_RD_PIN, (value & CTL_RD) != 0);
+	if (changed & CTL_WR)
+		digitalWrite(GPIO_WR_PIN, (value & CTL_WR) != 0);
+	if (changed & CTL_RESET)
+		digitalWrite(GPIO_RESET, (value & CTL_RESET) != 0);
+}
+
+static void gpio_data_write(unsigned char data)
+{
+	int i;
+
+	for (i=0; i<8; i++)
+		digitalWrite(gpio_data_pins[i], (data >> i) & 1);
+}
+
+static unsigned char gpio_data_read(void)
+{
+	unsigned char data = 0;
+	int i;
+
+	for (i=0; i<8; i++) {
+		if (digitalRead(gpio_data_pins[i]))
+			data |= 1 << i;
+	}
+	return data;
+}
+
+static void set_control(unsigned char value)
+{
+	if (value == ctl)
+		return;
+
+	if (bus == BUS_GPIO)
+		gpio_control(value);
+	else
+		reg_write(GPIOA, &value, 1);
+	ctl = value;
+}
+
+static void set_data_input(int input)
+{
+	int i;
+
+	if (input == data_input)
+		return;
+
+	/* the APU must stop driving the bus before we do */
+	if (!input)
+		set_control(ctl | CTL_RD);
+
+	if (bus == BUS_GPIO) {
+		if (input) {
+			for (i=0; i<8; i++)
+				pinMode(gpio_data_pins[i], INPUT);
+			digitalWrite(GPIO_DATA_DIR, 0);
+		} else {
+			digitalWrite(GPIO_DATA_DIR, 1);
+			for (i=0; i<8; i++)
+				pinMode(gpio_data_pins[i], OUTPUT);
+		}
+	} else {
+		unsigned char dir = input ? 0xFF : 0x00;
+		reg_write(IODIRB, &dir, 1);
+	}
+	data_input = input;
+}
+
+static unsigned char addr_bits(int address)
+{
+	return ((address & 1) ? CTL_PA0 : 0) | ((address & 2) ? CTL_PA1 : 0);
+}
+
+static void gpio_write(int address, unsigned char data)
+{
+	unsigned char idle = addr_bits(address) | CTL_IDLE;
+
+	set_control(idle);
+	gpio_data_write(data);
+	set_control(idle & ~CTL_WR);
+	delayMicroseconds(GPIO_STROBE_US);
+	set_control(idle);
+}
+
+static void apu_mcp23x17_write_block(const unsigned char *address, const unsigned char *data, int len)
+{
+	unsigned char seq[MAX_BLOCK_SEQ];
+	unsigned char idle = ctl;
+	int i, n;
+
+	set_data_input(0);
+
+	if (bus == BUS_GPIO) {
+		for (i=0; i<len; i++)
+			gpio_write(address[i], data[i]);
+		return;
+	}
+
+	while (len > 0) {
+		/* as gpio_write: the address with /WR high and the data come
+		 * first, then /WR low and high again, with port B rewritten
+		 * unchanged in between. Releasing /WR already puts the next
+		 * byte on port B. Only a new address needs the first pair,
+		 * the address never changes in the write that moves /WR. */
+		n = 0;
+		for (i=0; i<len && i<MAX_BLOCK_WRITES; i++) {
+			if (i == 0 || addr_bits(address[i]) != (idle & CTL_ADDR)) {
+				idle = addr_bits(address[i]) | CTL_IDLE;
+				seq[n++] = idle;
+				seq[n++] = data[i];
+			}
+			seq[n++] = idle & ~CTL_WR;
+			seq[n++] = data[i];
+			seq[n++] = idle;
+			seq[n++] = i+1 < len && i+1 < MAX_BLOCK_WRITES ? data[i+1] : data[i];
+		}
+		reg_write(GPIOA, seq, n);
+		ctl = idle;
+
+		address += i;
+		data += i;
+		len -= i;
+	}
+}
+
+static void apu_mcp23x17_write(int address, unsigned char data)
+{
+	unsigned char a = address;
+
+	apu_mcp23x17_write_block(&a, &data, 1);
+}
+
+static unsigned char apu_mcp23x17_read(int address)
+{
+	set_data_input(1);
+
+	/* /RD stays asserted after the read. Polling the same port (all
+	 * apu_waitInport does) then costs a single GPIOB read per pass;
+	 * the next write releases it before the data port turns around. */
+	set_control((addr_bits(address) | CTL_IDLE) & ~CTL_RD);
+
+	if (bus == BUS_GPIO)
+		return gpio_data_read();
+	return reg_read(GPIOB);
+}
+
+/* Both writes of a handshake go out as one transfer, and the wait only
+ * looks at the clock every 64 polls of port 0. */
+static int apu_mcp23x17_handshake_block(const unsigned char *data, int len, int counter, int timeout_ms)
+{
+	static const unsigned char ports[2] = { 1, 0 };
+	unsigned char values[2];
+	struct timeval tv_before, tv_now;
+	int i, polls;
+
+	for (i=0; i<len; i++) {
+		values[0] = data[i];
+		values[1] = counter;
+		apu_mcp23x17_write_block(ports, values, 2);
+
+		polls = 0;
+		while (apu_mcp23x17_read(0) != counter) {
+			if (polls++ == 0) {
+				gettimeofday(&tv_before, NULL);
+			}
+			else if ((polls & 63) == 0) {
+				gettimeofday(&tv_now, NULL);
+				if ((tv_now.tv_sec - tv_before.tv_sec) * 1000 +
+					(tv_now.tv_usec - tv_before.tv_usec) / 1000 > timeout_ms)
+					return i;
+			}
+		}
+		counter = (counter + 1) & 0xff;
+	}
+	return len;
+}
+
+static void apu_mcp23x17_reset(void)
+{
+	set_data_input(1);
+
+	/* /RESET, and /RD + /WR low together, as the parallel port did */
+	set_control(ctl & CTL_ADDR);
+	usleep(APU_RESET_HOLD_US);
+	set_control((ctl & CTL_ADDR) | CTL_IDLE);
+}
+
+static int init_gpio(void)
+{
+	wiringPiSetup();
+
+	pinMode(GPIO_LVLSFT_EN, OUTPUT);
+	digitalWrite(GPIO_LVLSFT_EN, 0);
+	pinMode(GPIO_DATA_DIR, OUTPUT);
+
+	pinMode(GPIO_RD_PIN, OUTPUT);
+	pinMode(GPIO_WR_PIN, OUTPUT);
+	pinMode(GPIO_ADDR_0, OUTPUT);
+	pinMode(GPIO_ADDR_1, OUTPUT);
+	pinMode(GPIO_RESET, OUTPUT);
+
+	/* drive every control line once */
+	ctl = ~CTL_IDLE;
+	gpio_control(CTL_IDLE);
+	ctl = CTL_IDLE;
+	return 0;
+}
+
+static int init_expander(void)
+{
+	unsigned char value;
+
+	/* BANK=0 and byte mode, a transfer toggles between GPIOA and GPIOB.
+	 * Until HAEN is set a chip on the spi bus ignores the address in
+	 * the opcode, so this reaches every one of them. Boards whose
+	 * address pins are not wired keep it off. */
+	value = IOCON_SEQOP;
+	if (spi_haen) {
+		value |= IOCON_HAEN;
+	}
+	reg_write(IOCON, &value, 1);
+
+	/* latch the idle levels before port A turns into outputs */
+	value = CTL_IDLE;
+	reg_write(GPIOA, &value, 1);
+	value = 0x00;
+	reg_write(IODIRA, &value, 1);
+	ctl = CTL_IDLE;
+	return 0;
+}
+
+/* "@addr" at the end of the cmdline, cut off. Returns the address or
+ * 'def' when there is none, -1 if it is out of range. */
+static int parse_address(char *cmdline, int def, int min, int max)
+{
+	char *at = strrchr(cmdline, '@');
+	char *end;
+	long addr;
+
+	if (at == NULL) { return def; }
+
+	addr = strtol(at + 1, &end, 0);
+	if (end == at + 1 || *end || addr < min || addr > max) {
+		fprintf(stderr, "Bad expander address '%s'\n", at + 1);
+		return -1;
+	}
+	*at = 0;
+	return addr;
+}
+
+static int apu_mcp23x17_init(char *cmdline)
+{
+	const char *device = DEFAULT_I2C_DEVICE;
+	char buf[256];
+	int addr;
+
+	data_input = -1;
+
+	if (cmdline) {
+		snprintf(buf, sizeof(buf), "%s", cmdline);
+		cmdline = buf;
+	}
+
+	if (cmdline == NULL || *cmdline == 0 || strcmp(cmdline, "gpio") == 0) {
+		bus = BUS_GPIO;
+		init_gpio();
+	}
+	else if (strncmp(cmdline, "spi", 3) == 0) {
+		spi_haen = strchr(cmdline, '@') != NULL;
+		addr = parse_address(cmdline, 0, 0, 7);
+		if (addr < 0 || strcmp(cmdline, "spi") != 0) {
+			fprintf(stderr, "Use spi[@0-7]\n");
+			return -1;
+		}
+		bus = BUS_SPI;
+		spi_addr = addr << 1;
+		wiringPiSetup();
+		if (wiringPiSPISetup(0, 10000000) < 0) {
+			perror("wiringPiSPISetup");
+			return -1;
+		}
+		init_expander();
+	}
+	else if (strncmp(cmdline, "i2c", 3) == 0) {
+		addr = parse_address(cmdline, MCP_ADDR, MCP_ADDR, MCP_ADDR + 7);
+		if (addr < 0) { return -1; }
+		bus = BUS_I2C;
+		if (cmdline[3] == ':')
+			device = cmdline + 4;
+		i2c_fd = wiringPiI2CSetupInterface(device, addr);
+		if (i2c_fd < 0) {
+			perror(device);
+			return -1;
+		}
+		init_expander();
+	}
+	else {
+		fprintf(stderr, "Unknown bus '%s', use spi[@addr], i2c[:dev][@addr] or gpio\n", cmdline);
+		return -1;
+	}
+
+	set_data_input(1);
+	return 0;
+}
+
+static void apu_mcp23x17_shutdown(void)
+{
+	set_control(CTL_IDLE);
+	set_data_input(1);
+
+	if (i2c_fd >= 0) {
+		close(i2c_fd);
+		i2c_fd = -1;
+	}
+}
+
+static APU_ops ops = {
+	apu_mcp23x17_read,
+	apu_mcp23x17_write,
+	apu_mcp23x17_reset,
+	apu_mcp23x17_init,
+	apu_mcp23x17_shutdown,
+	apu_mcp23x17_write_block,
+	apu_mcp23x17_handshake_block
+};
+
+APU_ops *apu_mcp23x17_getOps(void)
+{
+	return &ops;
+}
@@ -0,0 +1,38 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _apu_mcp23x17_h__
+#define _apu_mcp23x17_h__
+
+#include "apu.h"
+
+/* APU io layer talking to the expander board directly instead of
+ * emulating the parallel port of the original hwapu interface.
+ *
+ * The init cmdline selects the bus the board is wired to:
+ *   "spi[@n]"            MCP23S17 on SPI channel 0, hardware address
+ *                        n (0-7, default 0)
+ *   "i2c[:dev][@addr]"   MCP23017 at addr (0x20-0x27, default 0x20)
+ *                        on dev (default /dev/i2c-0)
+ *   "gpio" or ""         control and data lines on the Pi GPIO header
+ *
+ * The bus state belongs to the calling thread, so several boards can be
+ * driven from one thread each.
+ */
+APU_ops *apu_mcp23x17_getOps(void);
+
+#endif // _apu_mcp23x17_h__
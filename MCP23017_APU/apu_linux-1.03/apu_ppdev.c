@@ -37,6 +37,11 @@
 
 static int ppdev_fd=-1;
 
+/* Last values written, so unchanged control lines and data direction
+ * cost no ioctl. */
+static unsigned char ctrl_cache;
+static int datadir_cache=-1;
+
 #define SETUP_TIME 1
 #define SETUP_LOOPS	1
 
@@ -124,10 +129,29 @@ static int apu_ppdev_init(char *cmdline)
 		return -1;
 	}	
 //	printf("OK\n");
+
+	ioctl(ppdev_fd, PPRCONTROL, &ctrl_cache);
+	datadir_cache = -1;
 	
 	return 0;
 }
 
+static void ppdev_control(unsigned char ctrl)
+{
+	if (ctrl == ctrl_cache)
+		return;
+	ioctl(ppdev_fd, PPWCONTROL, &ctrl);
+	ctrl_cache = ctrl;
+}
+
+static void ppdev_datadir(int dir)
+{
+	if (dir == datadir_cache)
+		return;
+	ioctl(ppdev_fd, PPDATADIR, &dir);
+	datadir_cache = dir;
+}
+
 static void apu_ppdev_shutdown(void)
 {
 	if (ppdev_fd >=0 )
@@ -139,38 +163,32 @@ static void apu_ppdev_shutdown(void)
 
 static void apu_ppdev_reset(void)
 {
-	unsigned char ctrl;
+	unsigned char ctrl = ctrl_cache;
 
-	ioctl(ppdev_fd, PPRCONTROL, &ctrl);
-	
 	ctrl &= ~WR_PIN;
 	ctrl |= _RD_PIN;
 
 //	printf("read ctrl: %02X\n", ctrl);
 //	printf("write ctrl: %02X\n", ctrl);
 	
-	ioctl(ppdev_fd, PPWCONTROL, &ctrl);
+	ppdev_control(ctrl);
 	
-	usleep(50000);							// /RESET will be tied to the
+	usleep(APU_RESET_HOLD_US);				// /RESET will be tied to the
 	
 	ctrl |= WR_PIN;
 	ctrl &= ~_RD_PIN;
 	
-	ioctl(ppdev_fd, PPWCONTROL, &ctrl);
+	ppdev_control(ctrl);
 	
 //	printf("write ctrl: %02X\n", ctrl);
-	usleep(50000);
+	// apu_reset() waits for the IPL rom
 }
 
 static void apu_ppdev_write(int address, unsigned char data)
 {
-	unsigned char ctrl;
-	int i;
-
-	ioctl(ppdev_fd, PPRCONTROL, &ctrl);
+	unsigned char ctrl = ctrl_cache;
 
-	i = 0; // output
-	ioctl(ppdev_fd, PPDATADIR, &i);
+	ppdev_datadir(0); // output
 	
 	// address
 	ctrl |= 3;
@@ -181,29 +199,33 @@ static void apu_ppdev_write(int address, unsigned char data)
 		ctrl &= ~2;
 	}
 
-	ioctl(ppdev_fd, PPWCONTROL, &ctrl); // address
+	ppdev_control(ctrl); // address
 
 	ctrl &= ~(WR_PIN|_RD_PIN); // write
 	
 	ioctl(ppdev_fd, PPWDATA, &data); // put data
-	ioctl(ppdev_fd, PPWCONTROL, &ctrl); // validate data
+	ppdev_control(ctrl); // validate data
 
 	ctrl |= WR_PIN;
-	ioctl(ppdev_fd, PPWCONTROL, &ctrl);
+	ppdev_control(ctrl);
+}
+
+static void apu_ppdev_write_block(const unsigned char *address, const unsigned char *data, int len)
+{
+	int i;
+
+	for (i=0; i<len; i++) {
+		apu_ppdev_write(address[i], data[i]);
+	}
 }
 
 static unsigned char apu_ppdev_read(int address)
 {
-	unsigned char ctrl;
+	unsigned char ctrl = ctrl_cache;
 	unsigned char data=0xff;
-	int i, res;
-
-	res = ioctl(ppdev_fd, PPRCONTROL, &ctrl);
-	if (res<0) { perror("PPRCONTROL"); }
+	int res;
 
-	i = 0xff; // input
-	ioctl(ppdev_fd, PPDATADIR, &i);
-	if (res<0) { perror("PPDATADIR"); }
+	ppdev_datadir(0xff); // input
 
 	// address
 	ctrl |= 3;
@@ -214,19 +236,16 @@ static unsigned char apu_ppdev_read(int address)
 		ctrl &= ~2;
 	}
 
-	res= ioctl(ppdev_fd, PPWCONTROL, &ctrl); // address
-	if (res<0) { perror("PPWCONTROL"); }
+	ppdev_control(ctrl); // address
 
 	ctrl |= (WR_PIN | _RD_PIN); // read
-	res= ioctl(ppdev_fd, PPWCONTROL, &ctrl); // request data
-	if (res<0) { perror("PPWCONTROL"); }
+	ppdev_control(ctrl); // request data
 	
 	res = ioctl(ppdev_fd, PPRDATA, &data); // read data
 	if (res<0) { perror("PPRDATA"); }
 
 	ctrl &= ~_RD_PIN;
-	res = ioctl(ppdev_fd, PPWCONTROL, &ctrl);
-	if (res<0) { perror("PPWCONTROL"); }
+	ppdev_control(ctrl);
 	
 	return data;
 }
@@ -236,7 +255,9 @@ static APU_ops ops = {
 	apu_ppdev_write, 
 	apu_ppdev_reset,
 	apu_ppdev_init,
-	apu_ppdev_shutdown
+	apu_ppdev_shutdown,
+	apu_ppdev_write_block,
+	NULL
 };
 
 APU_ops *apu_ppdev_getOps(void)
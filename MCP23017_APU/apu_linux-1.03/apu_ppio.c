@@ -26,9 +26,6 @@
 #include "parport.h"
 #include "MCP23X17_outb-inb.h"
 
-int ByteTransferCount=0;
-int ParallelPortCount=0;
-
 #define SETUP_TIME 1
 #define SETUP_LOOPS	1
 
@@ -75,13 +72,13 @@ static void apu_ppio_reset(void)
 	ClrPins(control_pins,WR_PIN);		//Once the OR gate is in place
 	SetPins(control_pins,_RD_PIN);		//Pulling both /RD and /WR low
 		io_outp(CONTROL, control_pins);	//Will Reset the APU, since
-	usleep(50000);							// /RESET will be tied to the
+	usleep(APU_RESET_HOLD_US);				// /RESET will be tied to the
 //usleep(1000000);
 
 	SetPins(control_pins,WR_PIN);		//output of the OR gate.
 	ClrPins(control_pins,_RD_PIN);
 		io_outp(CONTROL, control_pins);
-	usleep(50000);
+	// apu_reset() waits for the IPL rom
 }
 
 static void apu_ppio_write(int address, unsigned char data)
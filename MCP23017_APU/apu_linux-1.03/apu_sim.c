@@ -0,0 +1,830 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "apu_sim.h"
+
+/* The spc700 clock, and how far the simulation catches up with the host
+ * at most: a song left playing for minutes is not run for minutes when
+ * the next access comes. */
+#define SIM_HZ			1024000
+#define SIM_MAX_CATCHUP		(SIM_HZ / 10)
+
+#define FLAG_N	0x80
+#define FLAG_V	0x40
+#define FLAG_P	0x20
+#define FLAG_B	0x10
+#define FLAG_H	0x08
+#define FLAG_I	0x04
+#define FLAG_Z	0x02
+#define FLAG_C	0x01
+
+#define CTL_ROM		0x80
+#define CTL_CLEAR23	0x20
+#define CTL_CLEAR01	0x10
+
+typedef struct {
+	unsigned char ram[0x10000];
+	unsigned char dsp[128];
+
+	unsigned char a, x, y, sp, psw;
+	unsigned short pc;
+	int halted;		/* SLEEP or STOP, until the next reset */
+
+	unsigned char in[4];	/* written by the host */
+	unsigned char out[4];	/* written by the spc700 */
+	unsigned char control;	/* $F1 */
+
+	int timer_div[3];	/* cycles towards the next stage tick */
+	int timer_stage[3];
+	int timer_target[3];	/* 1-256 */
+	unsigned char timer_out[3];
+
+	uint64_t cycles;	/* run since init */
+	uint64_t origin_ns;	/* host time of cycle 0 */
+	uint64_t latency_ns;
+} sim_state;
+
+static __thread sim_state *sim;
+
+/* the IPL rom at $FFC0 */
+static const unsigned char ipl_rom[64] = {
+	0xCD, 0xEF, 0xBD, 0xE8, 0x00, 0xC6, 0x1D, 0xD0,
+	0xFC, 0x8F, 0xAA, 0xF4, 0x8F, 0xBB, 0xF5, 0x78,
+	0xCC, 0xF4, 0xD0, 0xFB, 0x2F, 0x19, 0xEB, 0xF4,
+	0xD0, 0xFC, 0x7E, 0xF4, 0xD0, 0x0B, 0xE4, 0xF5,
+	0xCB, 0xF4, 0xD7, 0x00, 0xFC, 0xD0, 0xF3, 0xAB,
+	0x01, 0x10, 0xEF, 0x7E, 0xF4, 0x10, 0xEB, 0xBA,
+	0xF6, 0xDA, 0x00, 0xBA, 0xF4, 0xC4, 0xF4, 0xDD,
+	0x5D, 0xD0, 0xDB, 0x1F, 0x00, 0x00, 0xC0, 0xFF
+};
+
+/* cycles per opcode, branches taken add 2 */
+static const unsigned char op_cycles[256] = {
+	2,8,4,5,3,4,3,6,2,6,5,4,5,4,6,8,
+	2,8,4,5,4,5,5,6,5,5,6,5,2,2,4,6,
+	2,8,4,5,3,4,3,6,2,6,5,4,5,4,5,4,
+	2,8,4,5,4,5,5,6,5,5,6,5,2,2,3,8,
+	2,8,4,5,3,4,3,6,2,6,4,4,5,4,6,6,
+	2,8,4,5,4,5,5,6,5,5,4,5,2,2,4,3,
+	2,8,4,5,3,4,3,6,2,6,4,4,5,4,5,5,
+	2,8,4,5,4,5,5,6,5,5,5,5,2,2,3,6,
+	2,8,4,5,3,4,3,6,2,6,5,4,5,2,4,5,
+	2,8,4,5,4,5,5,6,5,5,5,5,2,2,12,5,
+	3,8,4,5,3,4,3,6,2,6,4,4,5,2,4,4,
+	2,8,4,5,4,5,5,6,5,5,5,5,2,2,3,4,
+	3,8,4,5,4,5,4,7,2,5,6,4,5,2,4,9,
+	2,8,4,5,5,6,6,7,4,5,5,5,2,2,6,3,
+	2,8,4,5,3,4,3,6,2,4,5,3,4,3,4,3,
+	2,8,4,5,4,5,5,6,3,4,5,4,2,2,4,3
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/******************** M E M O R Y **************************************/
+
+static unsigned char ioRead(sim_state *s, unsigned short address)
+{
+	unsigned char v;
+	int t;
+
+	switch (address)
+	{
+		case 0xf2:
+			return s->ram[0xf2];
+		case 0xf3:
+			return s->dsp[s->ram[0xf2] & 0x7f];
+		case 0xf4: case 0xf5: case 0xf6: case 0xf7:
+			return s->in[address - 0xf4];
+		case 0xf8: case 0xf9:
+			return s->ram[address];
+		case 0xfd: case 0xfe: case 0xff:
+			/* reading a counter clears it */
+			t = address - 0xfd;
+			v = s->timer_out[t];
+			s->timer_out[t] = 0;
+			return v;
+	}
+	/* $F0, $F1 and the timer targets are write only */
+	return 0;
+}
+
+static void ioWrite(sim_state *s, unsigned short address, unsigned char v)
+{
+	int t;
+
+	switch (address)
+	{
+		case 0xf1:
+			for (t=0; t<3; t++) {
+				/* a timer being enabled starts over */
+				if ((v & (1 << t)) && !(s->control & (1 << t))) {
+					s->timer_div[t] = 0;
+					s->timer_stage[t] = 0;
+					s->timer_out[t] = 0;
+				}
+			}
+			if (v & CTL_CLEAR01) { s->in[0] = s->in[1] = 0; }
+			if (v & CTL_CLEAR23) { s->in[2] = s->in[3] = 0; }
+			s->control = v;
+			break;
+		case 0xf3:
+			if (s->ram[0xf2] < 0x80) {
+				/* a write to ENDX clears it */
+				s->dsp[s->ram[0xf2]] = s->ram[0xf2] == 0x7c ? 0 : v;
+			}
+			break;
+		case 0xf4: case 0xf5: case 0xf6: case 0xf7:
+			s->out[address - 0xf4] = v;
+			break;
+		case 0xfa: case 0xfb: case 0xfc:
+			s->timer_target[address - 0xfa] = v ? v : 256;
+			break;
+	}
+}
+
+static unsigned char memRead(sim_state *s, unsigned short address)
+{
+	if (address >= 0xf0 && address <= 0xff) {
+		return ioRead(s, address);
+	}
+	if (address >= 0xffc0 && (s->control & CTL_ROM)) {
+		return ipl_rom[address - 0xffc0];
+	}
+	return s->ram[address];
+}
+
+/* the ram under the registers and the rom is written too */
+static void memWrite(sim_state *s, unsigned short address, unsigned char v)
+{
+	if (address >= 0xf0 && address <= 0xff) {
+		ioWrite(s, address, v);
+	}
+	s->ram[address] = v;
+}
+
+static unsigned short memRead16(sim_state *s, unsigned short address)
+{
+	return memRead(s, address) | (memRead(s, address + 1) << 8);
+}
+
+/******************** S P C 7 0 0 **************************************/
+
+static unsigned char fetch(sim_state *s)
+{
+	return memRead(s, s->pc++);
+}
+
+static unsigned short fetch16(sim_state *s)
+{
+	unsigned short w = fetch(s);
+
+	return w | (fetch(s) << 8);
+}
+
+/* direct page: $00xx, or $01xx with P set */
+static unsigned short dp(sim_state *s, unsigned char offset)
+{
+	return (s->psw & FLAG_P ? 0x100 : 0) | offset;
+}
+
+/* words in the direct page wrap within it */
+static unsigned short readDp16(sim_state *s, unsigned char offset)
+{
+	return memRead(s, dp(s, offset)) | (memRead(s, dp(s, offset + 1)) << 8);
+}
+
+static void writeDp16(sim_state *s, unsigned char offset, unsigned short w)
+{
+	memWrite(s, dp(s, offset), w & 0xff);
+	memWrite(s, dp(s, offset + 1), w >> 8);
+}
+
+static void push(sim_state *s, unsigned char v)
+{
+	memWrite(s, 0x100 | s->sp--, v);
+}
+
+static unsigned char pop(sim_state *s)
+{
+	return memRead(s, 0x100 | ++s->sp);
+}
+
+static void setFlag(sim_state *s, unsigned char flag, int on)
+{
+	s->psw = on ? s->psw | flag : s->psw & ~flag;
+}
+
+static unsigned char setNZ(sim_state *s, unsigned char v)
+{
+	setFlag(s, FLAG_N, v & 0x80);
+	setFlag(s, FLAG_Z, v == 0);
+	return v;
+}
+
+static void setNZ16(sim_state *s, unsigned short w)
+{
+	setFlag(s, FLAG_N, w & 0x8000);
+	setFlag(s, FLAG_Z, w == 0);
+}
+
+static unsigned char adc(sim_state *s, unsigned char a, unsigned char b)
+{
+	int r = a + b + (s->psw & FLAG_C);
+
+	setFlag(s, FLAG_V, ~(a ^ b) & (a ^ r) & 0x80);
+	setFlag(s, FLAG_H, (a ^ b ^ r) & 0x10);
+	setFlag(s, FLAG_C, r > 0xff);
+	return setNZ(s, r);
+}
+
+static void compare(sim_state *s, unsigned char a, unsigned char b)
+{
+	setNZ(s, a - b);
+	setFlag(s, FLAG_C, a >= b);
+}
+
+/* OR, AND, EOR, CMP, ADC, SBC by the opcode's top 3 bits. CMP leaves a
+ * unchanged. */
+static unsigned char alu(sim_state *s, int op, unsigned char a, unsigned char b)
+{
+	switch (op >> 5)
+	{
+		case 0: return setNZ(s, a | b);
+		case 1: return setNZ(s, a & b);
+		case 2: return setNZ(s, a ^ b);
+		case 3: compare(s, a, b); return a;
+		case 4: return adc(s, a, b);
+	}
+	return adc(s, a, ~b);
+}
+
+/* ASL, ROL, LSR, ROR, DEC, INC by the opcode's top 3 bits */
+static unsigned char modify(sim_state *s, int op, unsigned char v)
+{
+	int c = s->psw & FLAG_C;
+
+	switch (op >> 5)
+	{
+		case 0:
+			setFlag(s, FLAG_C, v & 0x80);
+			return setNZ(s, v << 1);
+		case 1:
+			setFlag(s, FLAG_C, v & 0x80);
+			return setNZ(s, (v << 1) | c);
+		case 2:
+			setFlag(s, FLAG_C, v & 1);
+			return setNZ(s, v >> 1);
+		case 3:
+			setFlag(s, FLAG_C, v & 1);
+			return setNZ(s, (v >> 1) | (c << 7));
+		case 4:
+			return setNZ(s, v - 1);
+	}
+	return setNZ(s, v + 1);
+}
+
+/* returns the extra cycles */
+static int branch(sim_state *s, int taken)
+{
+	signed char rel = fetch(s);
+
+	if (!taken) { return 0; }
+	s->pc += rel;
+	return 2;
+}
+
+/* the operand of the OR/AND/EOR/CMP/ADC/SBC rows, A being the target.
+ * low nibble 4-7, even rows: d, !a, (X), [d+X]; odd rows: d+X, !a+X,
+ * !a+Y, [d]+Y */
+static unsigned short aluAddress(sim_state *s, int op)
+{
+	unsigned short w;
+
+	if (!(op & 0x10))
+	{
+		switch (op & 0x0f)
+		{
+			case 0x4: return dp(s, fetch(s));
+			case 0x5: return fetch16(s);
+			case 0x6: return dp(s, s->x);
+		}
+		return readDp16(s, fetch(s) + s->x);
+	}
+	switch (op & 0x0f)
+	{
+		case 0x4: return dp(s, fetch(s) + s->x);
+		case 0x5: return fetch16(s) + s->x;
+		case 0x6: return fetch16(s) + s->y;
+	}
+	w = readDp16(s, fetch(s));
+	return w + s->y;
+}
+
+static void divide(sim_state *s)
+{
+	unsigned int ya = (s->y << 8) | s->a;
+	unsigned int x = s->x;
+
+	setFlag(s, FLAG_V, s->y >= x);
+	setFlag(s, FLAG_H, (s->y & 15) >= (x & 15));
+
+	/* the hardware's results for overflows too */
+	if (s->y < (x << 1)) {
+		s->a = ya / x;
+		s->y = ya % x;
+	} else {
+		s->a = 255 - (ya - (x << 9)) / (256 - x);
+		s->y = x + (ya - (x << 9)) % (256 - x);
+	}
+	setNZ(s, s->a);
+}
+
+/* one instruction, returns its cycles */
+static int step(sim_state *s)
+{
+	int op = fetch(s), cycles = op_cycles[op];
+	unsigned short addr, w, ya;
+	unsigned char d, v;
+	int bit, r;
+
+	/* the regular rows first: x1 TCALL, x2 SET1/CLR1, x3 BBS/BBC */
+	switch (op & 0x0f)
+	{
+		case 0x1:
+			push(s, s->pc >> 8);
+			push(s, s->pc & 0xff);
+			s->pc = memRead16(s, 0xffde - ((op >> 4) << 1));
+			return cycles;
+		case 0x2:
+			addr = dp(s, fetch(s));
+			v = memRead(s, addr);
+			bit = 1 << (op >> 5);
+			memWrite(s, addr, op & 0x10 ? v & ~bit : v | bit);
+			return cycles;
+		case 0x3:
+			v = memRead(s, dp(s, fetch(s)));
+			bit = v & (1 << (op >> 5));
+			return cycles + branch(s, op & 0x10 ? !bit : bit);
+	}
+
+	if (op < 0xc0)
+	{
+		switch (op & 0x0f)
+		{
+			case 0x4: case 0x5: case 0x6: case 0x7:
+				s->a = alu(s, op, s->a, memRead(s, aluAddress(s, op)));
+				return cycles;
+			case 0x8:
+				if (!(op & 0x10)) {
+					s->a = alu(s, op, s->a, fetch(s));
+					return cycles;
+				}
+				/* d,#i */
+				v = fetch(s);
+				addr = dp(s, fetch(s));
+				d = alu(s, op, memRead(s, addr), v);
+				if ((op >> 5) != 3) { memWrite(s, addr, d); }
+				return cycles;
+			case 0x9:
+				if (!(op & 0x10)) {
+					/* dd,ds */
+					v = memRead(s, dp(s, fetch(s)));
+					addr = dp(s, fetch(s));
+				} else {
+					/* (X),(Y) */
+					v = memRead(s, dp(s, s->y));
+					addr = dp(s, s->x);
+				}
+				d = alu(s, op, memRead(s, addr), v);
+				if ((op >> 5) != 3) { memWrite(s, addr, d); }
+				return cycles;
+		}
+	}
+
+	/* ASL ROL LSR ROR DEC INC on d, d+X, !a and A */
+	if (op < 0xc0 && ((op & 0x0f) == 0x0b || (op & 0x0f) == 0x0c))
+	{
+		if ((op & 0x1f) == 0x1c) {
+			s->a = modify(s, op, s->a);
+			return cycles;
+		}
+		switch (op & 0x1f)
+		{
+			case 0x0b: addr = dp(s, fetch(s)); break;
+			case 0x1b: addr = dp(s, fetch(s) + s->x); break;
+			default: addr = fetch16(s); break;
+		}
+		memWrite(s, addr, modify(s, op, memRead(s, addr)));
+		return cycles;
+	}
+
+	switch (op)
+	{
+		/* branches and flags */
+		case 0x00: break;
+		case 0x10: cycles += branch(s, !(s->psw & FLAG_N)); break;
+		case 0x30: cycles += branch(s, s->psw & FLAG_N); break;
+		case 0x50: cycles += branch(s, !(s->psw & FLAG_V)); break;
+		case 0x70: cycles += branch(s, s->psw & FLAG_V); break;
+		case 0x90: cycles += branch(s, !(s->psw & FLAG_C)); break;
+		case 0xb0: cycles += branch(s, s->psw & FLAG_C); break;
+		case 0xd0: cycles += branch(s, !(s->psw & FLAG_Z)); break;
+		case 0xf0: cycles += branch(s, s->psw & FLAG_Z); break;
+		case 0x2f: s->pc += (signed char)fetch(s); break;
+		case 0x20: s->psw &= ~FLAG_P; break;
+		case 0x40: s->psw |= FLAG_P; break;
+		case 0x60: s->psw &= ~FLAG_C; break;
+		case 0x80: s->psw |= FLAG_C; break;
+		case 0xa0: s->psw |= FLAG_I; break;
+		case 0xc0: s->psw &= ~FLAG_I; break;
+		case 0xe0: s->psw &= ~(FLAG_V | FLAG_H); break;
+		case 0xed: s->psw ^= FLAG_C; break;
+
+		/* single bits: m.b, address in the low 13 bits */
+		case 0x0a: case 0x2a: case 0x4a: case 0x6a:
+		case 0x8a: case 0xaa: case 0xca: case 0xea:
+			w = fetch16(s);
+			addr = w & 0x1fff;
+			bit = (memRead(s, addr) >> (w >> 13)) & 1;
+			switch (op)
+			{
+				case 0x0a: setFlag(s, FLAG_C, (s->psw & FLAG_C) | bit); break;
+				case 0x2a: setFlag(s, FLAG_C, (s->psw & FLAG_C) | !bit); break;
+				case 0x4a: setFlag(s, FLAG_C, (s->psw & FLAG_C) && bit); break;
+				case 0x6a: setFlag(s, FLAG_C, (s->psw & FLAG_C) && !bit); break;
+				case 0x8a: setFlag(s, FLAG_C, (s->psw & FLAG_C) ^ bit); break;
+				case 0xaa: setFlag(s, FLAG_C, bit); break;
+				case 0xca:
+					v = memRead(s, addr) & ~(1 << (w >> 13));
+					memWrite(s, addr, v | ((s->psw & FLAG_C) << (w >> 13)));
+					break;
+				case 0xea:
+					memWrite(s, addr, memRead(s, addr) ^ (1 << (w >> 13)));
+					break;
+			}
+			break;
+
+		/* words */
+		case 0x1a: case 0x3a:
+			d = fetch(s);
+			w = readDp16(s, d) + (op == 0x3a ? 1 : -1);
+			writeDp16(s, d, w);
+			setNZ16(s, w);
+			break;
+		case 0x5a:
+			ya = (s->y << 8) | s->a;
+			w = readDp16(s, fetch(s));
+			setNZ16(s, ya - w);
+			setFlag(s, FLAG_C, ya >= w);
+			break;
+		case 0x7a: case 0x9a:
+			ya = (s->y << 8) | s->a;
+			w = readDp16(s, fetch(s));
+			if (op == 0x7a) {
+				r = ya + w;
+				setFlag(s, FLAG_V, ~(ya ^ w) & (ya ^ r) & 0x8000);
+				setFlag(s, FLAG_H, (ya ^ w ^ r) & 0x1000);
+				setFlag(s, FLAG_C, r > 0xffff);
+			} else {
+				r = ya - w;
+				setFlag(s, FLAG_V, (ya ^ w) & (ya ^ r) & 0x8000);
+				setFlag(s, FLAG_H, !((ya ^ w ^ r) & 0x1000));
+				setFlag(s, FLAG_C, ya >= w);
+			}
+			s->a = r & 0xff;
+			s->y = (r >> 8) & 0xff;
+			setNZ16(s, r);
+			break;
+		case 0xba:
+			w = readDp16(s, fetch(s));
+			s->a = w & 0xff;
+			s->y = w >> 8;
+			setNZ16(s, w);
+			break;
+		case 0xda:
+			writeDp16(s, fetch(s), (s->y << 8) | s->a);
+			break;
+
+		/* moves */
+		case 0xc4: memWrite(s, dp(s, fetch(s)), s->a); break;
+		case 0xd4: memWrite(s, dp(s, fetch(s) + s->x), s->a); break;
+		case 0xc5: memWrite(s, fetch16(s), s->a); break;
+		case 0xd5: memWrite(s, fetch16(s) + s->x, s->a); break;
+		case 0xc6: memWrite(s, dp(s, s->x), s->a); break;
+		case 0xd6: memWrite(s, fetch16(s) + s->y, s->a); break;
+		case 0xc7: memWrite(s, readDp16(s, fetch(s) + s->x), s->a); break;
+		case 0xd7: w = readDp16(s, fetch(s)); memWrite(s, w + s->y, s->a); break;
+		case 0xaf: memWrite(s, dp(s, s->x++), s->a); break;
+		case 0xd8: memWrite(s, dp(s, fetch(s)), s->x); break;
+		case 0xd9: memWrite(s, dp(s, fetch(s) + s->y), s->x); break;
+		case 0xc9: memWrite(s, fetch16(s), s->x); break;
+		case 0xcb: memWrite(s, dp(s, fetch(s)), s->y); break;
+		case 0xdb: memWrite(s, dp(s, fetch(s) + s->x), s->y); break;
+		case 0xcc: memWrite(s, fetch16(s), s->y); break;
+		case 0x8f: v = fetch(s); memWrite(s, dp(s, fetch(s)), v); break;
+		case 0xfa: v = memRead(s, dp(s, fetch(s))); memWrite(s, dp(s, fetch(s)), v); break;
+
+		case 0xe4: s->a = setNZ(s, memRead(s, dp(s, fetch(s)))); break;
+		case 0xf4: s->a = setNZ(s, memRead(s, dp(s, fetch(s) + s->x))); break;
+		case 0xe5: s->a = setNZ(s, memRead(s, fetch16(s))); break;
+		case 0xf5: s->a = setNZ(s, memRead(s, fetch16(s) + s->x)); break;
+		case 0xe6: s->a = setNZ(s, memRead(s, dp(s, s->x))); break;
+		case 0xf6: s->a = setNZ(s, memRead(s, fetch16(s) + s->y)); break;
+		case 0xe7: s->a = setNZ(s, memRead(s, readDp16(s, fetch(s) + s->x))); break;
+		case 0xf7: w = readDp16(s, fetch(s)); s->a = setNZ(s, memRead(s, w + s->y)); break;
+		case 0xbf: s->a = setNZ(s, memRead(s, dp(s, s->x++))); break;
+		case 0xe8: s->a = setNZ(s, fetch(s)); break;
+		case 0xf8: s->x = setNZ(s, memRead(s, dp(s, fetch(s)))); break;
+		case 0xf9: s->x = setNZ(s, memRead(s, dp(s, fetch(s) + s->y))); break;
+		case 0xe9: s->x = setNZ(s, memRead(s, fetch16(s))); break;
+		case 0xcd: s->x = setNZ(s, fetch(s)); break;
+		case 0xeb: s->y = setNZ(s, memRead(s, dp(s, fetch(s)))); break;
+		case 0xfb: s->y = setNZ(s, memRead(s, dp(s, fetch(s) + s->x))); break;
+		case 0xec: s->y = setNZ(s, memRead(s, fetch16(s))); break;
+		case 0x8d: s->y = setNZ(s, fetch(s)); break;
+
+		case 0x5d: s->x = setNZ(s, s->a); break;
+		case 0x7d: s->a = setNZ(s, s->x); break;
+		case 0xdd: s->a = setNZ(s, s->y); break;
+		case 0xfd: s->y = setNZ(s, s->a); break;
+		case 0x9d: s->x = setNZ(s, s->sp); break;
+		case 0xbd: s->sp = s->x; break;
+
+		/* registers */
+		case 0xdc: s->y = setNZ(s, s->y - 1); break;
+		case 0xfc: s->y = setNZ(s, s->y + 1); break;
+		case 0x1d: s->x = setNZ(s, s->x - 1); break;
+		case 0x3d: s->x = setNZ(s, s->x + 1); break;
+		case 0xc8: compare(s, s->x, fetch(s)); break;
+		case 0xad: compare(s, s->y, fetch(s)); break;
+		case 0x1e: compare(s, s->x, memRead(s, fetch16(s))); break;
+		case 0x3e: compare(s, s->x, memRead(s, dp(s, fetch(s)))); break;
+		case 0x5e: compare(s, s->y, memRead(s, fetch16(s))); break;
+		case 0x7e: compare(s, s->y, memRead(s, dp(s, fetch(s)))); break;
+
+		case 0x9f: s->a = setNZ(s, (s->a >> 4) | (s->a << 4)); break;
+		case 0xcf:
+			w = s->y * s->a;
+			s->a = w & 0xff;
+			s->y = setNZ(s, w >> 8);
+			break;
+		case 0x9e: divide(s); break;
+		case 0xdf:
+			if ((s->psw & FLAG_C) || s->a > 0x99) {
+				s->a += 0x60;
+				s->psw |= FLAG_C;
+			}
+			if ((s->psw & FLAG_H) || (s->a & 15) > 9) {
+				s->a += 6;
+			}
+			setNZ(s, s->a);
+			break;
+		case 0xbe:
+			if (!(s->psw & FLAG_C) || s->a > 0x99) {
+				s->a -= 0x60;
+				s->psw &= ~FLAG_C;
+			}
+			if (!(s->psw & FLAG_H) || (s->a & 15) > 9) {
+				s->a -= 6;
+			}
+			setNZ(s, s->a);
+			break;
+
+		case 0x0e: case 0x4e:
+			addr = fetch16(s);
+			v = memRead(s, addr);
+			setNZ(s, s->a - v);
+			memWrite(s, addr, op == 0x0e ? v | s->a : v & ~s->a);
+			break;
+
+		/* loops */
+		case 0x2e:
+			v = memRead(s, dp(s, fetch(s)));
+			cycles += branch(s, s->a != v);
+			break;
+		case 0xde:
+			v = memRead(s, dp(s, fetch(s) + s->x));
+			cycles += branch(s, s->a != v);
+			break;
+		case 0x6e:
+			addr = dp(s, fetch(s));
+			v = memRead(s, addr) - 1;
+			memWrite(s, addr, v);
+			cycles += branch(s, v != 0);
+			break;
+		case 0xfe:
+			s->y--;
+			cycles += branch(s, s->y != 0);
+			break;
+
+		/* stack and calls */
+		case 0x0d: push(s, s->psw); break;
+		case 0x2d: push(s, s->a); break;
+		case 0x4d: push(s, s->x); break;
+		case 0x6d: push(s, s->y); break;
+		case 0x8e: s->psw = pop(s); break;
+		case 0xae: s->a = pop(s); break;
+		case 0xce: s->x = pop(s); break;
+		case 0xee: s->y = pop(s); break;
+		case 0x3f: case 0x4f:
+			addr = op == 0x3f ? fetch16(s) : 0xff00 | fetch(s);
+			push(s, s->pc >> 8);
+			push(s, s->pc & 0xff);
+			s->pc = addr;
+			break;
+		case 0x0f:
+			push(s, s->pc >> 8);
+			push(s, s->pc & 0xff);
+			push(s, s->psw);
+			s->psw = (s->psw | FLAG_B) & ~FLAG_I;
+			s->pc = memRead16(s, 0xffde);
+			break;
+		case 0x6f:
+			s->pc = pop(s);
+			s->pc |= pop(s) << 8;
+			break;
+		case 0x7f:
+			s->psw = pop(s);
+			s->pc = pop(s);
+			s->pc |= pop(s) << 8;
+			break;
+		case 0x5f: s->pc = fetch16(s); break;
+		case 0x1f: s->pc = memRead16(s, fetch16(s) + s->x); break;
+
+		case 0xef: case 0xff:
+			s->halted = 1;
+			break;
+
+		default:
+			fprintf(stderr, "apu_sim: opcode %02X at %04X not handled\n", op, s->pc - 1);
+			s->halted = 1;
+			break;
+	}
+	return cycles;
+}
+
+static void tickTimers(sim_state *s, int cycles)
+{
+	int t, period;
+
+	for (t=0; t<3; t++)
+	{
+		if (!(s->control & (1 << t))) { continue; }
+
+		/* 8 kHz for timers 0 and 1, 64 kHz for timer 2 */
+		period = t == 2 ? 16 : 128;
+		s->timer_div[t] += cycles;
+		while (s->timer_div[t] >= period) {
+			s->timer_div[t] -= period;
+			if (++s->timer_stage[t] >= s->timer_target[t]) {
+				s->timer_stage[t] = 0;
+				s->timer_out[t] = (s->timer_out[t] + 1) & 15;
+			}
+		}
+	}
+}
+
+/* Bring the spc700 up to the host's time. It never runs ahead of it:
+ * the loaders' pacing and the timeouts measure the host's clock. */
+static void catchUp(sim_state *s)
+{
+	uint64_t target, start;
+	int cycles;
+
+	if (s->latency_ns) {
+		start = now_ns();
+		while (now_ns() - start < s->latency_ns)
+			;
+	}
+
+	target = (now_ns() - s->origin_ns) * SIM_HZ / 1000000000;
+	if (target > s->cycles + SIM_MAX_CATCHUP) {
+		s->cycles = target - SIM_MAX_CATCHUP;
+	}
+
+	while (s->cycles < target)
+	{
+		cycles = s->halted ? target - s->cycles : step(s);
+		s->cycles += cycles;
+		tickTimers(s, cycles);
+	}
+}
+
+/******************** A P U _ O P S ************************************/
+
+static unsigned char apu_sim_read(int address)
+{
+	catchUp(sim);
+	return sim->out[address & 3];
+}
+
+static void apu_sim_write(int address, unsigned char data)
+{
+	catchUp(sim);
+	sim->in[address & 3] = data;
+}
+
+/* The ram is kept. The rom clears the zero page and waits with $AA $BB
+ * on the ports, which the next accesses will let it do. The program
+ * that was running first gets the cycles it is owed until now. */
+static void apu_sim_reset(void)
+{
+	sim_state *s = sim;
+
+	catchUp(s);
+
+	memset(s->in, 0, sizeof(s->in));
+	memset(s->out, 0, sizeof(s->out));
+	memset(s->timer_out, 0, sizeof(s->timer_out));
+	s->control = CTL_ROM;
+	/* the dsp reset mutes and stops every voice, echo writes off */
+	s->dsp[0x6c] = 0xe0;
+	s->a = s->x = s->y = 0;
+	s->sp = 0xef;
+	s->psw = 0;
+	s->halted = 0;
+	s->pc = memRead16(s, 0xfffe);
+}
+
+static int apu_sim_init(char *cmdline)
+{
+	double latency = 0;
+	char *end;
+
+	if (cmdline && strncmp(cmdline, "sim", 3) == 0) {
+		cmdline += 3;
+	}
+	if (cmdline && *cmdline == ':') {
+		latency = strtod(cmdline + 1, &end);
+		if (end == cmdline + 1 || *end || latency < 0) {
+			fprintf(stderr, "Bad latency '%s', use sim[:microseconds]\n", cmdline + 1);
+			return -1;
+		}
+	}
+	else if (cmdline && *cmdline) {
+		fprintf(stderr, "Use sim[:microseconds]\n");
+		return -1;
+	}
+
+	if (sim == NULL) {
+		sim = calloc(1, sizeof(sim_state));
+		if (sim == NULL) {
+			perror("calloc");
+			return -1;
+		}
+	}
+	sim->latency_ns = latency * 1000;
+	sim->origin_ns = now_ns();
+	sim->cycles = 0;
+	sim->timer_target[0] = sim->timer_target[1] = sim->timer_target[2] = 256;
+
+	apu_sim_reset();
+	return 0;
+}
+
+static void apu_sim_shutdown(void)
+{
+	free(sim);
+	sim = NULL;
+}
+
+static APU_ops ops = {
+	apu_sim_read,
+	apu_sim_write,
+	apu_sim_reset,
+	apu_sim_init,
+	apu_sim_shutdown,
+	NULL,
+	NULL
+};
+
+APU_ops *apu_sim_getOps(void)
+{
+	return &ops;
+}
+
@@ -0,0 +1,36 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _apu_sim_h__
+#define _apu_sim_h__
+
+#include "apu.h"
+
+/* APU io layer without hardware: an spc700 running the real IPL rom
+ * behind the four ports, with the dsp register file and the timers but
+ * no sound. It runs at the chip's 1.024 MHz against the host's clock, so
+ * the stream loader's pacing and the timeouts behave as on a board, and
+ * the ram survives a reset as it does on the real chip.
+ *
+ * The init cmdline is "sim[:latency]": each port access then takes
+ * latency microseconds (busy waiting), standing in for a slower bus.
+ *
+ * The state belongs to the calling thread, like the mcp23x17 one.
+ */
+APU_ops *apu_sim_getOps(void);
+
+#endif // _apu_sim_h__
@@ -0,0 +1,554 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "apud.h"
+#include "apu.h"
+#include "apuplay.h"
+#include "spcfile.h"
+#include "prefetch.h"
+
+extern int g_playing; // from main.c
+extern int g_exit_now;
+extern int g_verbose;
+
+#define MAX_CLIENTS	8
+#define CLIENT_BUFSIZE	4352
+/* replies not yet read by a client, it is dropped beyond this */
+#define CLIENT_OUTMAX	(1024*1024)
+
+/* songs without a length in their tag */
+#define DEFAULT_LENGTH_MS	150000
+
+typedef struct {
+	int fd;
+	char buf[CLIENT_BUFSIZE];
+	int len;
+	char *out;
+	size_t out_len, out_size;
+	int gone;	/* to be closed, see reply() */
+} client;
+
+static client clients[MAX_CLIENTS];
+
+static char **queue;
+static int queue_count;
+static int current = -1;	/* the song playing or last played */
+static int playing;
+static id666_tag tag;
+static unsigned int length_ms;
+static struct timeval started;
+
+/* the prefetch runs over queue[prefetch_base..] and has handed out
+ * songs up to prefetch_last */
+static int prefetch_base = -1, prefetch_last;
+static int depth;
+
+static volatile sig_atomic_t quit_now;
+
+static void stopSignal(int sig)
+{
+	quit_now = 1;
+	g_exit_now = 1;
+}
+
+/* send what the socket takes without blocking */
+static void flushClient(client *c)
+{
+	ssize_t res;
+
+	while (c->out_len && !c->gone)
+	{
+		res = send(c->fd, c->out, c->out_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (res < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				c->gone = 1;
+			}
+			return;
+		}
+		c->out_len -= res;
+		memmove(c->out, c->out + res, c->out_len);
+	}
+}
+
+/* Replies are queued per client and sent as its socket takes them, so
+ * playback and the other clients never wait for one that does not
+ * read. A client with more than CLIENT_OUTMAX bytes unread is dropped. */
+static void reply(int fd, const char *fmt, ...)
+{
+	char line[CLIENT_BUFSIZE];
+	client *c = NULL;
+	va_list ap;
+	size_t size;
+	char *grown;
+	int i, len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	if (len >= sizeof(line)) { len = sizeof(line) - 1; }
+
+	for (i=0; i<MAX_CLIENTS; i++) {
+		if (clients[i].fd == fd) { c = &clients[i]; }
+	}
+	/* refused at the door, the line goes out or not */
+	if (c == NULL) {
+		send(fd, line, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+		return;
+	}
+	if (c->gone) { return; }
+
+	if (c->out_len + len > c->out_size)
+	{
+		size = c->out_size ? c->out_size * 2 : CLIENT_BUFSIZE;
+		while (size < c->out_len + len) { size *= 2; }
+		grown = size <= CLIENT_OUTMAX ? realloc(c->out, size) : NULL;
+		if (grown == NULL) {
+			if (g_verbose) { printf("Dropping a client that does not read\n"); }
+			c->gone = 1;
+			return;
+		}
+		c->out = grown;
+		c->out_size = size;
+	}
+	memcpy(c->out + c->out_len, line, len);
+	c->out_len += len;
+	flushClient(c);
+}
+
+static void closeClient(client *c)
+{
+	close(c->fd);
+	c->fd = -1;
+	free(c->out);
+	c->out = NULL;
+	c->out_len = c->out_size = 0;
+}
+
+static unsigned int elapsedMs(void)
+{
+	struct timeval tv_now;
+
+	gettimeofday(&tv_now, NULL);
+	return (tv_now.tv_sec - started.tv_sec) * 1000 +
+		(tv_now.tv_usec - started.tv_usec) / 1000;
+}
+
+static void stopPrefetch(void)
+{
+	if (prefetch_base >= 0) {
+		prefetch_stop();
+	}
+	prefetch_base = -1;
+}
+
+static void startPrefetch(int first)
+{
+	stopPrefetch();
+	if (first < 0 || first >= queue_count) { return; }
+
+	if (prefetch_start(&queue[first], queue_count - first, depth) == 0) {
+		prefetch_base = first;
+		prefetch_last = first - 1;
+	}
+}
+
+static void stopSong(void)
+{
+	if (playing) {
+		apu_reset();
+	}
+	playing = 0;
+}
+
+/* returns -1 if the song could not be loaded, 0 otherwise */
+static int startSong(int n)
+{
+	prefetch_item *item;
+	int res;
+
+	if (n < 0 || n >= queue_count) { return -1; }
+
+	stopSong();
+	current = n;
+
+	/* the prefetch only moves forward */
+	if (prefetch_base < 0 || n <= prefetch_last) {
+		startPrefetch(n);
+	}
+	if (prefetch_base < 0) { return -1; }
+
+	item = prefetch_get(n - prefetch_base);
+	prefetch_last = n;
+	if (item == NULL) { return -1; }
+
+	g_playing = 1;
+	res = item->res;
+	if (res == 0) {
+		res = LoadAPU_image(&item->img);
+	}
+	if (res == 0 && g_playing && !g_exit_now)
+	{
+		memcpy(&tag, &item->tag, sizeof(id666_tag));
+		length_ms = id666_duration(&tag);
+		if (length_ms == 0) {
+			length_ms = DEFAULT_LENGTH_MS;
+		}
+		gettimeofday(&started, NULL);
+		playing = 1;
+	}
+	prefetch_release(item);
+
+	if (g_verbose && playing) {
+		printf("Playing '%s'\n", queue[n]);
+	}
+	return playing ? 0 : -1;
+}
+
+/* the first song from n on that can be played */
+static void playFrom(int n)
+{
+	while (n < queue_count && !quit_now && startSong(n) < 0) {
+		n++;
+	}
+}
+
+/* the prefetch reads the queue, it must not run while it changes */
+static int addSongs(char *arg)
+{
+	char **files, **grown;
+	int i, count;
+
+	files = spcfile_list(&arg, 1, &count);
+	if (files == NULL) { return -1; }
+
+	stopPrefetch();
+	grown = realloc(queue, (queue_count + count + 1) * sizeof(char*));
+	if (grown == NULL) {
+		perror("realloc");
+		for (i=0; i<count; i++) { free(files[i]); }
+		free(files);
+		return -1;
+	}
+	queue = grown;
+	memcpy(&queue[queue_count], files, count * sizeof(char*));
+	queue_count += count;
+	free(files);
+
+	if (playing) {
+		startPrefetch(current + 1);
+	}
+	return count;
+}
+
+static void clearQueue(void)
+{
+	int i;
+
+	stopSong();
+	stopPrefetch();
+	for (i=0; i<queue_count; i++) {
+		free(queue[i]);
+	}
+	queue_count = 0;
+	current = -1;
+}
+
+static void sendStatus(int fd)
+{
+	reply(fd, "state %s\n", playing ? "playing" : "stopped");
+	if (current >= 0 && current < queue_count)
+	{
+		reply(fd, "song %d\n", current + 1);
+		reply(fd, "file %s\n", queue[current]);
+	}
+	if (playing)
+	{
+		reply(fd, "title %s\n", tag.title);
+		reply(fd, "game %s\n", tag.game_title);
+		reply(fd, "artist %s\n", tag.artist);
+		reply(fd, "elapsed %u\n", elapsedMs());
+		reply(fd, "length %u\n", length_ms);
+	}
+}
+
+static void command(int fd, char *line)
+{
+	char *arg;
+	int i, n;
+
+	arg = strchr(line, ' ');
+	if (arg) {
+		*arg++ = 0;
+		while (*arg == ' ') { arg++; }
+	}
+
+	if (strcmp(line, "queue")==0)
+	{
+		if (arg == NULL || *arg == 0) {
+			reply(fd, "ERR queue what?\n");
+			return;
+		}
+		n = addSongs(arg);
+		if (n < 0) {
+			reply(fd, "ERR out of memory\n");
+			return;
+		}
+		reply(fd, "OK %d queued\n", n);
+	}
+	else if (strcmp(line, "clear")==0)
+	{
+		clearQueue();
+		reply(fd, "OK\n");
+	}
+	else if (strcmp(line, "play")==0 || strcmp(line, "next")==0 ||
+			strcmp(line, "prev")==0)
+	{
+		n = current < 0 ? 0 : current;
+		if (line[0] == 'n') { n = current + 1; }
+		if (line[0] == 'p' && line[1] == 'r') { n = current - 1; }
+		if (arg && *arg) { n = atoi(arg) - 1; }
+
+		if (n < 0 || n >= queue_count) {
+			reply(fd, "ERR no song %d\n", n + 1);
+		}
+		else if (startSong(n) < 0) {
+			reply(fd, "ERR cannot play %s\n", queue[n]);
+		}
+		else {
+			reply(fd, "OK\n");
+		}
+	}
+	else if (strcmp(line, "stop")==0)
+	{
+		stopSong();
+		reply(fd, "OK\n");
+	}
+	else if (strcmp(line, "status")==0)
+	{
+		sendStatus(fd);
+		reply(fd, "OK\n");
+	}
+	else if (strcmp(line, "list")==0)
+	{
+		for (i=0; i<queue_count; i++) {
+			reply(fd, "%d %s\n", i + 1, queue[i]);
+		}
+		reply(fd, "OK\n");
+	}
+	else if (strcmp(line, "quit")==0)
+	{
+		quit_now = 1;
+		reply(fd, "OK\n");
+	}
+	else if (line[0])
+	{
+		reply(fd, "ERR unknown command '%s'\n", line);
+	}
+}
+
+/* returns -1 when the client is gone */
+static int readClient(client *c)
+{
+	char *start, *end;
+	int res;
+
+	res = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+	if (res <= 0) { return -1; }
+	c->len += res;
+	c->buf[c->len] = 0;
+
+	start = c->buf;
+	while ((end = strchr(start, '\n')) != NULL)
+	{
+		*end = 0;
+		if (end > start && end[-1] == '\r') { end[-1] = 0; }
+		command(c->fd, start);
+		start = end + 1;
+	}
+
+	c->len -= start - c->buf;
+	memmove(c->buf, start, c->len);
+
+	/* a line longer than the buffer */
+	if (c->len == sizeof(c->buf) - 1) {
+		reply(c->fd, "ERR line too long\n");
+		c->len = 0;
+	}
+	return 0;
+}
+
+static int openSocket(const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long\n");
+		return -1;
+	}
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	/* left over by a previous run, anything else is not ours */
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "%s exists and is not a socket\n", path);
+			close(fd);
+			return -1;
+		}
+		unlink(path);
+	}
+
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+			listen(fd, MAX_CLIENTS) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void acceptClient(int lfd)
+{
+	int fd, i;
+
+	fd = accept(lfd, NULL, NULL);
+	if (fd < 0) { return; }
+
+	for (i=0; i<MAX_CLIENTS; i++) {
+		if (clients[i].fd < 0) {
+			clients[i].fd = fd;
+			clients[i].len = 0;
+			clients[i].gone = 0;
+			return;
+		}
+	}
+	reply(fd, "ERR too many clients\n");
+	close(fd);
+}
+
+int apud_run(const char *path, char **files, int count, int prefetch_depth)
+{
+	struct pollfd fds[MAX_CLIENTS + 1];
+	struct sigaction sa;
+	int lfd, i, n, res, timeout;
+	int slot[MAX_CLIENTS + 1];
+
+	lfd = openSocket(path);
+	if (lfd < 0) { return -1; }
+
+	/* no SA_RESTART: a signal interrupts poll() */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stopSignal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	for (i=0; i<MAX_CLIENTS; i++) {
+		clients[i].fd = -1;
+	}
+	depth = prefetch_depth;
+	queue = files;
+	queue_count = count;
+	playFrom(0);
+
+	while (!quit_now)
+	{
+		timeout = -1;
+		if (playing) {
+			res = length_ms - elapsedMs();
+			timeout = res > 0 ? res : 0;
+		}
+
+		fds[0].fd = lfd;
+		fds[0].events = POLLIN;
+		n = 1;
+		for (i=0; i<MAX_CLIENTS; i++) {
+			if (clients[i].fd >= 0) {
+				fds[n].fd = clients[i].fd;
+				fds[n].events = POLLIN;
+				if (clients[i].out_len) { fds[n].events |= POLLOUT; }
+				slot[n] = i;
+				n++;
+			}
+		}
+
+		res = poll(fds, n, timeout);
+		if (res < 0) {
+			if (errno == EINTR) { continue; }
+			perror("poll");
+			break;
+		}
+
+		if (playing && elapsedMs() >= length_ms)
+		{
+			stopSong();
+			playFrom(current + 1);
+		}
+
+		if (fds[0].revents & POLLIN) {
+			acceptClient(lfd);
+		}
+		for (i=1; i<n; i++)
+		{
+			if (fds[i].revents == 0) { continue; }
+			if (fds[i].revents & POLLOUT) {
+				flushClient(&clients[slot[i]]);
+			}
+			if ((fds[i].revents & ~POLLOUT) && readClient(&clients[slot[i]]) < 0) {
+				clients[slot[i]].gone = 1;
+			}
+		}
+		/* also those a reply to another client found gone */
+		for (i=0; i<MAX_CLIENTS; i++) {
+			if (clients[i].fd >= 0 && clients[i].gone) {
+				closeClient(&clients[i]);
+			}
+		}
+	}
+
+	stopSong();
+	stopPrefetch();
+	for (i=0; i<MAX_CLIENTS; i++) {
+		if (clients[i].fd >= 0) { closeClient(&clients[i]); }
+	}
+	close(lfd);
+	unlink(path);
+
+	return 0;
+}
+
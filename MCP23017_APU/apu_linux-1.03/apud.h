@@ -0,0 +1,46 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _apud_h__
+#define _apud_h__
+
+/* Resident player: the apu interface stays open and a play queue is
+ * driven over a unix socket, one command per line. Each command gets
+ * zero or more lines of data and then "OK" or "ERR <reason>".
+ *
+ *   queue <file>    add a song, or the .spc members of a zip
+ *   clear           empty the queue and stop
+ *   play [n]        play song n of the queue (from 1), by default
+ *                   the current one
+ *   next, prev      the next or previous song of the queue
+ *   stop            reset the apu
+ *   status          "state", "song", "file", "title", "game",
+ *                   "artist", "elapsed" and "length" lines, times
+ *                   in milliseconds
+ *   list            one line per song: "<n> <file>"
+ *   quit            stop and leave
+ *
+ * The songs after the current one are prepared in advance as with
+ * apuplay -P. */
+
+/* Serve on 'path', starting with files[0..count-1] queued and the
+ * first one playing if there is one. The apu ops must be set up.
+ *
+ * returns -1 on error, 0 after a quit command or a signal */
+int apud_run(const char *path, char **files, int count, int depth);
+
+#endif // _apud_h__
@@ -0,0 +1,206 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include "apudev.h"
+#include "apuplay.h"
+
+#define CMD_NONE	0
+#define CMD_INIT	1
+#define CMD_STAGE	2
+#define CMD_START	3
+#define CMD_RESET	4
+#define CMD_QUIT	5
+
+struct apudev {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	int cmd;	/* CMD_NONE once the thread took it */
+	int busy;	/* until the command is done */
+	int result;
+	spcimage *img;
+
+	APU_ops *ops;
+	char bus[256];
+	apu_dev *dev;
+};
+
+static int run(apudev *d, int cmd, spcimage *img)
+{
+	switch (cmd)
+	{
+		case CMD_INIT:
+			return d->ops->init(d->bus);
+		case CMD_STAGE:
+			return LoadAPU_stage(img);
+		case CMD_START:
+			LoadAPU_start(img);
+			return 0;
+		case CMD_RESET:
+			apu_reset();
+			return 0;
+		case CMD_QUIT:
+			d->ops->shutdown();
+			return 0;
+	}
+	return -1;
+}
+
+static void *devThread(void *arg)
+{
+	apudev *d = arg;
+	spcimage *img;
+	int cmd, res;
+
+	apu_useDevice(d->dev);
+
+	pthread_mutex_lock(&d->lock);
+	do
+	{
+		while (d->cmd == CMD_NONE) {
+			pthread_cond_wait(&d->cond, &d->lock);
+		}
+		cmd = d->cmd;
+		img = d->img;
+		d->cmd = CMD_NONE;
+		pthread_mutex_unlock(&d->lock);
+
+		res = run(d, cmd, img);
+
+		pthread_mutex_lock(&d->lock);
+		d->result = res;
+		d->busy = 0;
+		pthread_cond_broadcast(&d->cond);
+	}
+	while (cmd != CMD_QUIT);
+	pthread_mutex_unlock(&d->lock);
+
+	return NULL;
+}
+
+static void post(apudev *d, int cmd, spcimage *img)
+{
+	pthread_mutex_lock(&d->lock);
+	while (d->busy) {
+		pthread_cond_wait(&d->cond, &d->lock);
+	}
+	d->cmd = cmd;
+	d->img = img;
+	d->busy = 1;
+	apu_setCancel(d->dev, 0);
+	pthread_cond_broadcast(&d->cond);
+	pthread_mutex_unlock(&d->lock);
+}
+
+int apudev_wait(apudev *d)
+{
+	int res;
+
+	pthread_mutex_lock(&d->lock);
+	while (d->busy) {
+		pthread_cond_wait(&d->cond, &d->lock);
+	}
+	res = d->result;
+	pthread_mutex_unlock(&d->lock);
+
+	return res;
+}
+
+apudev *apudev_open(APU_ops *ops, const char *bus)
+{
+	sigset_t all, old;
+	apudev *d;
+	int res;
+
+	d = calloc(1, sizeof(apudev));
+	if (d == NULL) {
+		perror("calloc");
+		return NULL;
+	}
+	d->ops = ops;
+	snprintf(d->bus, sizeof(d->bus), "%s", bus ? bus : "");
+	d->dev = apu_newDevice(ops);
+	if (d->dev == NULL) {
+		free(d);
+		return NULL;
+	}
+	pthread_mutex_init(&d->lock, NULL);
+	pthread_cond_init(&d->cond, NULL);
+
+	/* the thread starts with every signal blocked */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	res = pthread_create(&d->thread, NULL, devThread, d);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (res != 0) {
+		fprintf(stderr, "Cannot start a thread for the apu on '%s'\n", d->bus);
+		apu_freeDevice(d->dev);
+		free(d);
+		return NULL;
+	}
+
+	post(d, CMD_INIT, NULL);
+	if (apudev_wait(d) < 0)
+	{
+		post(d, CMD_QUIT, NULL);
+		pthread_join(d->thread, NULL);
+		apu_freeDevice(d->dev);
+		free(d);
+		return NULL;
+	}
+	return d;
+}
+
+void apudev_stage(apudev *d, spcimage *img)
+{
+	post(d, CMD_STAGE, img);
+}
+
+void apudev_cancel(apudev *d)
+{
+	apu_setCancel(d->dev, 1);
+}
+
+void apudev_start(apudev *d, spcimage *img)
+{
+	post(d, CMD_START, img);
+	apudev_wait(d);
+}
+
+void apudev_reset(apudev *d)
+{
+	post(d, CMD_RESET, NULL);
+	apudev_wait(d);
+}
+
+void apudev_close(apudev *d)
+{
+	post(d, CMD_QUIT, NULL);
+	pthread_join(d->thread, NULL);
+
+	apu_freeDevice(d->dev);
+	pthread_mutex_destroy(&d->lock);
+	pthread_cond_destroy(&d->cond);
+	free(d);
+}
+
@@ -0,0 +1,56 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _apudev_h__
+#define _apudev_h__
+
+#include "apu.h"
+#include "spcimage.h"
+
+/* One thread per apu. The thread owns an apu_dev and the bus state
+ * of its backend, and runs the commands handed to it one at a time.
+ * Signals are blocked in it, they go to the thread that created it. */
+typedef struct apudev apudev;
+
+/* Start a thread and initialize ops on 'bus' in it (see the init
+ * cmdline of the backend).
+ *
+ * returns NULL on error */
+apudev *apudev_open(APU_ops *ops, const char *bus);
+
+/* Begin LoadAPU_stage(img) and return at once. img must stay valid
+ * until apudev_wait() returns. */
+void apudev_stage(apudev *d, spcimage *img);
+
+/* Wait for the last command to finish.
+ *
+ * returns what LoadAPU_stage returned, 0 for the other commands */
+int apudev_wait(apudev *d);
+
+/* Make a staging in progress give up, apudev_wait() then returns 1.
+ * Only this apu is affected, the next command runs normally. */
+void apudev_cancel(apudev *d);
+
+/* LoadAPU_start(img) on a staged apu, and apu_reset(). Both wait for
+ * the command to finish. */
+void apudev_start(apudev *d, spcimage *img);
+void apudev_reset(apudev *d);
+
+/* shut the backend down and stop the thread */
+void apudev_close(apudev *d);
+
+#endif // _apudev_h__
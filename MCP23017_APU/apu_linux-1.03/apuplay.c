@@ -18,12 +18,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
 #include "apu.h"
 #ifdef PROGRESS_SPINNER
 #include "pspin.h"
 #endif
-#include "bootcode.h"
 #include "dsploader.h"
+#include "fastloader.h"
+#include "lzloader.h"
+#include "readloader.h"
+#include "streamloader.h"
+#include "verifyloader.h"
+#include "spcpack.h"
+#include "spcimage.h"
+#include "spcfile.h"
 #include "apuplay.h"
 
 /*
@@ -37,157 +45,359 @@ extern int g_verbose; // from main.c
 extern int g_debug; // from main.c
 extern int g_progress; // from main.c
 extern int g_exit_now; // from main.c
-extern int g_playing; // from main.c
+extern int g_upload_mode; // from main.c
+extern int g_verify; // from main.c
 
-int LoadAPU(FILE *fptr)
+/* fast loader data per apu_writeFast call, 256 handshakes */
+#define FAST_CHUNK	(FASTLOADER_STRIDE * 256)
+
+/* returns -1 on error, 1 when interrupted */
+static int sendZeroPage(unsigned char *spcdata)
 {
-	int i=0, j=0, count=0;
-	
-	unsigned char spc_pcl;
-	unsigned char spc_pch;
-	unsigned char spc_a;
-	unsigned char spc_x;
-	unsigned char spc_y;
-	unsigned char spc_sw;
-	unsigned char spc_sp;
+	int i;
 
-	unsigned char spcdata[65536];
-	unsigned char spcram[64];
-	unsigned char dspdata[128];
+	apu_setPhase(APU_PHASE_ZEROPAGE);
+	if (apu_initTransfer(0x0002)<0) {
+		fprintf(stderr, "timeout 4\n"); return -1; 
+	}
 
-	int echosize, echoregion, bootptr, echoclear=2, readcount;
-	
-	fseek(fptr, 0x25, SEEK_SET);
+	/* send the first part of the memory (0x02 to 0xef)
+	 * After 0xef comes spc700 registers (0xf0 to 0xff). Those
+	 * are taken care of by the bootcode */
+	for (i=2; i<=0xef; i+=16)
+	{
+		/* apu_initTransfer set the handshake counter to 0, i.e. i-2 */
+		if (apu_writeBytes(&spcdata[i], 0xef-i+1 < 16 ? 0xef-i+1 : 16)) {
+			fprintf(stderr, "timeout 5\n"); return -1; 
+		}
+#ifdef PROGRESS_SPINNER
+		if (g_progress) 
+			pspin_update();
+#endif
+		if (apu_cancelled()) { return 1; }
+	}
+	return 0;
+}
 
-	fread(&spc_pcl, 1, 1, fptr);
-	fread(&spc_pch, 1, 1, fptr);
-	fread(&spc_a, 1, 1, fptr);
-	fread(&spc_x, 1, 1, fptr);
-	fread(&spc_y, 1, 1, fptr);
-	fread(&spc_sw, 1, 1, fptr);
-	fread(&spc_sp, 1, 1, fptr);
+/* Send 0x100-0xffff through the fast loader. It lives in the zero page,
+ * which is why that one is sent last in this mode. Returns -1 on error,
+ * 1 when interrupted. */
+static int sendFast(unsigned char *spcdata)
+{
+	int i;
 
-	if (g_debug) {
-		printf("PC: %02x%02x\n", spc_pch, spc_pcl);
-		printf("A: %02X\n", spc_a);
-		printf("X: %02X\n", spc_x);
-		printf("Y: %02X\n", spc_y);
-		printf("SW: %02X\n", spc_sw);
-		printf("SP: %02X\n", spc_sp);
+	apu_setPhase(APU_PHASE_LOADER);
+	if (apu_initTransfer(0x0002)<0) {
+		fprintf(stderr, "timeout 4\n"); return -1; 
 	}
+	if (apu_writeBytes(fastloader, sizeof(fastloader))) {
+		fprintf(stderr, "Timeout sending fastloader\n");
+		return -1;
+	}
+	apu_endTransfer(0x0002);
 
+	apu_setPhase(APU_PHASE_RAM);
 
-	
-	fseek(fptr, 0x100, SEEK_SET);
-	fread(spcdata, 65536, 1, fptr);
+	for (i=FASTLOADER_START; i<0x10000; i+=FAST_CHUNK)
+	{
+		if (apu_writeFast(&spcdata[i], FAST_CHUNK, i+FAST_CHUNK == 0x10000)) {
+			fprintf(stderr, "Transfer error\n");
+			return -1;
+		}
+#ifdef PROGRESS_SPINNER
+		if (g_progress) {
+			pspin_update();
+		}
+#endif
+		if (apu_cancelled()) { return 1; }
+	}
+	return 0;
+}
 
-	fseek(fptr, 0x10100, SEEK_SET);
-	fread(dspdata, 128, 1, fptr);
-	
-	fseek(fptr, 0x101c0, SEEK_SET);
-	fread(spcram, 64, 1, fptr);
-
-	/* save a bunch of registers to be restored
-	 * later by the "bootcode" */
-	bootcode[BOOT_SPC_PORT0] = spcdata[SPC_PORT0];
-	bootcode[BOOT_SPC_PORT1] = spcdata[SPC_PORT1];
-	bootcode[BOOT_SPC_PORT2] = spcdata[SPC_PORT2];
-	bootcode[BOOT_SPC_PORT3] = spcdata[SPC_PORT3];
-	bootcode[0x01] = spcdata[0x00];
-	bootcode[0x04] = spcdata[0x01];
-	bootcode[BOOT_SPC_TIMER2] = spcdata[SPC_TIMER2];
-	bootcode[BOOT_SPC_TIMER1] = spcdata[SPC_TIMER1];
-	bootcode[BOOT_SPC_TIMER0] = spcdata[SPC_TIMER0];
-	bootcode[BOOT_SPC_CONTROL] = spcdata[SPC_CONTROL];
-	bootcode[BOOT_DSP_FLG] = dspdata[DSP_FLG];
-	bootcode[BOOT_DSP_KON] = dspdata[DSP_KON];
-	bootcode[BOOT_SPC_REGADD] = spcdata[SPC_REGADD];
-	bootcode[BOOT_A] = spc_a;
-	bootcode[BOOT_Y] = spc_y;
-	bootcode[BOOT_X] = spc_x;
-	
-	/* push program counter and status ward on stack */
-	spcdata[0x100 + spc_sp - 0] = spc_pch;
-	spcdata[0x100 + spc_sp - 1] = spc_pcl;
-	spcdata[0x100 + spc_sp - 2] = spc_sw;
-	bootcode[BOOT_SP] = spc_sp - 3; // save new stack pointer
-
-	/* mute all voices */
-	dspdata[DSP_FLG] = DSP_FLG_MUTE|DSP_FLG_ECEN;
-	dspdata[DSP_KON] = 0x00; // Voice 0-7 off 
-
-	/* to produce an echo effect, the dsp uses a memory region.
-	 * ESA: Esa * 100h becomes the lead-off address of the echo
-	 * region. Calculate this address... */
-	echoregion = dspdata[DSP_ESA] * 256;
-
-	/* echo delay. The bigger the delay is, more memory is needed.
-	 * calculate how much memory used... */
-	echosize = dspdata[DSP_EDL] * 2048;
-	if (echosize==0) { echosize = 4; }
-
-	/* we need to find a place to install our boot code, 
-	 * which is 77 byte big.
-	 * 	
-	 * we attempt to find 77 consecutive and identical bytes anywhere
-	 * in the memory, minus the bootrom area, minus the
-	 * page 0 (registers) and page 1 (stack), minus the
-	 * echo region. */
-	count = 0;
-	for (j=255; j>=0; j--)
+/* Page 1 is the lz loader's stack, it goes through the IPL after the
+ * zero page. Returns -1 on error. */
+static int sendStackPage(unsigned char *spcdata)
+{
+	int i;
+
+	apu_setPhase(APU_PHASE_RAM);
+	if (apu_newTransfer(0x0100)<0) {
+		return -1;
+	}
+	for (i=0x100; i<0x200; i+=16)
 	{
-		for (bootptr = 65471; bootptr >= 0x100; bootptr--)
+		if (apu_writeBytes(&spcdata[i], 16)) {
+			fprintf(stderr, "Transfer error\n");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Send 0x200-0xffff compressed, expanded by the lz loader. When the sum
+ * it reports does not match, the upload is redone with the fast loader.
+ * Returns -1 on error, 1 when interrupted. */
+static int sendPacked(unsigned char *spcdata)
+{
+	unsigned char *packed;
+	unsigned short sum, expected;
+	int i, len, chunk, res = 0;
+
+	packed = malloc(SPCPACK_BOUND(LZLOADER_LENGTH) + FASTLOADER_STRIDE);
+	if (packed == NULL) {
+		perror("malloc");
+		return -1;
+	}
+	len = spcpack_compress(&spcdata[LZLOADER_START], LZLOADER_LENGTH, packed,
+				LZLOADER_SUM_END - LZLOADER_START);
+	if (len < 0) {
+		fprintf(stderr, "Out of memory compressing the spc ram\n");
+		free(packed);
+		return -1;
+	}
+	/* the loader stops reading at the end, padding is never used */
+	while (len % FASTLOADER_STRIDE) {
+		packed[len++] = 0;
+	}
+	if (g_verbose)
+		printf("Compressed %d bytes to %d\n", LZLOADER_LENGTH, len);
+
+	apu_setPhase(APU_PHASE_LOADER);
+	if (apu_initTransfer(0x0002)<0) {
+		fprintf(stderr, "timeout 4\n"); free(packed); return -1;
+	}
+	if (apu_writeBytes(lzloader, sizeof(lzloader))) {
+		fprintf(stderr, "Timeout sending lzloader\n");
+		free(packed);
+		return -1;
+	}
+	apu_endTransfer(0x0002);
+
+	apu_setPhase(APU_PHASE_RAM);
+
+	for (i=0; i<len; i+=FAST_CHUNK)
+	{
+		chunk = len-i < FAST_CHUNK ? len-i : FAST_CHUNK;
+		if (apu_writeFast(&packed[i], chunk, 0)) {
+			fprintf(stderr, "Transfer error\n");
+			free(packed);
+			return -1;
+		}
+#ifdef PROGRESS_SPINNER
+		if (g_progress) {
+			pspin_update();
+		}
+#endif
+		if (apu_cancelled()) { free(packed); return 1; }
+	}
+	free(packed);
+
+	/* the loader is back in the rom once it has summed everything */
+	if (!apu_waitInport(0, 0xaa, LZLOADER_TIMEOUT)) {
+		fprintf(stderr, "Timeout waiting for lzloader\n");
+		return -1;
+	}
+	sum = apu_read(2) | (apu_read(3) << 8);
+	expected = spcpack_sum(&spcdata[LZLOADER_START], LZLOADER_SUM_END - LZLOADER_START);
+	if (sum != expected) {
+		fprintf(stderr, "Verify failed (sum %04X, expected %04X), "
+				"sending it again uncompressed\n", sum, expected);
+		apu_addRetries(1);
+		res = sendFast(spcdata);
+	}
+	return res;
+}
+
+/* Send 0x100-0xffff through the stream loader, which is sent and
+ * started like the fast loader. Returns -1 on error, 1 when
+ * interrupted. */
+static int sendStream(unsigned char *spcdata)
+{
+	int i, res, tries;
+
+	apu_setPhase(APU_PHASE_LOADER);
+	if (apu_initTransfer(0x0002)<0) {
+		fprintf(stderr, "timeout 4\n"); return -1; 
+	}
+	if (apu_writeBytes(streamloader, sizeof(streamloader))) {
+		fprintf(stderr, "Timeout sending streamloader\n");
+		return -1;
+	}
+	apu_endTransfer(0x0002);
+
+	if (apu_beginStream(STREAMLOADER_CAL_CYCLES, STREAMLOADER_TRIPLE_CYCLES)) {
+		fprintf(stderr, "Timeout calibrating streamloader\n");
+		return -1;
+	}
+
+	apu_setPhase(APU_PHASE_RAM);
+
+	for (i=STREAMLOADER_START; i<0x10000; i+=STREAMLOADER_BLOCK)
+	{
+		for (tries=0; ; tries++)
 		{
-			if (	(bootptr > echoregion + echosize) ||
-					(bootptr < echoregion) )
-			{
-				if (spcdata[bootptr] == j)
-				{
-					count++;
-				}
-				else
-				{
-					count = 0;
-				}
-				if (count == 77) { break; }
+			res = apu_writeStream(i, &spcdata[i], STREAMLOADER_BLOCK);
+			if (res == 0) {
+				break;
 			}
-			else
-			{
-				count = 0;
+			if (res < 0 || tries == STREAMLOADER_RETRIES) {
+				fprintf(stderr, "Transfer error at %04X\n", i);
+				return -1;
 			}
+			if (g_verbose)
+				printf("Block at %04X damaged, sending it again\n", i);
+			apu_addRetries(1);
 		}
-		if (count == 77) { break; }
+#ifdef PROGRESS_SPINNER
+		if (g_progress && i % 0x400 == 0) {
+			pspin_update();
+		}
+#endif
+		if (apu_cancelled()) { return 1; }
+	}
+
+	if (apu_endStream()) {
+		fprintf(stderr, "Timeout leaving streamloader\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* the verifier's sum: the carry out of each add goes to the high byte
+ * and into the next add as well */
+static unsigned short pageSum(const unsigned char *data, int len)
+{
+	unsigned int lo = 0, hi = 0, c = 0;
+	int i;
+
+	for (i=0; i<len; i++) {
+		lo = data[i] + lo + c;
+		c = lo >> 8;
+		lo &= 0xff;
+		hi += c;
+	}
+	return lo | ((hi & 0xff) << 8);
+}
+
+/* Check 'count' pages (0x01-0xff) against spcdata with the verifier
+ * and send the damaged ones again through the IPL, until they match.
+ * Called during a transfer, leaves the apu in the rom, with the
+ * verifier in the zero page. Returns -1 on error or when pages stay
+ * damaged. */
+static int verifyPages(unsigned char *spcdata, const unsigned char *list, int count)
+{
+	unsigned char pages[255], bad[255];
+	unsigned short sum;
+	int i, len, nbad, pass, res;
+
+	if (!count) {
+		apu_endTransfer(0xffc9);
+		return 0;
+	}
+	memcpy(pages, list, count);
+
+	apu_setPhase(APU_PHASE_VERIFY);
+	if (apu_newTransfer(0x0002)<0) {
+		return -1;
+	}
+	if (apu_writeBytes(verifyloader, sizeof(verifyloader))) {
+		fprintf(stderr, "Timeout sending verifyloader\n");
+		return -1;
 	}
 
-	/* we did not find an area of 77 consecutive identical byte values. */
-	if (bootptr == 0xff)
+	for (pass=0; ; pass++)
 	{
-		/* We will have to use the echo region. The region will need to be
-		 * at least 77 bytes... */
-		if (echosize < 77) {
-			fprintf(stderr, "This spc file does not have sufficient ram to be loaded");
+		apu_endTransfer(0x0002);
+
+		nbad = 0;
+		for (i=0; i<count; i++)
+		{
+			/* the rom hides ffc0-ffff */
+			len = pages[i] == 0xff ? 0xc0 : 0x100;
+			if (apu_pageSum(pages[i], (len/2) & 0xff, &sum)) {
+				fprintf(stderr, "Timeout verifying page %02X\n", pages[i]);
+				return -1;
+			}
+			if (sum != pageSum(&spcdata[pages[i] << 8], len)) {
+				bad[nbad++] = pages[i];
+			}
+		}
+		if (apu_endPageSums()) {
+			fprintf(stderr, "Timeout leaving verifyloader\n");
+			return -1;
+		}
+		if (!nbad) {
+			return 0;
+		}
+		if (pass == VERIFYLOADER_PASSES) {
+			fprintf(stderr, "%d pages still damaged after %d passes\n", nbad, pass);
 			return -1;
 		}
-		else {
-			/* we will use the echo region */
-			bootptr = echoregion;
+		if (g_verbose)
+			printf("Sending %d damaged pages again\n", nbad);
+		apu_addRetries(nbad);
+
+		for (i=0; i<nbad; i++)
+		{
+			res = i ? apu_newTransfer(bad[i] << 8) : apu_initTransfer(bad[i] << 8);
+			if (res < 0 || apu_writeBytes(&spcdata[bad[i] << 8], 256)) {
+				fprintf(stderr, "Transfer error\n");
+				return -1;
+			}
 		}
+		memcpy(pages, bad, nbad);
+		count = nbad;
 	}
+}
 
-	if (g_debug) { printf("Count: %d\n", count); }
+/* Send the pages that differ from the shadow through the IPL, then let
+ * the verifier check the others, since the last song may have written
+ * to them. A reset only clears the zero page, the rest of the ram is
+ * mostly what the shadow holds. Returns -1 on error, 1 when
+ * interrupted. */
+static int sendDelta(unsigned char *spcdata, const unsigned char *shadow)
+{
+	unsigned char same[255];
+	int i, page, nsame = 0, nsent = 0;
 
-	/* Copy our bootcode into the area we found */
-	for (i=bootptr; i<=bootptr+count-1; i++) {
-		spcdata[i] = bootcode[i - bootptr];
+	apu_setPhase(APU_PHASE_RAM);
+	for (page=1; page<=0xff; page++)
+	{
+		/* the rom hides the end of page ff from the verifier */
+		if (page != 0xff && !memcmp(&shadow[page << 8], &spcdata[page << 8], 256)) {
+			same[nsame++] = page;
+			continue;
+		}
+		i = nsent++ ? apu_newTransfer(page << 8) : apu_initTransfer(page << 8);
+		if (i < 0 || apu_writeBytes(&spcdata[page << 8], 256)) {
+			fprintf(stderr, "Transfer error\n");
+			return -1;
+		}
+#ifdef PROGRESS_SPINNER
+		if (g_progress) {
+			pspin_update();
+		}
+#endif
+		if (apu_cancelled()) { return 1; }
 	}
-	
-	apu_reset();
+	if (g_verbose)
+		printf("Delta: %d pages changed, checking %d\n", nsent, nsame);
+
+	return verifyPages(spcdata, same, nsame);
+}
+
+/* Restore the dsp registers through the dsploader, for when the
+ * bootcode has no room for them. Returns -1 on error, 1 when
+ * interrupted. */
+static int sendDsp(unsigned char *dspdata)
+{
+	int i;
+
+	apu_setPhase(APU_PHASE_LOADER);
 	apu_initTransfer(0x0002);
 
 	if (g_verbose) 
 		printf("Restoring dsp...\n");
-
-	if (g_exit_now || !g_playing) { apu_reset(); return 0; }
 	
 	/* first, we send a small program called the dsploader which we will
 	 * use to restore the DSP registers (with our modified KON and FLG to
@@ -197,16 +407,17 @@ int LoadAPU(FILE *fptr)
 		return -1;
 	}
 
-	if (g_exit_now || !g_playing) { apu_reset(); return 0; }
+	if (apu_cancelled()) { return 1; }
 	
 	apu_endTransfer(0x0002);
+	apu_setPhase(APU_PHASE_DSP);
 	
 	/* restore the 128 dsp registers one by one with the help of the dsp loader.
 	 * (with our modified KON and FLG)
 	 */
 	for (i=0; i<128; i++)
 	{
-		if (g_exit_now || !g_playing) { apu_reset(); return 0; }
+		if (apu_cancelled()) { return 1; }
 #ifdef PROGRESS_SPINNER
 		if (g_progress) {
 			pspin_update();
@@ -225,144 +436,181 @@ int LoadAPU(FILE *fptr)
 			}
 		}
 	}
+	apu_addBytes(128);
+	return 0;
+}
 
-	if (apu_initTransfer(0x0002)<0) {
-		fprintf(stderr, "timeout 4\n"); return -1; 
+int LoadAPU(FILE *fptr)
+{
+	spcimage *img;
+	int res;
+
+	img = malloc(sizeof(spcimage));
+	if (img == NULL) {
+		perror("malloc");
+		return -1;
 	}
+	res = spcimage_read(img, fptr);
+	if (res == 0) {
+		res = LoadAPU_image(img);
+	}
+	free(img);
+	return res;
+}
 
-	if (g_verbose) 
-		printf("Restoring spc memory...\n");
+int LoadAPU_buffer(const unsigned char *spc, size_t len)
+{
+	spcimage *img;
+	int res;
 
-	/* send the first part of the memory (0x02 to 0xef)
-	 * After 0xef comes spc700 registers (0xf0 to 0xff). Those
-	 * are taken care of by the bootcode */
-	for (i=2; i<=0xef; i++)
+	img = malloc(sizeof(spcimage));
+	if (img == NULL) {
+		perror("malloc");
+		return -1;
+	}
+	res = spcimage_prepare(img, spc, len);
+	if (res == 0) {
+		res = LoadAPU_image(img);
+	}
+	free(img);
+	return res;
+}
+
+int LoadAPU_image(spcimage *img)
+{
+	int res;
+
+	res = LoadAPU_stage(img);
+	if (res == 0) {
+		LoadAPU_start(img);
+	}
+	return res < 0 ? -1 : 0;
+}
+
+int LoadAPU_stage(spcimage *img)
+{
+	int i;
+	unsigned char *spcdata = img->ram;
+	unsigned char pages[255];
+	int res, dspboot = img->dspboot, mode;
+	apu_shadow *shadow = apu_getShadow();
+
+	/* without a shadow, the whole ram goes through the fast loader */
+	apu_setPhase(APU_PHASE_OTHER);
+
+	mode = g_upload_mode;
+	if (mode == UPLOAD_DELTA && !shadow->valid) {
+		mode = UPLOAD_FAST;
+	}
+	shadow->valid = 0;
+
+	res = apu_resetIPL();
+	if (res < 0) {
+		fprintf(stderr, "The apu does not answer after a reset\n");
+		return -1;
+	}
+	/* the dsp was not reset and may still write echo data into the
+	 * ram being uploaded. The dsploader stops that first. */
+	if (res > 0) {
+		dspboot = 0;
+	}
+
+	if (apu_cancelled()) { apu_reset(); return 1; }
+
+	/* the dsp registers go with the spc memory when the bootcode
+	 * restores them, otherwise they are sent first */
+	if (!dspboot)
 	{
-		apu_write(1, spcdata[i]);
-		apu_write(0, i-2);
-		if (!apu_waitInport(0, i-2, 500)) {
-			fprintf(stderr, "timeout 5\n"); return -1; 
-		}
-#ifdef PROGRESS_SPINNER
-		if (g_progress) 
-			pspin_update();
-#endif
-		if (g_exit_now || !g_playing) { apu_reset(); return 0; }
+		res = sendDsp(img->dsp);
+		if (res < 0) { return -1; }
+		if (res) { apu_reset(); return 1; }
 	}
 
-	apu_newTransfer(0x0100);
+	if (g_verbose) 
+		printf("Restoring spc memory...\n");
 
-	/* upload the external memory region data (0x100 (page 1) to 0xffc0 (rom) */	
-	for (i=0x100; i <= 65471; i+= 16)
+	if (mode == UPLOAD_IPL)
 	{
-		// echoclear = 0 : Clear echo region with 0's if enable in DSP_FLG
-		// echoclear = 1 : Clear echo region with 0's, regardless of DSP_FLG
-		// echoclear = 2 : Dont touch echo region
-#ifndef NO_ECHOCLEAR_STUFF
-		if (
-			(i >= echoregion) && 
-			(i<=(echoregion + echosize)) &&
-			(bootptr != echoregion)
-			)
+		res = sendZeroPage(spcdata);
+		if (res < 0) { return -1; }
+		if (res) { apu_reset(); return 1; }
+
+		apu_setPhase(APU_PHASE_RAM);
+		apu_newTransfer(0x0100);
+
+		/* upload the external memory region data (0x100 (page 1) to
+		 * 0xffff, the end being the ram under the rom) */
+		for (i=0x100; i < 0x10000; i+= 16)
 		{
-			for (j=0; j<16; j++)
+			if (apu_writeBytes(&spcdata[i], 16))
 			{
-				if ( ((bootcode[BOOT_DSP_FLG] & DSP_FLG_ECEN) == 0) && 
-					(echoclear == 0)) {
-					spcdata[i+j]=0;
-				} else if (echoclear == 1) {
-					spcdata[i+j]=0;
-				}
+				fprintf(stderr, "Transfer error\n");
+				return -1;
 			}
-		}
-#endif
-
-		if (apu_writeBytes(&spcdata[i], 16))
-		{
-			fprintf(stderr, "Transfer error\n");
-			return -1;
-		}
-
-		if (i % 256 == 0) {
-			readcount += 256;
 #ifdef PROGRESS_SPINNER
-			if (g_progress) {
+			if (g_progress && i % 256 == 0) {
 				pspin_update();
 			}
 #endif
+			if (apu_cancelled()) { apu_reset(); return 1; }
 		}
-		if (g_exit_now || !g_playing) { apu_reset(); return 0; }
-	}
-
-	/* upload the external memory area overlapping with the rom... I guess
-	 * if we write to those address from the SPC it really writes to this
-	 * memory area, but if you read you'll probably get the ROM code. Maybe
-	 * it's really Read/Write from the DSP point of view... TODO: Check this 
-	 *
-	 * Maybe also setting SPC_CONTROL msb bit enables this region? It's not
-	 * documented my manual...
-	 * */
-	for (i=65472; i<= 65535; i++)
+	}
+	else
 	{
-		if (spcdata[SPC_CONTROL] & 0x80) {
-			#ifndef NO_ECHOCLEAR_STUFF
-			if (echosize + echoregion > 65472)
-			{
-				// echoclear = 0 : Clear echo region with 0's if enable in DSP_FLG
-				// echoclear = 1 : Clear echo region with 0's, regardless of DSP_FLG
-				// echoclear = 2 : Dont touch echo region
-				if ( ((bootcode[BOOT_DSP_FLG] & DSP_FLG_ECEN)==0) &&
-					echoclear == 0)
-				{
-					spcram[i-65472] = 0;					
-				} else if (echoclear == 1) {
-					spcram[i-65472] = 0;
-				}
-			}
-			#endif
-				
-			if (apu_writeHandshake(1, spcram[i-65472])==1) {
-				fprintf(stderr, "some error\n");
-				return -1;
-			}
+		if (mode == UPLOAD_LZ) {
+			res = sendPacked(spcdata);
+		} else if (mode == UPLOAD_STREAM) {
+			res = sendStream(spcdata);
+		} else if (mode == UPLOAD_DELTA) {
+			res = sendDelta(spcdata, shadow->ram);
+		} else {
+			res = sendFast(spcdata);
 		}
-		else {
-			#ifndef NO_ECHOCLEAR_STUFF
-			if (echosize + echoregion > 65472) {
-				// echoclear = 0 : Clear echo region with 0's if enable in DSP_FLG
-				// echoclear = 1 : Clear echo region with 0's, regardless of DSP_FLG
-				// echoclear = 2 : Dont touch echo region
-				if ( ((bootcode[BOOT_DSP_FLG] & DSP_FLG_ECEN)==0) &&
-						echoclear ==0) {
-					spcdata[i]=0;
-				} else if (echoclear == 1) {
-					spcdata[i]=0;
-				}
-			}
-			#endif
-
-			if (apu_writeHandshake(1, spcram[i-65472])==1) {
-				fprintf(stderr, "some error AGAIN\n");
-				return -1;
-			}
-			
+		if (res == 0) {
+			res = sendZeroPage(spcdata);
 		}
-		if (i % 256 == 0) {
-			readcount += 256;
-#ifdef PROGRESS_SPINNER
-			if (g_progress) {
-				pspin_update();
-			}
-#endif
+		if (res == 0 && mode == UPLOAD_LZ) {
+			res = sendStackPage(spcdata);
 		}
-		if (g_exit_now || !g_playing) { apu_reset(); return 0; }
+		if (res < 0) { return -1; }
+		if (res) { apu_reset(); return 1; }
 	}
 
+	/* the verifier runs in the zero page, which is sent once more */
+	if (g_verify)
+	{
+		for (i=0; i<255; i++) {
+			pages[i] = i+1;
+		}
+		if (verifyPages(spcdata, pages, 255) < 0) { return -1; }
+		res = sendZeroPage(spcdata);
+		if (res < 0) { return -1; }
+		if (res) { apu_reset(); return 1; }
+	}
+
+	return 0;
+}
+
+void LoadAPU_start(spcimage *img)
+{
+	unsigned char *spcdata = img->ram;
+	apu_shadow *shadow = apu_getShadow();
+
+	apu_setPhase(APU_PHASE_OTHER);
+
 	/* Tell the APU where it should jump to start the program
 	 * will just uploaded. It will enter our bootcode, and jump
 	 * back to the original PC from the .spc with registers in
 	 * the same state as in the .spc */
-	apu_endTransfer(bootptr);
+	apu_endTransfer(img->bootptr);
+
+	if (shadow->ram == NULL) {
+		shadow->ram = malloc(65536);
+	}
+	if (shadow->ram) {
+		memcpy(shadow->ram, spcdata, 65536);
+		shadow->valid = 1;
+	}
 
 /*	if (!apu_waitInport(0, 0x53, 500)) {
 		fprintf(stderr, "timeout 7\n");
@@ -379,13 +627,101 @@ int LoadAPU(FILE *fptr)
 	apu_write(3, spcdata[SPC_PORT3]);
 
 	if (g_debug) {
-		printf("Boot ptr: %04X\n", bootptr);
-		printf("Echo pointer: %04X\n", echoregion);
-		printf("Echo size: %04X\n", echosize);
+		printf("Boot ptr: %04X\n", img->bootptr);
+		printf("Echo pointer: %04X\n", img->echoregion);
+		printf("Echo size: %04X\n", img->echosize);
 	}
 	
-	if (g_exit_now || !g_playing) { apu_reset(); return 0; }
-	return 0;
+	if (apu_cancelled()) { apu_reset(); }
 }
 
+int SaveAPU(FILE *out, FILE *src)
+{
+	unsigned char header[OFFSET_SPCDATA];
+	unsigned char spcdata[65536];
+	unsigned char dspdata[128];
+	unsigned char srcdsp[128];
+	unsigned char unused[64];
+	unsigned char buf[1024];
+	int i, res;
+	size_t len;
+
+	memset(spcdata, 0, sizeof(spcdata));
+
+	/* without the registers and the zero page of the song that was
+	 * loaded, the file could not be started again */
+	if (	fseek(src, 0, SEEK_SET) != 0 ||
+		fread(header, sizeof(header), 1, src) != 1 ||
+		fread(spcdata, 0x100, 1, src) != 1 ||
+		fseek(src, OFFSET_DSPDATA, SEEK_SET) != 0 ||
+		fread(srcdsp, sizeof(srcdsp), 1, src) != 1 ||
+		fread(unused, sizeof(unused), 1, src) != 1)
+	{
+		fprintf(stderr, "The source file is too short\n");
+		return -1;
+	}
+	if (!spcfile_check(header, sizeof(header))) {
+		fprintf(stderr, "The source file is not a .spc file\n");
+		return -1;
+	}
+
+	res = apu_resetIPL();
+	if (res < 0) {
+		fprintf(stderr, "The apu does not answer after a reset\n");
+		return -1;
+	}
+
+	if (apu_initTransfer(0x0002)<0) {
+		fprintf(stderr, "timeout 4\n"); return -1;
+	}
+	if (apu_writeBytes(readloader, sizeof(readloader))) {
+		fprintf(stderr, "Timeout sending readloader\n");
+		return -1;
+	}
+	apu_endTransfer(0x0002);
+
+	if (apu_readBytes(dspdata, 128)) {
+		fprintf(stderr, "Timeout reading the dsp registers\n");
+		return -1;
+	}
+	/* the reset left FLG at $E0 (soft reset, mute, echo off), and the
+	 * voices were keyed on by the song, not by what KON holds now */
+	dspdata[DSP_FLG] = srcdsp[DSP_FLG];
+	dspdata[DSP_KON] = srcdsp[DSP_KON];
+	for (i=READLOADER_START; i<0x10000; i+=FAST_CHUNK)
+	{
+		if (apu_readFast(&spcdata[i], FAST_CHUNK, i+FAST_CHUNK == 0x10000)) {
+			fprintf(stderr, "Transfer error\n");
+			return -1;
+		}
+#ifdef PROGRESS_SPINNER
+		if (g_progress) {
+			pspin_update();
+		}
+#endif
+		if (g_exit_now) { apu_reset(); return 1; }
+	}
+
+	/* the ram under the rom goes to both places LoadAPU could take
+	 * it from */
+	if (	fwrite(header, sizeof(header), 1, out) != 1 ||
+		fwrite(spcdata, sizeof(spcdata), 1, out) != 1 ||
+		fwrite(dspdata, sizeof(dspdata), 1, out) != 1 ||
+		fwrite(unused, sizeof(unused), 1, out) != 1 ||
+		fwrite(&spcdata[65472], 64, 1, out) != 1)
+	{
+		perror("fwrite");
+		return -1;
+	}
+
+	/* extended ID666 and anything else after the ram */
+	fseek(src, OFFSET_SPCRAM + 64, SEEK_SET);
+	while ((len = fread(buf, 1, sizeof(buf), src)) > 0) {
+		if (fwrite(buf, 1, len, out) != len) {
+			perror("fwrite");
+			return -1;
+		}
+	}
+	return 0;
+}
 
@@ -19,9 +19,43 @@
 #define _apu_play_h__
 
 
+#include "spcimage.h"
+
 int LoadAPU(FILE *fptr);
+
+/* the same for a .spc file in memory, see spcfile.h */
+int LoadAPU_buffer(const unsigned char *spc, size_t len);
+
+/* Send an image built by spcimage_prepare() and start it */
+int LoadAPU_image(spcimage *img);
+
+/* The same in two steps. LoadAPU_stage leaves the apu in the IPL rom
+ * with everything sent and the dsp muted, LoadAPU_start then only
+ * jumps to the bootcode. Used to preload an idle apu.
+ *
+ * LoadAPU_stage returns -1 on error, 1 when interrupted (the apu is
+ * reset), 0 otherwise */
+int LoadAPU_stage(spcimage *img);
+void LoadAPU_start(spcimage *img);
 int LoadAPU_embedded(FILE *fptr);
 
+/* Reset the apu and read its ram and dsp registers back into a .spc
+ * file. The reset stops the song: the cpu registers and the PC are
+ * lost, the rom clears the zero page and the dsp sets FLG to $E0.
+ * These come from 'src', the .spc that was loaded, along with the
+ * header, FLG, KON and the ID666 tag. The file thus mixes the ram and
+ * dsp of the moment of the reset with the start state of 'src'.
+ * Returns -1 on error or when 'src' is not a .spc file, 1 when
+ * interrupted. */
+int SaveAPU(FILE *out, FILE *src);
+
+/* g_upload_mode: how LoadAPU sends the spc ram */
+#define UPLOAD_IPL	0	/* everything through the IPL rom, 1 byte per handshake */
+#define UPLOAD_FAST	1	/* fastloader.h, 3 bytes per handshake */
+#define UPLOAD_LZ	2	/* spcpack.h stream expanded by lzloader.h */
+#define UPLOAD_STREAM	3	/* streamloader.h, paced writes and checkpoints */
+#define UPLOAD_DELTA	4	/* the pages changed since the last LoadAPU, fast the first time */
+
 /* offset in a .spc file */ 
 #define OFFSET_SPCDATA	0x100
 #define OFFSET_DSPDATA	0x10100
@@ -20,6 +20,7 @@
 #include "apu.h"
 #include "dsploader.h"
 #include "bootcode.h"
+#include "spcimage.h"
 #ifdef PROGRESS_SPINNER
 #include "pspin.h"
 #endif
@@ -30,9 +31,24 @@ extern int g_exit_now;
 extern int g_playing;
 extern int g_progress;
 
+/* The file is read through one window of this size. A prepass reads
+ * the dsp registers and the ram under the rom from the end of the
+ * file, then everything else is read strictly forward, the ram while
+ * it is sent. */
+#define WINDOW_SIZE	512
+
+static int readWindow(FILE *fptr, unsigned char *window, int len)
+{
+	if (fread(window, len, 1, fptr) != 1) {
+		fprintf(stderr, "Short spc file\n");
+		return -1;
+	}
+	return 0;
+}
+
 int LoadAPU_embedded(FILE *fptr)
 {
-	int i=0, j=0, count=0, val=0;
+	int i=0, j=0, len;
 	
 	unsigned char spc_pcl;
 	unsigned char spc_pch;
@@ -42,36 +58,33 @@ int LoadAPU_embedded(FILE *fptr)
 	unsigned char spc_sw;
 	unsigned char spc_sp;
 
-//	unsigned char spcdata[65536];
-//	unsigned char spcram[64];
-
 	unsigned char dsp_kon=0;
 	unsigned char dsp_flg=0;
 	unsigned char dsp_esa=0;
 	unsigned char dsp_edl=0;
 	
-	unsigned char workbuf[64];
-	
-	int echosize, echoregion, bootptr, readcount;
+	unsigned char window[WINDOW_SIZE];
+	unsigned char spcram[64];
+	spcarea area;
 	
-	fseek(fptr, 0x25, SEEK_SET);
+	int echosize, echoregion, bootptr;
 
-	fread(&spc_pcl, 1, 1, fptr);
-	fread(&spc_pch, 1, 1, fptr);
-	fread(&spc_a, 1, 1, fptr);
-	fread(&spc_x, 1, 1, fptr);
-	fread(&spc_y, 1, 1, fptr);
-	fread(&spc_sw, 1, 1, fptr);
-	fread(&spc_sp, 1, 1, fptr);
+	/* prepass: the dsp registers, the unused bytes and the ram under
+	 * the rom, OFFSET_DSPDATA to OFFSET_SPCRAM+64 */
+	fseek(fptr, OFFSET_DSPDATA, SEEK_SET);
+	if (readWindow(fptr, window, 256)) { return -1; }
 
-	if (g_debug) {
-		printf("PC: %02x%02x\n", spc_pch, spc_pcl);
-		printf("A: %02X\n", spc_a);
-		printf("X: %02X\n", spc_x);
-		printf("Y: %02X\n", spc_y);
-		printf("SW: %02X\n", spc_sw);
-		printf("SP: %02X\n", spc_sp);
+	for (i=0; i<64; i++) {
+		spcram[i] = window[OFFSET_SPCRAM - OFFSET_DSPDATA + i];
 	}
+	dsp_flg = window[DSP_FLG];
+	dsp_kon = window[DSP_KON];
+	dsp_esa = window[DSP_ESA];
+	dsp_edl = window[DSP_EDL];
+
+	/* mute all voices and stop all notes */
+	window[DSP_FLG] = DSP_FLG_MUTE|DSP_FLG_ECEN;
+	window[DSP_KON] = 0x00;
 
 	apu_reset();
 	apu_initTransfer(0x0002);
@@ -93,47 +106,25 @@ int LoadAPU_embedded(FILE *fptr)
 	if (g_exit_now || !g_playing) { apu_reset(); return 0; }
 
 	/* restore the 128 dsp registers one by one with the help of the dsp loader. */
-	fseek(fptr, OFFSET_DSPDATA, SEEK_SET);
-	for (i=0; i<128; i+=64)
+	for (i=0; i<128; i++)
 	{
-		fread(workbuf, 64, 1, fptr);
-		for (j=0; j<64; j++)
-		{
-			/* mute all voices and stop all notes */
-			if (i+j == DSP_FLG) {
-				dsp_flg = workbuf[j]; // save it for later
-				workbuf[j] = DSP_FLG_MUTE|DSP_FLG_ECEN;
-			}
-			if (i+j == DSP_KON) {
-				dsp_kon = workbuf[j]; // save it for later
-				workbuf[j] = 0x00;
-			}
-
-			// take note of some values while we upload...
-			if (i+j == DSP_ESA) { dsp_esa = workbuf[j]; }
-			if (i+j == DSP_EDL) { dsp_edl = workbuf[j]; }
-			
-			apu_write(1, workbuf[j]);
-			apu_write(0, i+j);
-			if (!apu_waitInport(0, i+j, 500)) {
-				if (apu_read(0)==0xaa) {
-//				fprintf(stderr, "ingored\n");
-				} else {
-					fprintf(stderr, "timeout 3\n"); return -1; 
-				}
+		apu_write(1, window[i]);
+		apu_write(0, i);
+		if (!apu_waitInport(0, i, 500)) {
+			if (apu_read(0)==0xaa) {
+//			fprintf(stderr, "ingored\n");
+			} else {
+				fprintf(stderr, "timeout 3\n"); return -1; 
 			}
+		}
 
-			if (g_exit_now || !g_playing) { apu_reset(); return 0; }
+		if (g_exit_now || !g_playing) { apu_reset(); return 0; }
 #ifdef PROGRESS_SPINNER
-			if (g_progress) {
-				pspin_update();
-			}
-#endif
+		if (g_progress) {
+			pspin_update();
 		}
-
+#endif
 	}
-//	if (g_verbose) 
-//		printf("\n");
 
 	/* after receiving 128 registers, the dsp loaded will jump
 	 * inside the rom at address $ffc9. Once 0xAA appears in 
@@ -142,8 +133,26 @@ int LoadAPU_embedded(FILE *fptr)
 		fprintf(stderr, "timeout 4\n"); return -1; 
 	}
 
-//	fseek(fptr, OFFSET_SPCRAM, SEEK_SET);
-//	fread(spcram, 64, 1, fptr);
+	/* from here on forward only: the header and the zero page */
+	fseek(fptr, 0, SEEK_SET);
+	if (readWindow(fptr, window, OFFSET_SPCDATA + 0x100)) { return -1; }
+
+	spc_pcl = window[0x25];
+	spc_pch = window[0x26];
+	spc_a = window[0x27];
+	spc_x = window[0x28];
+	spc_y = window[0x29];
+	spc_sw = window[0x2a];
+	spc_sp = window[0x2b];
+
+	if (g_debug) {
+		printf("PC: %02x%02x\n", spc_pch, spc_pcl);
+		printf("A: %02X\n", spc_a);
+		printf("X: %02X\n", spc_x);
+		printf("Y: %02X\n", spc_y);
+		printf("SW: %02X\n", spc_sw);
+		printf("SP: %02X\n", spc_sp);
+	}
 
 	/* save a bunch of registers to be restored
 	 * later by the "bootcode" */
@@ -155,31 +164,20 @@ int LoadAPU_embedded(FILE *fptr)
 	bootcode[BOOT_SP] = spc_sp - 3; // save new stack pointer
 
 	/* save address $0000 and $0001 to be restored by "bootcode" */
-	fseek(fptr, OFFSET_SPCDATA, SEEK_SET);
-	fread(workbuf, 2, 1, fptr);
-	bootcode[0x01] = workbuf[0];
-	bootcode[0x04] = workbuf[1];
+	bootcode[0x01] = window[OFFSET_SPCDATA];
+	bootcode[0x04] = window[OFFSET_SPCDATA + 1];
 	
 	/* save most spc registers (0xf0 to 0xff) into bootcode to be restored
 	 * later */
-	fseek(fptr, OFFSET_SPCDATA+0xf0, SEEK_SET);
-	fread(workbuf, 0x10, 1, fptr);
-	for (i=0xf0; i<=0xff; i++) {
-		switch (i)
-		{
-			case SPC_PORT0: bootcode[BOOT_SPC_PORT0] = workbuf[i-0xf0]; break;
-			case SPC_PORT1: bootcode[BOOT_SPC_PORT1] = workbuf[i-0xf0]; break;
-			case SPC_PORT2: bootcode[BOOT_SPC_PORT2] = workbuf[i-0xf0]; break;
-			case SPC_PORT3: bootcode[BOOT_SPC_PORT3] = workbuf[i-0xf0]; break;
-			case SPC_TIMER0: bootcode[BOOT_SPC_TIMER0] = workbuf[i-0xf0]; break;
-			case SPC_TIMER1: bootcode[BOOT_SPC_TIMER1] = workbuf[i-0xf0]; break;
-			case SPC_TIMER2: bootcode[BOOT_SPC_TIMER2] = workbuf[i-0xf0]; break;
-			case SPC_CONTROL: bootcode[BOOT_SPC_CONTROL] = workbuf[i-0xf0]; break;
-			case SPC_REGADD: bootcode[BOOT_SPC_REGADD] = workbuf[i-0xf0]; break;
-		}
-	}
-	
-
+	bootcode[BOOT_SPC_PORT0] = window[OFFSET_SPCDATA + SPC_PORT0];
+	bootcode[BOOT_SPC_PORT1] = window[OFFSET_SPCDATA + SPC_PORT1];
+	bootcode[BOOT_SPC_PORT2] = window[OFFSET_SPCDATA + SPC_PORT2];
+	bootcode[BOOT_SPC_PORT3] = window[OFFSET_SPCDATA + SPC_PORT3];
+	bootcode[BOOT_SPC_TIMER0] = window[OFFSET_SPCDATA + SPC_TIMER0];
+	bootcode[BOOT_SPC_TIMER1] = window[OFFSET_SPCDATA + SPC_TIMER1];
+	bootcode[BOOT_SPC_TIMER2] = window[OFFSET_SPCDATA + SPC_TIMER2];
+	bootcode[BOOT_SPC_CONTROL] = window[OFFSET_SPCDATA + SPC_CONTROL];
+	bootcode[BOOT_SPC_REGADD] = window[OFFSET_SPCDATA + SPC_REGADD];
 
 	/* to produce an echo effect, the dsp uses a memory region.
 	 * ESA: Esa * 100h becomes the lead-off address of the echo
@@ -206,95 +204,70 @@ int LoadAPU_embedded(FILE *fptr)
 	 * After 0xef comes spc700 registers (0xf0 to 0xff). Those
 	 * are taken care of by the bootcode. 0x00 and 0x01 are
 	 * retored by the bootcode too. */
-	fseek(fptr, OFFSET_SPCDATA, SEEK_SET);
-	for (j=0; j<256; j+=64)
-	{
-		fread(workbuf, 64, 1, fptr);
-		for (i=0; i<0x40; i++) {
-			if (j+i>=0xf0) { break; }
-			if (j==0 && i<2) { continue; } // skip $0000 and $0001
-			apu_write(1, workbuf[i]);
-			apu_write(0, j+i-2);
-			if (!apu_waitInport(0, j+i-2, 500)) {
-				fprintf(stderr, "timeout 5\n"); return -1; 
-			}
-#ifdef PROGRESS_SPINNER
-			if (g_progress) 
-				pspin_update();
-#endif
-			if (g_exit_now || !g_playing) { apu_reset(); return 0; }
-		}
-		if (j+i>=0xf0) { break; }
+	if (apu_writeBytes(&window[OFFSET_SPCDATA + 2], 0xef - 2 + 1)) {
+		fprintf(stderr, "timeout 5\n"); return -1; 
 	}
-
-//	if (g_verbose) 
-//		printf("\n");
+	if (g_exit_now || !g_playing) { apu_reset(); return 0; }
 
 	if (apu_newTransfer(0x100)) { apu_reset(); return -1; }
 	
 	if (g_debug) { 
-		printf("debug: Sending spc memory from 0x100 to 0xffc0\n");
+		printf("debug: Sending spc memory from 0x100 to 0xffff\n");
 	}
-	/* upload the external memory region data (0x100 (page 1) to 0xffbf (rom),
-	 * and look for an area with the same consecutive value repeated 77 times */	
-	fseek(fptr, OFFSET_SPCDATA+0x100, SEEK_SET);
-	bootptr = -1;
-	for (i=0x100; i <= 65471; i+= 16)
+	/* upload the external memory region data (0x100 (page 1) to 0xffff,
+	 * and look for an area with the same consecutive value repeated 77
+	 * times below the rom */
+	spcarea_init(&area, sizeof(bootcode));
+	for (i=0x100; i < 0x10000; i+= len)
 	{		
-		fread(workbuf, 16, 1, fptr);
+		len = 0x10000 - i < WINDOW_SIZE ? 0x10000 - i : WINDOW_SIZE;
+		if (readWindow(fptr, window, len)) { return -1; }
 		
-		for (j=0; j<16; j++) {
+		for (j=0; j<len; j++) {
 			/* push program counter and status ward on stack */
 			if ((i+j) == (0x100 +spc_sp - 0)) {
-				workbuf[j] = spc_pch;
+				window[j] = spc_pch;
 			}
 			if ((i+j) == (0x100 +spc_sp - 1)) {
-				workbuf[j] = spc_pcl;
+				window[j] = spc_pcl;
 			}
 			if ((i+j) == (0x100 +spc_sp - 2)) {
-				workbuf[j] = spc_sw;
+				window[j] = spc_sw;
 			}
-			
-			if ((i > echoregion + echosize) || (i < echoregion) )
-			{
-				if (val==workbuf[j]) {
-					count++;
-					if (count>=77) {
-						bootptr = i+j-77;
-//						printf("nbptr: %d\n", i+j-77);
-					}
-				}
-				else {
-					val = workbuf[j];
-					count = 0;
+
+			/* upload the external memory area overlapping with the
+			 * rom... I guess if we write to those address from the SPC
+			 * it really writes to this memory area, but if you read
+			 * you'll probably get the ROM code. Maybe also setting
+			 * SPC_CONTROL msb bit enables this region? */
+			if (i+j >= 65472) {
+				if (bootcode[BOOT_SPC_CONTROL] & 0x80) {
+					window[j] = spcram[i+j-65472];
 				}
+				continue;
 			}
-			else
-			{
-				count = 0;
-			}
+
+			spcarea_add(&area, i+j, window[j],
+				(i+j > echoregion + echosize) || (i+j < echoregion));
 		}
 		
-		if (apu_writeBytes(workbuf, 16))
+		if (apu_writeBytes(window, len))
 		{
 			fprintf(stderr, "Transfer error\n");
 			return -1;
 		}
 
-		if (i % 256 == 0) {
-			readcount += 256;
 #ifdef PROGRESS_SPINNER
-			if (g_progress) {
-				pspin_update();
-			}
-#endif
+		if (g_progress) {
+			pspin_update();
 		}
+#endif
 		if (g_exit_now || !g_playing) { apu_reset(); return 0; }
 	}
 	
-//	bootptr = 0x2e47;
+	bootptr = spcarea_pick(&area);
 	if (g_debug) { 	
-		printf("debug: area for bootcode: $%04x (%02X)\n", bootptr, val);
+		printf("debug: area for bootcode: $%04x\n", bootptr);
 	}
 	
 	/* we did not find an area of 77 consecutive identical byte values. */
@@ -312,33 +285,6 @@ int LoadAPU_embedded(FILE *fptr)
 		}
 	}
 
-	if (g_debug) { 
-		printf("debug: Sending spc memory from 0xffc0 to 0xffff\n");
-	}
-	/* upload the external memory area overlapping with the rom... I guess
-	 * if we write to those address from the SPC it really writes to this
-	 * memory area, but if you read you'll probably get the ROM code. Maybe
-	 * it's really Read/Write from the DSP point of view... TODO: Check this 
-	 *
-	 * Maybe also setting SPC_CONTROL msb bit enables this region? It's not
-	 * documented my manual...
-	 * */
-	if (bootcode[BOOT_SPC_CONTROL] & 0x80) {
-		fseek(fptr, OFFSET_SPCRAM, SEEK_SET);
-		fread(workbuf, 64, 1, fptr);
-	}
-	else {
-		fseek(fptr, OFFSET_SPCDATA + 65472, SEEK_SET);
-		fread(workbuf, 64, 1, fptr);
-	}
-	
-	if (apu_writeBytes(workbuf, 64)) {
-		return -1;
-	}
-
-//	if (g_verbose) 
-//		printf("\n");
-
 	if (apu_newTransfer(bootptr)) { apu_reset(); return -1; }
 
 	/* Copy our bootcode into the area we found */
@@ -0,0 +1,15 @@
+/* code placed right in front of the bootcode, with the 128 dsp
+ * registers right behind it (see DSPrestore.asm). Replaces the
+ * dsploader and its 128 handshakes when there is room for all of it. */
+static unsigned char dsprestore[12] = {
+	0xcd, 0x00,		// MOV X, #00
+	0xd8, 0xf2,		// loop: MOV f2, X
+	0xf5, 0x00, 0x00,	// MOV A, !image+X
+	0xc4, 0xf3,		// MOV f3, A
+	0x3d,			// INC X
+	0x10, 0xf6		// BPL loop ; falls into the bootcode
+};
+
+/* where the image address goes */
+#define DSPRESTORE_IMAGE_L	0x05
+#define DSPRESTORE_IMAGE_H	0x06
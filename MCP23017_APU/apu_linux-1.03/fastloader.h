@@ -0,0 +1,30 @@
+/* code loaded at 0x02. Receives 0x100-0xffff, 3 bytes per handshake,
+ * then goes back to the IPL rom (see FASTcode.asm). The last handshake
+ * is acknowledged by the rom's $AA instead of the counter. */
+static unsigned char fastloader[42] = {
+	0x8f, 0x00, 0x00,	// MOV 00, #00	; destination pointer
+	0x8f, 0x01, 0x01,	// MOV 01, #01	; starts at 0100
+	0x8d, 0x00,		// MOV Y, #00
+	0xcd, 0x00,		// MOV X, #00	; handshake counter
+	0x3e, 0xf4,		// wait: CMP X, f4
+	0xd0, 0xfc,		// BNE wait
+	0xe4, 0xf5,		// MOV A, f5
+	0xd7, 0x00,		// MOV [00]+Y, A
+	0x3a, 0x00,		// INCW 00
+	0xe4, 0xf6,		// MOV A, f6
+	0xd7, 0x00,		// MOV [00]+Y, A
+	0x3a, 0x00,		// INCW 00
+	0xe4, 0xf7,		// MOV A, f7
+	0xd7, 0x00,		// MOV [00]+Y, A
+	0x3a, 0x00,		// INCW 00	; Z once the pointer wraps
+	0xf0, 0x05,		// BEQ done
+	0xd8, 0xf4,		// MOV f4, X
+	0x3d,			// INC X
+	0x2f, 0xe3,		// BRA wait
+	0x5f, 0xc9, 0xff	// done: JMP ffc9 ; back into the rom
+};
+
+/* bytes per handshake, and how many the loader takes in total */
+#define FASTLOADER_STRIDE	3
+#define FASTLOADER_START	0x0100
+#define FASTLOADER_LENGTH	(0x10000 - FASTLOADER_START)
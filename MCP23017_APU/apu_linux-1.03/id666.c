@@ -16,47 +16,239 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include "id666.h"
 
-int read_id666(FILE *fptr, id666_tag *tag)
+#define XID6_OFFSET	0x10200
+
+/* xid6 sub-chunk ids */
+#define XID6_SONG	0x01
+#define XID6_GAME	0x02
+#define XID6_ARTIST	0x03
+#define XID6_DUMPER	0x04
+#define XID6_DATE	0x05
+#define XID6_EMULATOR	0x06
+#define XID6_COMMENTS	0x07
+#define XID6_OST	0x10
+#define XID6_OST_DISC	0x11
+#define XID6_OST_TRACK	0x12
+#define XID6_PUBLISHER	0x13
+#define XID6_COPYRIGHT	0x14
+#define XID6_INTRO	0x30
+#define XID6_LOOP	0x31
+#define XID6_END	0x32
+#define XID6_FADE	0x33
+#define XID6_LOOPS	0x35
+
+static void copyString(char *dst, const unsigned char *src, int len)
 {
-	long orig_pos = ftell(fptr);
-	unsigned char istag=0;
+	if (len > ID666_MAXSTR) { len = ID666_MAXSTR; }
+	memcpy(dst, src, len);
+	dst[len] = 0;
+}
+
+static unsigned int textNumber(const unsigned char *src, int len)
+{
+	unsigned int n = 0;
+	int i;
+
+	for (i=0; i<len && isdigit(src[i]); i++) {
+		n = n*10 + src[i]-'0';
+	}
+	return n;
+}
+
+static unsigned int binNumber(const unsigned char *src, int len)
+{
+	unsigned int n = 0;
+
+	while (len--) {
+		n = (n<<8) | src[len];
+	}
+	return n;
+}
+
+/* Both ID666 variants share the strings up to the comments. The text
+ * one then keeps the date, the length and the fade as digits and the
+ * artist at b1, the binary one integers and the artist at b0. The
+ * length fields decide: digits, spaces or zeros mean text, unless all
+ * of them are zero and b0 reads like the start of an artist name. */
+static int isBinary(const unsigned char *spc)
+{
+	int i, digits = 0;
+
+	for (i=0xa9; i<0xb1; i++) {
+		if (isdigit(spc[i])) { digits++; }
+		else if (spc[i] != 0 && spc[i] != ' ') { return 1; }
+	}
+	if (digits) { return 0; }
+
+	return spc[0xb0] > ' ' && spc[0xb0] < 0x7f;
+}
+
+static void formatDate(char *dst, unsigned int yyyymmdd)
+{
+	if (yyyymmdd == 0 || yyyymmdd > 99991231) {
+		dst[0] = 0;
+		return;
+	}
+	sprintf(dst, "%02u/%02u/%04u", (yyyymmdd/100)%100, yyyymmdd%100,
+			yyyymmdd/10000);
+}
+
+static void parseXid6(const unsigned char *chunk, size_t len, id666_tag *tag)
+{
+	size_t pos = 0, size;
+	unsigned int data;
+	char *str;
+	int id, type;
+
+	while (pos + 4 <= len)
+	{
+		id = chunk[pos];
+		type = chunk[pos+1];
+		data = chunk[pos+2] | (chunk[pos+3]<<8);
+		pos += 4;
+
+		/* type 0 keeps its value in the header, the others follow
+		 * it, padded to 4 bytes */
+		size = type ? data : 0;
+		if (pos + size > len) { break; }
+		if (type == 4 && size == 4) {
+			data = binNumber(&chunk[pos], 4);
+		}
+
+		str = NULL;
+		switch (id)
+		{
+			case XID6_SONG: str = tag->title; break;
+			case XID6_GAME: str = tag->game_title; break;
+			case XID6_ARTIST: str = tag->artist; break;
+			case XID6_DUMPER: str = tag->name_of_dumper; break;
+			case XID6_COMMENTS: str = tag->comments; break;
+			case XID6_OST: str = tag->ost_title; break;
+			case XID6_PUBLISHER: str = tag->publisher; break;
+			case XID6_DATE: formatDate(tag->date, data); break;
+			case XID6_EMULATOR: tag->emulator_used = data; break;
+			case XID6_OST_DISC: tag->ost_disc = data; break;
+			case XID6_OST_TRACK: tag->ost_track = data; break;
+			case XID6_COPYRIGHT: tag->copyright_year = data; break;
+			case XID6_INTRO: tag->intro_ticks = data; break;
+			case XID6_LOOP: tag->loop_ticks = data; break;
+			case XID6_END: tag->end_ticks = data; break;
+			case XID6_FADE: tag->fade_ticks = data; break;
+			case XID6_LOOPS: tag->loops = data; break;
+		}
+		if (str != NULL && type == 1 && size > 0) {
+			copyString(str, &chunk[pos], size);
+		}
+
+		pos += (size + 3) & ~3;
+	}
+	tag->has_xid6 = 1;
+}
+
+int parse_id666(const unsigned char *spc, size_t len, id666_tag *tag)
+{
+	size_t size;
 
-	fseek(fptr, 0x23, SEEK_SET);
-	fread(&istag, 1, 1, fptr);
-	if (istag != 26)
+	memset(tag, 0, sizeof(id666_tag));
+	strcpy(tag->seconds_til_fadeout, "150"); // 2.5 minutes
+
+	if (len < 0xd2 || spc[0x23] != 26)
 	{
-		printf("No tag\n");
-		strcpy(tag->title, "");
-		strcpy(tag->game_title, "");
-		strcpy(tag->name_of_dumper, "");
-		strcpy(tag->comments, "");
-		strcpy(tag->seconds_til_fadeout, "150"); // 2.5 minutes
 		return 0;
 	}
 	
-	fseek(fptr, 0x2e, SEEK_SET);
-	tag->title[32] = 0;
-	fread(&tag->title, 32, 1, fptr);
-	tag->game_title[32] = 0;
-	fread(&tag->game_title, 32, 1, fptr);
-	tag->name_of_dumper[16] = 0;
-	fread(&tag->name_of_dumper, 16, 1, fptr);
-	tag->comments[32] = 0;
-	fread(&tag->comments, 32, 1, fptr);
-
-	fseek(fptr, 0xa9, SEEK_SET);
-	tag->seconds_til_fadeout[3] = 0;
-	fread(&tag->seconds_til_fadeout, 3, 1, fptr);
-	
-	
-	fseek(fptr, orig_pos, SEEK_SET);
+	copyString(tag->title, &spc[0x2e], 32);
+	copyString(tag->game_title, &spc[0x4e], 32);
+	copyString(tag->name_of_dumper, &spc[0x6e], 16);
+	copyString(tag->comments, &spc[0x7e], 32);
+
+	tag->binary = isBinary(spc);
+	if (tag->binary)
+	{
+		formatDate(tag->date, binNumber(&spc[0x9e], 4));
+		tag->seconds = binNumber(&spc[0xa9], 3);
+		tag->fade_ms = binNumber(&spc[0xac], 4);
+		copyString(tag->artist, &spc[0xb0], 32);
+		tag->chn_dis = spc[0xd0];
+		tag->emulator_used = spc[0xd1];
+	}
+	else
+	{
+		copyString(tag->date, &spc[0x9e], 11);
+		tag->seconds = textNumber(&spc[0xa9], 3);
+		tag->fade_ms = textNumber(&spc[0xac], 5);
+		copyString(tag->artist, &spc[0xb1], 32);
+		tag->chn_dis = spc[0xd1];
+		if (len > 0xd2 && isdigit(spc[0xd2])) {
+			tag->emulator_used = spc[0xd2]-'0';
+		}
+	}
+	sprintf(tag->seconds_til_fadeout, "%u", tag->seconds);
+
+	if (len >= XID6_OFFSET + 8 && memcmp(&spc[XID6_OFFSET], "xid6", 4)==0)
+	{
+		size = binNumber(&spc[XID6_OFFSET+4], 4);
+		if (size > len - XID6_OFFSET - 8) {
+			size = len - XID6_OFFSET - 8;
+		}
+		parseXid6(&spc[XID6_OFFSET+8], size, tag);
+	}
 
 	return 1;
 }
 
+int read_id666(FILE *fptr, id666_tag *tag)
+{
+	long orig_pos = ftell(fptr);
+	unsigned char *spc;
+	size_t len;
+	int res;
+
+	fseek(fptr, 0, SEEK_END);
+	len = ftell(fptr);
+	spc = malloc(len ? len : 1);
+	if (spc == NULL) {
+		perror("malloc");
+		return parse_id666(NULL, 0, tag);
+	}
+
+	fseek(fptr, 0, SEEK_SET);
+	len = fread(spc, 1, len, fptr);
+	fseek(fptr, orig_pos, SEEK_SET);
+
+	res = parse_id666(spc, len, tag);
+	if (!res) { printf("No tag\n"); }
+	free(spc);
+
+	return res;
+}
 
+unsigned int id666_duration(const id666_tag *tag)
+{
+	unsigned long long play;
+	unsigned int fade, loops;
+
+	play = tag->seconds * 1000ULL;
+	fade = tag->fade_ms;
+
+	if (tag->intro_ticks || tag->loop_ticks)
+	{
+		loops = tag->loops ? tag->loops : 1;
+		play = ((unsigned long long)tag->loop_ticks*loops + tag->intro_ticks
+				+ tag->end_ticks) / ID666_TICKS_PER_MS;
+	}
+	if (tag->fade_ticks) {
+		fade = tag->fade_ticks / ID666_TICKS_PER_MS;
+	}
 
+	if (play == 0) { return 0; }
+	play += fade;
+
+	return play > 0xffffffff ? 0xffffffff : play;
+}
 
@@ -19,19 +19,36 @@
 #define _id666_h__
 
 
+/* longest xid6 string, the ID666 fields are 32 bytes at most */
+#define ID666_MAXSTR	256
+
+/* xid6 lengths count 1/64000 second ticks */
+#define ID666_TICKS_PER_MS	64
+
 typedef struct
 {
-	char title[33]; // 32 in file
-	char game_title[33]; // 32 in file
-	char name_of_dumper[17]; // 16 in file
-	char comments[33]; // 32 in file
-
-	//unsigned char date[12]; // 11 in file
-	char seconds_til_fadeout[4]; // 3 in file
-	//unsigned char length_of_fadeout[6]; // 5 in file, milliseconds
-	//unsigned char artist[33]; // 32 in file
-	//unsigned char chn_dis;
-	//unsigned char emulator_used; // 0 unknown, 1 zsnes, 2 snes9x
+	char title[ID666_MAXSTR+1]; // 32 in file
+	char game_title[ID666_MAXSTR+1]; // 32 in file
+	char name_of_dumper[ID666_MAXSTR+1]; // 16 in file
+	char comments[ID666_MAXSTR+1]; // 32 in file
+	char artist[ID666_MAXSTR+1]; // 32 in file
+
+	char date[12]; // 11 in file, MM/DD/YYYY
+	char seconds_til_fadeout[9]; // 3 in file
+	unsigned int seconds;
+	unsigned int fade_ms;
+	unsigned char chn_dis;
+	unsigned char emulator_used; // 0 unknown, 1 zsnes, 2 snes9x
+
+	int binary; // the header used the binary variant
+
+	/* only in the xid6 chunk after the ram */
+	int has_xid6;
+	char ost_title[ID666_MAXSTR+1];
+	char publisher[ID666_MAXSTR+1];
+	int ost_disc, ost_track, copyright_year;
+	unsigned int intro_ticks, loop_ticks, end_ticks, fade_ticks;
+	int loops;
 
 } id666_tag;
 
@@ -43,5 +60,13 @@ typedef struct
  */
 int read_id666(FILE *fptr, id666_tag *tag);
 
+/* the same from a whole .spc file in memory. The xid6 chunk is
+ * only seen if len covers it. */
+int parse_id666(const unsigned char *spc, size_t len, id666_tag *tag);
+
+/* playing time including the fade, in milliseconds. 0 if the tag
+ * does not say. */
+unsigned int id666_duration(const id666_tag *tag);
+
 #endif // _id666_h__
 
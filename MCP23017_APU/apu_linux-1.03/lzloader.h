@@ -0,0 +1,109 @@
+/* code loaded at 0x02. Expands a spcpack.h stream into 0x200-0xffff,
+ * taking the stream 3 bytes per handshake like fastloader.h. It then
+ * leaves the sum of 0x200-0xffbf on ports 2 and 3 and goes back to the
+ * IPL rom (see LZcode.asm). Uses the stack in page 1, so that page is
+ * sent through the IPL afterwards, along with the zero page. */
+static unsigned char lzloader[189] = {
+	0x8f, 0x00, 0x00,	// start: MOV 00, #00	; destination pointer, [00]+Y
+	0x8f, 0x02, 0x01,	// MOV 01, #02	; starts at 0200
+	0x8f, 0x00, 0xe2,	// MOV e2, #00	; bytes left in the port buffer
+	0x8f, 0x00, 0xe3,	// MOV e3, #00	; handshake counter
+	0x8d, 0x00,		// MOV Y, #00
+	0x3f, 0x9b, 0x00,	// next: CALL getb	; control byte
+	0x68, 0x80,		// CMP A, #80
+	0xb0, 0x13,		// BCS nlit
+	0x5d,			// MOV X, A
+	0x3d,			// INC X	; literal: c+1 bytes
+	0x3f, 0x9b, 0x00,	// lit: CALL getb
+	0xd7, 0x00,		// MOV [00]+Y, A
+	0xfc,			// INC Y
+	0xd0, 0x04,		// BNE +4
+	0xab, 0x01,		// INC 01
+	0xf0, 0x49,		// BEQ done	; wrapped past ffff
+	0x1d,			// DEC X
+	0xd0, 0xf1,		// BNE lit
+	0x2f, 0xe6,		// BRA next
+	0x68, 0xc0,		// nlit: CMP A, #c0	; C stays set for copies
+	0x28, 0x3f,		// AND A, #3f
+	0x5d,			// MOV X, A
+	0x3d,			// INC X
+	0x3d,			// INC X
+	0x3d,			// INC X	; (c & 3f) + 3 bytes
+	0xb0, 0x11,		// BCS copy
+	0x3f, 0x9b, 0x00,	// CALL getb	; run: the value
+	0xd7, 0x00,		// run: MOV [00]+Y, A
+	0xfc,			// INC Y
+	0xd0, 0x04,		// BNE +4
+	0xab, 0x01,		// INC 01
+	0xf0, 0x2e,		// BEQ done
+	0x1d,			// DEC X
+	0xd0, 0xf4,		// BNE run
+	0x2f, 0xcb,		// BRA next
+	0x3f, 0x9b, 0x00,	// copy: CALL getb	; copy: distance back
+	0xc4, 0xea,		// MOV ea, A
+	0x3f, 0x9b, 0x00,	// CALL getb
+	0xc4, 0xeb,		// MOV eb, A
+	0xe8, 0x00,		// MOV A, #00	; [e8]+Y = destination - distance
+	0x80,			// SETC
+	0xa4, 0xea,		// SBC A, ea
+	0xc4, 0xe8,		// MOV e8, A
+	0xe4, 0x01,		// MOV A, 01
+	0xa4, 0xeb,		// SBC A, eb
+	0xc4, 0xe9,		// MOV e9, A
+	0xf7, 0xe8,		// cp: MOV A, [e8]+Y
+	0xd7, 0x00,		// MOV [00]+Y, A
+	0xfc,			// INC Y
+	0xd0, 0x06,		// BNE +6
+	0xab, 0x01,		// INC 01
+	0xf0, 0x07,		// BEQ done
+	0xab, 0xe9,		// INC e9
+	0x1d,			// DEC X
+	0xd0, 0xf0,		// BNE cp
+	0x2f, 0xa2,		// BRA next
+	0x8f, 0x02, 0x01,	// done: MOV 01, #02	; 16 bit sum of 0200-ffbf, the
+	0xe8, 0x00,		// MOV A, #00	; rom hides ffc0-ffff
+	0x8f, 0x00, 0xe7,	// MOV e7, #00
+	0x60,			// sum: CLRC
+	0x97, 0x00,		// ADC A, [00]+Y
+	0x90, 0x02,		// BCC +2
+	0xab, 0xe7,		// INC e7
+	0xfc,			// INC Y
+	0xd0, 0xf6,		// BNE sum
+	0xab, 0x01,		// INC 01
+	0x78, 0xff, 0x01,	// CMP 01, #ff
+	0xd0, 0xef,		// BNE sum
+	0x60,			// last: CLRC
+	0x97, 0x00,		// ADC A, [00]+Y
+	0x90, 0x02,		// BCC +2
+	0xab, 0xe7,		// INC e7
+	0xfc,			// INC Y
+	0xad, 0xc0,		// CMP Y, #c0
+	0xd0, 0xf4,		// BNE last
+	0xc4, 0xf6,		// MOV f6, A	; sum on ports 2 and 3,
+	0xfa, 0xe7, 0xf7,	// MOV f7, e7	; the rom only sets 0 and 1
+	0x5f, 0xc9, 0xff,	// JMP ffc9
+	0x8b, 0xe2,		// getb: DEC e2	; next stream byte in A
+	0x10, 0x17,		// BPL have
+	0xe4, 0xe3,		// MOV A, e3
+	0x64, 0xf4,		// wait: CMP A, f4
+	0xd0, 0xfc,		// BNE wait
+	0xfa, 0xf5, 0xe4,	// MOV e4, f5
+	0xfa, 0xf6, 0xe5,	// MOV e5, f6
+	0xfa, 0xf7, 0xe6,	// MOV e6, f7
+	0xc4, 0xf4,		// MOV f4, A	; ack at once, the host sends
+	0xbc,			// INC A	; the next three meanwhile
+	0xc4, 0xe3,		// MOV e3, A
+	0x8f, 0x02, 0xe2,	// MOV e2, #02
+	0xe4, 0xe4,		// have: MOV A, e4
+	0xfa, 0xe5, 0xe4,	// MOV e4, e5
+	0xfa, 0xe6, 0xe5,	// MOV e5, e6
+	0x6f			// RET
+};
+
+/* what the loader restores, and what its sum covers */
+#define LZLOADER_START		0x0200
+#define LZLOADER_LENGTH		(0x10000 - LZLOADER_START)
+#define LZLOADER_SUM_END	0xffc0
+
+/* the sum takes the spc700 about a second after the last handshake */
+#define LZLOADER_TIMEOUT	3000
@@ -20,15 +20,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <poll.h>
 #include <sys/time.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
 #include <time.h>
 //#include "parport.h"
 #include "apuplay.h"
 #include "apu.h"
 #include "id666.h"
+#include "spcfile.h"
+#include "prefetch.h"
+#include "apud.h"
+#include "apudev.h"
+#include "rt.h"
 
 #include "apu_ppio.h"
 #include "apu_ppdev.h"
+#include "apu_mcp23x17.h"
+#include "apu_sim.h"
 
 #ifdef DJGPP
 /* todo: use conio */
@@ -47,6 +60,8 @@ int g_progress = 1;
 int g_debug = 0;
 int g_exit_now = 0;
 int g_use_embedded = 0;
+int g_upload_mode = UPLOAD_FAST;
+int g_verify = 0;
 
 static void printTime(int seconds);
 
@@ -54,10 +69,14 @@ static APU_ops *apu_ops;
 
 struct timeval last_int = {0, 0};
 
-void signal_handler(int sig)
+/* the apus of -M, whose staging quitting cancels */
+static apudev * volatile pingpong_devs[2];
+
+/* a first ^C ends the song, a second one within 1.5 seconds quits */
+static void interrupted(void)
 {
 	struct timeval tv_now;
-	int elaps_milli;
+	int elaps_milli, i;
 	static int first=1;
 	
 	g_playing = 0;
@@ -75,16 +94,300 @@ void signal_handler(int sig)
 
 		if (elaps_milli < 1500) {
 			g_exit_now = 1;
+			for (i=0; i<2; i++) {
+				if (pingpong_devs[i]) { apudev_cancel(pingpong_devs[i]); }
+			}
 		}
 	}
 	
 	memcpy(&last_int, &tv_now, sizeof(struct timeval));
 }
 
+void signal_handler(int sig)
+{
+	interrupted();
+}
+
+static void printStatus(int elaps_sec, int num_sec, int loop)
+{
+	if (!loop) {
+		BOLD(); printf("Time: "); NORMAL();
+		printTime(elaps_sec);
+		printf(" [");
+		printTime(num_sec - elaps_sec);
+		printf("] of ");
+		printTime(num_sec);
+		printf(" \r");
+	}
+	else {
+		BOLD(); printf("Time: "); NORMAL();
+		printTime(elaps_sec);
+		printf(" \r");
+	}
+	fflush(stdout);
+}
+
+static int armTimer(int fd, int first_sec, int interval_sec)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = first_sec;
+	its.it_interval.tv_sec = interval_sec;
+
+	return timerfd_settime(fd, 0, &its, NULL);
+}
+
+/* Sleep until the song is over, ^C is pressed or, once a second, the
+ * status line is due. SIGINT arrives through a signalfd meanwhile, the
+ * handler stays in place for the uploads. In loop mode only ^C ends
+ * the song. */
+static void waitSong(int num_sec, int loop, int status_line)
+{
+	struct pollfd fds[3];
+	struct signalfd_siginfo si;
+	struct timespec start, now;
+	sigset_t mask, oldmask;
+	uint64_t expirations;
+	int i, res;
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigprocmask(SIG_BLOCK, &mask, &oldmask);
+
+	fds[0].fd = signalfd(-1, &mask, SFD_CLOEXEC);
+	fds[1].fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	fds[2].fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (fds[0].fd < 0 || fds[1].fd < 0 || fds[2].fd < 0) {
+		perror("signalfd/timerfd");
+		g_exit_now = 1;
+	}
+	else
+	{
+		/* the apu cannot be faded from here, the end timer covers
+		 * the fade too */
+		if (!loop) { armTimer(fds[1].fd, num_sec, 0); }
+		if (status_line) { armTimer(fds[2].fd, 1, 1); }
+	}
+	for (i=0; i<3; i++) {
+		fds[i].events = POLLIN;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (status_line) { printStatus(0, num_sec, loop); }
+
+	while (g_playing && !g_exit_now)
+	{
+		res = poll(fds, 3, -1);
+		if (res < 0) {
+			if (errno == EINTR) { continue; }
+			perror("poll");
+			break;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			if (read(fds[0].fd, &si, sizeof(si)) == sizeof(si)) {
+				interrupted();
+			}
+		}
+		if (fds[1].revents & POLLIN) {
+			read(fds[1].fd, &expirations, sizeof(expirations));
+			break;
+		}
+		if (fds[2].revents & POLLIN) {
+			read(fds[2].fd, &expirations, sizeof(expirations));
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			printStatus(now.tv_sec - start.tv_sec - (now.tv_nsec < start.tv_nsec),
+					num_sec, loop);
+		}
+	}
+
+	for (i=0; i<3; i++) {
+		if (fds[i].fd >= 0) { close(fds[i].fd); }
+	}
+	sigprocmask(SIG_SETMASK, &oldmask, NULL);
+}
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* --stats: what each phase of the last upload cost on the bus */
+static void printStats(void)
+{
+	const apu_stats *st = apu_getStats();
+	apu_stats total;
+	int i;
+
+	memset(&total, 0, sizeof(total));
+	printf("%-10s %8s %8s %8s %7s %7s %9s %10s\n", "phase", "reads", "writes",
+			"polls", "retries", "bytes", "ms", "bytes/s");
+	for (i=0; i<=APU_PHASES; i++)
+	{
+		const apu_stats *p = &st[i];
+
+		if (i == APU_PHASES) {
+			p = &total;
+		} else {
+			if (!st[i].reads && !st[i].writes) { continue; }
+			total.reads += p->reads;
+			total.writes += p->writes;
+			total.polls += p->polls;
+			total.retries += p->retries;
+			total.bytes += p->bytes;
+			total.ns += p->ns;
+		}
+		printf("%-10s %8lu %8lu %8lu %7lu %7lu %9.1f %10.0f\n",
+				i == APU_PHASES ? "total" : apu_phase_names[i],
+				p->reads, p->writes, p->polls, p->retries, p->bytes,
+				p->ns / 1e6, p->ns ? p->bytes * 1e9 / p->ns : 0.0);
+	}
+}
+
+/* -m and -M: the simulated apu or the expander board */
+static APU_ops *busOps(const char *bus)
+{
+	if (strncmp(bus, "sim", 3) == 0) {
+		return apu_sim_getOps();
+	}
+	return apu_mcp23x17_getOps();
+}
+
+static void printTag(id666_tag *tag)
+{
+	BOLD(); printf("Title: "); NORMAL();
+	printf("%s\n", tag->title);
+	BOLD(); printf("Game Title: "); NORMAL();
+	printf("%s\n", tag->game_title);
+	BOLD(); printf("Dumper: "); NORMAL();
+	printf("%s\n", tag->name_of_dumper);
+	BOLD(); printf("Artist: "); NORMAL();
+	printf("%s\n", tag->artist);
+	BOLD(); printf("Comments: "); NORMAL();
+	printf("%s\n", tag->comments);
+	BOLD(); printf("Seconds: "); NORMAL();
+	printf("%s\n", tag->seconds_til_fadeout);
+}
+
+static int songSeconds(id666_tag *tag)
+{
+	int num_sec = (id666_duration(tag) + 999) / 1000;
+
+	/* xid6 loop counts can make songs long, but not hours */
+	if (num_sec<1 || num_sec>3600) {
+		num_sec = 150;
+	}
+	return num_sec;
+}
+
+/* Two apus taking turns. While one plays, the next song is sent to
+ * the other one and left waiting in the IPL rom, so going to the next
+ * song is only a jump on one apu and a reset on the other. */
+static int playPingPong(char **files, int nfiles, char *buses[2],
+			int loop, int status_line, int play_and_exit)
+{
+	apudev *devs[2];
+	prefetch_item *items[2] = { NULL, NULL };
+	int songs[2] = { -1, -1 };	/* the song in items[], staged or playing */
+	int idle = 0, playing = -1;
+	int staged = -1;		/* the song being staged on the idle apu */
+	int i, d, ret = 0, left_playing = 0;
+
+	for (d=0; d<2; d++)
+	{
+		devs[d] = apudev_open(busOps(buses[d]), buses[d]);
+		if (devs[d]==NULL) {
+			if (d) { apudev_close(devs[0]); }
+			return 1;
+		}
+	}
+	pingpong_devs[0] = devs[0];
+	pingpong_devs[1] = devs[1];
+
+	for (i = 0; i<nfiles && !g_exit_now; i++)
+	{
+		g_playing = 1;
+
+		if (staged != i)
+		{
+			/* nothing ready: the first song, or its image was not */
+			printf("Now loading '%s'\n", files[i]);
+			if (songs[idle] != i) {
+				if (items[idle]) { prefetch_release(items[idle]); }
+				items[idle] = prefetch_get(i);
+				songs[idle] = i;
+			}
+			/* unreadable, perhaps already when it was to be staged:
+			 * passed, the exit status still tells */
+			if (items[idle]==NULL) { ret = 1; continue; }
+			if (items[idle]->res < 0) { break; }
+			apudev_stage(devs[idle], &items[idle]->img);
+		}
+		/* a ^C skipping the song that plays does not reach the idle
+		 * apu, only quitting cancels its staging (see interrupted) */
+		if (apudev_wait(devs[idle]) != 0) { break; }
+
+		apudev_start(devs[idle], &items[idle]->img);
+		if (playing >= 0) {
+			apudev_reset(devs[playing]);
+		}
+		playing = idle;
+		idle = !idle;
+
+		if (!items[playing]->tagged) {
+			printf("No tag\n");
+		}
+		printTag(&items[playing]->tag);
+
+		if (play_and_exit) {
+			/* leave it playing, the other apu is quiet */
+			left_playing = 1;
+			break;
+		}
+
+		/* the next song goes to the idle apu while this one plays */
+		staged = -1;
+		if (i+1 < nfiles)
+		{
+			if (items[idle]) { prefetch_release(items[idle]); }
+			items[idle] = prefetch_get(i+1);
+			songs[idle] = i+1;
+			if (items[idle] && items[idle]->res==0) {
+				apudev_stage(devs[idle], &items[idle]->img);
+				staged = i+1;
+			}
+		}
+
+		waitSong(songSeconds(&items[playing]->tag), loop, status_line);
+		if (g_playing)
+			printf("\nFinished playing.\n");
+	}
+
+	pingpong_devs[0] = pingpong_devs[1] = NULL;
+	for (d=0; d<2; d++)
+	{
+		apudev_cancel(devs[d]);
+		apudev_wait(devs[d]);
+		if (!left_playing) {
+			apudev_reset(devs[d]);
+		}
+		if (items[d]) { prefetch_release(items[d]); }
+		apudev_close(devs[d]);
+	}
+
+	return ret;
+}
+
 void printhelp(void)
 {
 	printf("apuplay version %s\n\n", VERSION_STR);
-	printf("Usage: ./apuplay [options] spc_file\n\n");
+	printf("Usage: ./apuplay [options] spc_file...\n\n");
+	printf("A zip archive plays every .spc inside it, 'set.zip#3' only\n");
+	printf("the third one.\n\n");
 	printf("Supported options:\n\n");
 	printf("  -v       Verbose\n");
 	printf("  -l       Endless loop mode. Ignore ID666 tag time\n");
@@ -97,6 +400,44 @@ void printhelp(void)
 	printf("           significant on a PC. It was used to develop the code\n");
 	printf("           which I use on the portable APU player.\n");
 	printf("  -d       Debug mode. Adds a lot of verbose output.\n");
+	printf("  -u mode  How to send the spc ram: 'fast' (default) uploads a\n");
+	printf("           loader taking 3 bytes per handshake, 'ipl' sends\n");
+	printf("           everything through the IPL rom, 'lz' sends it\n");
+	printf("           compressed. lz saves bus time on the I2C board but\n");
+	printf("           adds about a second of spc700 work. 'stream'\n");
+	printf("           writes without waiting for the apu and checks\n");
+	printf("           every 192 bytes. 'delta' sends only the pages\n");
+	printf("           that changed since the previous file, which helps\n");
+	printf("           with albums.\n");
+	printf("  -V       Verify the uploaded ram page by page and send the\n");
+	printf("           damaged pages again. Costs about a second.\n");
+	printf("  -R       Real-time mode: SCHED_FIFO, locked memory, single cpu.\n");
+	printf("           Needs root. Best combined with isolcpus= on the kernel\n");
+	printf("           command line.\n");
+	printf("  -C cpu   Cpu to run on in real-time mode (default: the last one)\n");
+	printf("  -J       Print a latency histogram of the handshakes after each\n");
+	printf("           upload\n");
+	printf("  --stats  After each upload, print the bus reads, writes, polls,\n");
+	printf("           retries, bytes and bytes/s of each phase (loader,\n");
+	printf("           dsp, zero page, ram, verify), with the -J histograms\n");
+	printf("  -S out   Reset the apu and save its ram and dsp registers to\n");
+	printf("           the file out. The reset loses the cpu registers and\n");
+	printf("           the zero page and mutes the dsp, so these, FLG and KON\n");
+	printf("           come from the .spc that was loaded, which must be given.\n");
+	printf("           The file restarts the song with the ram as it was.\n");
+	printf("  -P n     Songs to read and prepare ahead while one plays\n");
+	printf("           (default 2, 0 prepares each one when it starts)\n");
+	printf("  -D sock  Stay resident and take commands on the unix socket\n");
+	printf("           sock, the files given being queued. See apud.h\n");
+	printf("           for the commands.\n");
+	printf("  -m bus   Bus the board is wired to: spi[@addr], i2c[:dev][@addr]\n");
+	printf("           or gpio (default). Used unless -p or -i is given.\n");
+	printf("           addr is the expander's hardware address, 0-7 on spi\n");
+	printf("           and 0x20-0x27 on i2c. sim[:latency] uses a simulated\n");
+	printf("           apu instead, each access taking latency us (default 0).\n");
+	printf("  -M bus   A second board on another bus or address. The two\n");
+	printf("           take turns: the next song is sent to one while the\n");
+	printf("           other plays.\n");
 #ifdef PPDEV_SUPPORTED
 	printf("  -p dev   Use ppdev instead of direct I/O\n");
 #endif
@@ -112,24 +453,35 @@ int main(int argc, char **argv)
 	int use_ppdev=0;
 	int use_ppio=0;
 	int io_specified=0;
+	char *mcp_bus="", *mcp_bus2=NULL;
 	int reset_and_exit=0, status_line=1, loop=0, play_and_exit=0;
-	char *filename;
-	FILE *fptr=NULL;
+	int realtime=0, rt_cpu=-1;
+	char *filename, *snapshot=NULL, *daemon_socket=NULL;
+	FILE *fptr=NULL, *fout;
+	spcfile spc;
+	prefetch_item *item = NULL;
+	int tagged, prefetch_depth = 2, stats = 0;
+	struct timespec load_start;
+	static const struct option long_options[] = {
+		{ "stats", no_argument, NULL, 'T' },
+		{ NULL, 0, NULL, 0 }
+	};
+	char **files;
+	int nfiles;
 	id666_tag tag;
-	struct timeval tv_before, tv_now;
 	
 	signal(SIGINT, signal_handler);
 
-	while((res =getopt(argc, argv, 
+	while((res =getopt_long(argc, argv, 
 
-					"rslvhxed"
+					"rslvhxedRJVC:m:M:u:S:P:D:"
 #ifdef PPDEV_SUPPORTED
 					"p"
 #endif
 #ifdef PPIO_SUPPORTED
 					"i"
 #endif
-					))>=0)
+					, long_options, NULL))>=0)
 	{
 		switch(res)
 		{
@@ -157,6 +509,57 @@ int main(int argc, char **argv)
 			case 'x':
 				play_and_exit = 1;
 				break;
+			case 'R':
+				realtime = 1;
+				break;
+			case 'C':
+				rt_cpu = atoi(optarg);
+				break;
+			case 'J':
+				rt_measuring = 1;
+				break;
+			case 'T':
+				stats = 1;
+				rt_measuring = 1;
+				break;
+			case 'P':
+				prefetch_depth = atoi(optarg);
+				if (prefetch_depth < 0) {
+					fprintf(stderr, "Bad prefetch depth\n");
+					return 1;
+				}
+				break;
+			case 'V':
+				g_verify = 1;
+				break;
+			case 'S':
+				snapshot = optarg;
+				break;
+			case 'D':
+				daemon_socket = optarg;
+				break;
+			case 'm':
+				mcp_bus = optarg;
+				break;
+			case 'M':
+				mcp_bus2 = optarg;
+				break;
+			case 'u':
+				if (strcmp(optarg, "fast")==0) {
+					g_upload_mode = UPLOAD_FAST;
+				} else if (strcmp(optarg, "ipl")==0) {
+					g_upload_mode = UPLOAD_IPL;
+				} else if (strcmp(optarg, "lz")==0) {
+					g_upload_mode = UPLOAD_LZ;
+				} else if (strcmp(optarg, "stream")==0) {
+					g_upload_mode = UPLOAD_STREAM;
+				} else if (strcmp(optarg, "delta")==0) {
+					g_upload_mode = UPLOAD_DELTA;
+				} else {
+					fprintf(stderr, "Unknown upload mode '%s'. try -h\n", optarg);
+					return -1;
+				}
+				break;
 #ifdef PPDEV_SUPPORTED
 			case 'p':
 				use_ppdev = 1;
@@ -176,53 +579,93 @@ int main(int argc, char **argv)
 	}
 
 	
-	if (argc-optind<=0 && !reset_and_exit) {
+	if (argc-optind<=0 && !reset_and_exit && !snapshot && !daemon_socket) {
 		fprintf(stderr, "No file specified. Try -h\n");
 		return -2;
 	}
 
-#ifdef PPDEV_SUPPORTED
-	if (!io_specified) {
-		use_ppdev = 1;
-		io_specified = 1;
+	/* the song's registers and zero page cannot be read back */
+	if (snapshot && argc-optind<=0) {
+		fprintf(stderr, "-S needs the .spc file that was loaded. Try -h\n");
+		return -2;
 	}
-#endif
+
+	/* the parallel port layers are only used when asked for with -p or -i */
+	apu_ops = busOps(mcp_bus);
 
 #ifdef PPIO_SUPPORTED
-	if (!io_specified) {
-		use_ppio = 1;
-		io_specified = 1;
+	if (use_ppio)
+	{
+		apu_ops = apu_ppio_getOps();
 	}
 #endif
 
-	if (!io_specified) {
-		fprintf(stderr, "No io layer for apu compiled\n");
-		return -3;
-	}
-	
 #ifdef PPDEV_SUPPORTED
 	if (use_ppdev) {
 		apu_ops = apu_ppdev_getOps();
 	} 
-	else 
 #endif
 
-#ifdef PPIO_SUPPORTED
-	if (use_ppio)
+
+	if (mcp_bus2)
 	{
-		apu_ops = apu_ppio_getOps();
-	}
-#endif
+		char *buses[2] = { mcp_bus, mcp_bus2 };
 
+		/* the gpio wiring has no address, only one board fits */
+		if (io_specified || *mcp_bus==0 || strcmp(mcp_bus, "gpio")==0 ||
+				strcmp(mcp_bus2, "gpio")==0) {
+			fprintf(stderr, "-M needs both boards on spi, i2c or sim. try -h\n");
+			return 1;
+		}
+		if (g_use_embedded || snapshot || reset_and_exit || daemon_socket) {
+			fprintf(stderr, "-M only plays files. try -h\n");
+			return 1;
+		}
+		if (realtime) {
+			rt_enable(rt_cpu, RT_DEFAULT_PRIORITY);
+		}
+
+		files = spcfile_list(&argv[optind], argc-optind, &nfiles);
+		if (files==NULL) { return 1; }
+		if (prefetch_start(files, nfiles, prefetch_depth)<0) {
+			return 1;
+		}
+		res = playPingPong(files, nfiles, buses, loop, status_line, play_and_exit);
+		prefetch_stop();
+
+		return res;
+	}
 
 	apu_setOps(apu_ops);
 
+	/* before init, so the io layer's buffers get locked too */
+	if (realtime) {
+		rt_enable(rt_cpu, RT_DEFAULT_PRIORITY);
+	}
+
 	/* initialize the interface with the module.
 	 * (Open device, get io permissions, etc...) */
-	if (apu_ops->init("")<0) {
+	if (apu_ops->init(io_specified ? "" : mcp_bus)<0) {
 		return 1;
 	}
 	
+	if (snapshot)
+	{
+		fptr = fopen(argv[optind], "rb");
+		if (fptr==NULL) { perror("fopen"); return 1; }
+
+		fout = fopen(snapshot, "wb");
+		if (fout==NULL) { perror("fopen"); return 1; }
+
+		if (g_verbose) { printf("Saving the APU to '%s'\n", snapshot); }
+		res = SaveAPU(fout, fptr);
+		fclose(fout);
+		fclose(fptr);
+		if (res != 0) { remove(snapshot); }
+
+		return res != 0;
+	}
+
 	if (reset_and_exit) 
 	{
 		if (g_verbose) { printf("Resetting APU\n"); }					
@@ -233,101 +676,97 @@ int main(int argc, char **argv)
 
 
 
-	for (i = optind; i<argc; i++)
+	/* zip archives stand for their .spc members */
+	files = spcfile_list(&argv[optind], argc-optind, &nfiles);
+	if (files==NULL) { return 1; }
+
+	if (daemon_socket)
+	{
+		res = apud_run(daemon_socket, files, nfiles, prefetch_depth);
+		apu_reset();
+
+		return res != 0;
+	}
+
+	/* while a song plays the next ones are read and prepared. The
+	 * embedded algo works from the file itself. */
+	if (prefetch_start(files, nfiles, g_use_embedded ? 0 : prefetch_depth)<0) {
+		return 1;
+	}
+
+	for (i = 0; i<nfiles; i++)
 	{
 		if (g_exit_now) { break; }
 
-		filename = argv[i];
+		filename = files[i];
 			
-		fptr = fopen(filename, "rb");
-		if (fptr==NULL) { perror("fopen"); return 1; }
+		if (g_use_embedded) {
+			if (spcfile_open(&spc, filename)<0) { return 1; }
+			tagged = parse_id666(spc.data, spc.len, &tag);
+		} else {
+			item = prefetch_get(i);
+			if (item==NULL) { return 1; }
+			memcpy(&tag, &item->tag, sizeof(id666_tag));
+			tagged = item->tagged;
+		}
 
-		read_id666(fptr, &tag);
+		if (!tagged) {
+			printf("No tag\n");
+		}
 	
 		g_playing = 1;
 
-                time_t start, end;
-                start = time (NULL);
+		clock_gettime(CLOCK_MONOTONIC, &load_start);
+		apu_resetStats();
 
 		printf("Now loading '%s'", filename);
 		if (g_use_embedded) {
 			printf(" using 'embedded' algo\n");
-			if (LoadAPU_embedded(fptr)<0) { break; }
+			fptr = fmemopen((void*)spc.data, spc.len, "rb");
+			if (fptr==NULL) { perror("fmemopen"); return 1; }
+			res = LoadAPU_embedded(fptr);
+			fclose(fptr);
+			spcfile_close(&spc);
 		} else  {
 			printf("  \n");
-			if (LoadAPU(fptr)<0) { break; }
+			res = item->res;
+			if (res==0) {
+				res = LoadAPU_image(&item->img);
+			}
+			prefetch_release(item);
+		}
+		if (res<0) { break; }
+
+		printf("Took %.2f seconds to load APU.\n", elapsed(&load_start));
+
+		if (stats) {
+			printStats();
 		}
 
-                end = time (NULL);
-                printf("Took %ld seconds to load APU.\n", (end - start) );
+		if (rt_measuring) {
+			rt_hist_report();
+			rt_hist_reset();
+		}
 
 
 		if (!g_playing) { continue; } // next
 		if (g_exit_now) { break; }
 
-		BOLD(); printf("Title: "); NORMAL();
-		printf("%s\n", tag.title);
-		BOLD(); printf("Game Title: "); NORMAL();
-		printf("%s\n", tag.game_title);
-		BOLD(); printf("Dumper: "); NORMAL();
-		printf("%s\n", tag.name_of_dumper);
-		BOLD(); printf("Comments: "); NORMAL();
-		printf("%s\n", tag.comments);
-		BOLD(); printf("Seconds: "); NORMAL();
-		printf("%s\n", tag.seconds_til_fadeout);
-
-		fclose(fptr);
+		printTag(&tag);
 
 		if (play_and_exit) {
 			return 0;
 		}
 
-		gettimeofday(&tv_before, NULL);
-		
 		{
-			int elaps_sec;
-			int num_sec = atoi(tag.seconds_til_fadeout);
-			int last_elaps_sec=-1;
-	
-			if (num_sec<1 || num_sec>999) {
-				num_sec = 150;
-			}
+			int num_sec = songSeconds(&tag);
+
 			if (strlen(tag.title)==0) {
 				strncpy(tag.title, filename, 32);
 			}
 			
 			if (g_exit_now) { break; }
-			while (g_playing)
-			{
-				gettimeofday(&tv_now, NULL);
-				elaps_sec = tv_now.tv_sec - tv_before.tv_sec;
-				if (elaps_sec > num_sec) { break; }
-				
-				if (status_line)
-				{
-					if (last_elaps_sec != elaps_sec)
-					{
-						if (!loop) {
-							BOLD(); printf("Time: "); NORMAL();
-							printTime(elaps_sec);
-							printf(" [");
-							printTime(num_sec - elaps_sec);
-							printf("] of ");
-							printTime(num_sec);
-							printf(" \r");
-						}
-						else {
-							BOLD(); printf("Time: "); NORMAL();
-							printTime(elaps_sec);
-							printf(" \r");
-						}
-					}
-					last_elaps_sec = elaps_sec;
-					fflush(stdout);
-				}
-						
-				usleep(7500); // update every 75 ms
-			}
+			waitSong(num_sec, loop, status_line);
 			if (g_playing)
 				printf("\nFinished playing.\n");
 			
@@ -337,6 +776,7 @@ int main(int argc, char **argv)
 		
 	}
 	
+	prefetch_stop();
 	apu_reset();
 
 	return 0;
@@ -359,4 +799,3 @@ static void printTime(int seconds)
 	printf("%02d:%02d:%02d", hour, min, sec);
 }
 
-
@@ -0,0 +1,209 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include "prefetch.h"
+#include "spcfile.h"
+
+/* Slot states. A slot holds the item of one song of the list. */
+#define SLOT_EMPTY	0
+#define SLOT_READY	1
+#define SLOT_FAILED	2
+#define SLOT_GONE	3	/* handed out or skipped */
+
+static char **pf_files;
+static int pf_count, pf_depth;
+
+static prefetch_item **pf_items;
+static char *pf_state;
+static int pf_next;	/* the next song the worker prepares */
+static int pf_want;	/* the song the player waits for or plays */
+static int pf_stop, pf_running;
+
+static pthread_t pf_thread;
+static pthread_mutex_t pf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pf_cond = PTHREAD_COND_INITIALIZER;
+
+static prefetch_item *prepare(const char *filename)
+{
+	prefetch_item *item;
+	spcfile f;
+
+	if (spcfile_open(&f, filename) < 0) {
+		return NULL;
+	}
+	item = malloc(sizeof(prefetch_item));
+	if (item == NULL) {
+		perror("malloc");
+		spcfile_close(&f);
+		return NULL;
+	}
+
+	item->tagged = parse_id666(f.data, f.len, &item->tag);
+	item->res = spcimage_prepare(&item->img, f.data, f.len);
+
+	spcfile_close(&f);
+	return item;
+}
+
+static void *worker(void *arg)
+{
+	prefetch_item *item;
+	int i;
+
+	pthread_mutex_lock(&pf_lock);
+	while (1)
+	{
+		/* the song playing and 'depth' more */
+		while (!pf_stop && pf_next < pf_count && pf_next > pf_want + pf_depth) {
+			pthread_cond_wait(&pf_cond, &pf_lock);
+		}
+		if (pf_stop || pf_next >= pf_count) { break; }
+
+		/* skipped while waiting */
+		if (pf_next < pf_want) {
+			pf_next = pf_want;
+		}
+		i = pf_next;
+		pthread_mutex_unlock(&pf_lock);
+
+		item = prepare(pf_files[i]);
+
+		pthread_mutex_lock(&pf_lock);
+		if (i < pf_want) {
+			free(item);
+		} else {
+			pf_items[i] = item;
+			pf_state[i] = item ? SLOT_READY : SLOT_FAILED;
+		}
+		pf_next = i + 1;
+		pthread_cond_broadcast(&pf_cond);
+	}
+	pthread_mutex_unlock(&pf_lock);
+
+	return NULL;
+}
+
+int prefetch_start(char **files, int count, int depth)
+{
+	sigset_t all, old;
+	int res;
+
+	pf_files = files;
+	pf_count = count;
+	pf_depth = depth;
+	pf_next = pf_want = 0;
+	pf_stop = 0;
+
+	pf_items = calloc(count ? count : 1, sizeof(prefetch_item*));
+	pf_state = calloc(count ? count : 1, 1);
+	if (pf_items == NULL || pf_state == NULL) {
+		perror("calloc");
+		return -1;
+	}
+
+	if (depth == 0) {
+		return 0;
+	}
+	/* leave SIGINT to the player: the worker starts with every signal blocked */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	res = pthread_create(&pf_thread, NULL, worker, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (res != 0) {
+		fprintf(stderr, "Cannot start the prefetch thread, loading on demand\n");
+		pf_depth = 0;
+		return 0;
+	}
+	pf_running = 1;
+
+	return 0;
+}
+
+prefetch_item *prefetch_get(int i)
+{
+	prefetch_item *item;
+	int j;
+
+	if (i < 0 || i >= pf_count) {
+		return NULL;
+	}
+	if (!pf_running) {
+		return prepare(pf_files[i]);
+	}
+
+	pthread_mutex_lock(&pf_lock);
+
+	/* behind the worker, or asked for again: not worth moving the
+	 * worker back, this one is prepared here */
+	if (i < pf_want || pf_state[i] == SLOT_GONE) {
+		pthread_mutex_unlock(&pf_lock);
+		return prepare(pf_files[i]);
+	}
+
+	for (j=pf_want; j<i; j++) {
+		free(pf_items[j]);
+		pf_items[j] = NULL;
+		pf_state[j] = SLOT_GONE;
+	}
+	pf_want = i;
+	pthread_cond_broadcast(&pf_cond);
+
+	while (pf_state[i] == SLOT_EMPTY) {
+		pthread_cond_wait(&pf_cond, &pf_lock);
+	}
+	item = pf_items[i];
+	pf_items[i] = NULL;
+	pf_state[i] = SLOT_GONE;
+	pthread_mutex_unlock(&pf_lock);
+
+	return item;
+}
+
+void prefetch_release(prefetch_item *item)
+{
+	free(item);
+}
+
+void prefetch_stop(void)
+{
+	int i;
+
+	if (pf_running)
+	{
+		pthread_mutex_lock(&pf_lock);
+		pf_stop = 1;
+		pthread_cond_broadcast(&pf_cond);
+		pthread_mutex_unlock(&pf_lock);
+
+		pthread_join(pf_thread, NULL);
+		pf_running = 0;
+	}
+
+	for (i=0; i<pf_count; i++) {
+		free(pf_items[i]);
+	}
+	free(pf_items);
+	free(pf_state);
+	pf_items = NULL;
+	pf_state = NULL;
+}
+
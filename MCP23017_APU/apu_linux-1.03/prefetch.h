@@ -0,0 +1,51 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _prefetch_h__
+#define _prefetch_h__
+
+#include "id666.h"
+#include "spcimage.h"
+
+/* A worker thread reads, tags and prepares the songs of the play
+ * list ahead of the one playing, so that starting the next one only
+ * costs the transfer to the apu. */
+typedef struct {
+	id666_tag tag;
+	int tagged;
+	spcimage img;
+	int res; /* from spcimage_prepare() */
+} prefetch_item;
+
+/* Prepare up to 'depth' songs of files[] ahead of the one asked for.
+ * With a depth of 0 prefetch_get() does the work itself.
+ *
+ * returns -1 on error, 0 otherwise */
+int prefetch_start(char **files, int count, int depth);
+
+/* Wait for song i. Songs before it that were not asked for are
+ * dropped. The worker only moves forward: a song behind it, or one
+ * asked for a second time, is read and prepared by the caller.
+ *
+ * returns NULL if the file could not be read */
+prefetch_item *prefetch_get(int i);
+void prefetch_release(prefetch_item *item);
+
+/* stop the worker and free what it prepared */
+void prefetch_stop(void);
+
+#endif // _prefetch_h__
@@ -0,0 +1,42 @@
+/* code loaded at 0x02. Sends the 128 dsp registers, one per handshake
+ * on port 1, then 0x100-0xffff three bytes per handshake on ports 1-3,
+ * and goes back to the IPL rom (see READcode.asm). The host echoes the
+ * counter the loader puts on port 0 once it has the bytes. */
+static unsigned char readloader[66] = {
+	0xcd, 0x00,		// start: MOV X, #00	; handshake counter
+	0x8d, 0x00,		// MOV Y, #00	; dsp address
+	0xcb, 0xf2,		// dsp: MOV f2, Y
+	0xe4, 0xf3,		// MOV A, f3
+	0xc4, 0xf5,		// MOV f5, A
+	0xd8, 0xf4,		// MOV f4, X	; register ready
+	0x3e, 0xf4,		// dwait: CMP X, f4
+	0xd0, 0xfc,		// BNE dwait	; wait for the host to echo it
+	0x3d,			// INC X
+	0xfc,			// INC Y
+	0x10, 0xf0,		// BPL dsp	; 128 registers
+	0x8f, 0x00, 0xf1,	// MOV f1, #00	; rom off, ffc0-ffff reads the ram
+	0x8f, 0x00, 0x00,	// MOV 00, #00	; source pointer
+	0x8f, 0x01, 0x01,	// MOV 01, #01	; starts at 0100
+	0x8d, 0x00,		// MOV Y, #00
+	0xf7, 0x00,		// ram: MOV A, [00]+Y
+	0xc4, 0xf5,		// MOV f5, A
+	0x3a, 0x00,		// INCW 00
+	0xf7, 0x00,		// MOV A, [00]+Y
+	0xc4, 0xf6,		// MOV f6, A
+	0x3a, 0x00,		// INCW 00
+	0xf7, 0x00,		// MOV A, [00]+Y
+	0xc4, 0xf7,		// MOV f7, A
+	0x3a, 0x00,		// INCW 00
+	0xd8, 0xf4,		// MOV f4, X	; bytes ready
+	0x3e, 0xf4,		// rwait: CMP X, f4
+	0xd0, 0xfc,		// BNE rwait
+	0x3d,			// INC X
+	0xe4, 0x01,		// MOV A, 01	; 0000 once the pointer wraps
+	0xd0, 0xe3,		// BNE ram
+	0x8f, 0x80, 0xf1,	// MOV f1, #80	; rom back on
+	0x5f, 0xc9, 0xff	// JMP ffc9	; back into the rom
+};
+
+/* what the loader sends after the dsp registers */
+#define READLOADER_START	0x0100
+#define READLOADER_LENGTH	(0x10000 - READLOADER_START)
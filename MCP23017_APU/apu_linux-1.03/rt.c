@@ -0,0 +1,170 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "rt.h"
+
+/* how much stack to fault in. LoadAPU alone keeps 64k on it. */
+#define PREFAULT_STACK	(256*1024)
+
+int rt_measuring = 0;
+
+/* the apu threads of -M share the histograms */
+static rt_hist *hist_list = NULL;
+static pthread_mutex_t hist_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void prefault_stack(void)
+{
+	volatile unsigned char dummy[PREFAULT_STACK];
+
+	memset((void*)dummy, 0, sizeof(dummy));
+}
+
+void rt_prefault(void *buf, size_t len)
+{
+	volatile unsigned char *p = buf;
+	long pagesize = sysconf(_SC_PAGESIZE);
+	size_t i;
+
+	if (buf == NULL)
+		return;
+	for (i=0; i<len; i+=pagesize) {
+		p[i] = p[i];
+	}
+}
+
+int rt_enable(int cpu, int priority)
+{
+	struct sched_param param;
+	cpu_set_t set;
+	int res = 0;
+
+	if (cpu < 0) {
+		cpu = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	}
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		perror("sched_setaffinity");
+		res = -1;
+	}
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+		perror("mlockall");
+		res = -1;
+	}
+	prefault_stack();
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+	if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
+		perror("sched_setscheduler (are you root?)");
+		res = -1;
+	}
+
+	if (res == 0) {
+		printf("Real-time mode: SCHED_FIFO priority %d on cpu %d\n", priority, cpu);
+	}
+
+	return res;
+}
+
+void rt_hist_add(rt_hist *h, uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	int b = 0;
+
+	while (us && b < RT_HIST_BUCKETS-1) {
+		us >>= 1;
+		b++;
+	}
+
+	pthread_mutex_lock(&hist_lock);
+	if (!h->registered) {
+		h->registered = 1;
+		h->next = hist_list;
+		hist_list = h;
+	}
+
+	h->buckets[b]++;
+	h->count++;
+	h->total_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+	pthread_mutex_unlock(&hist_lock);
+}
+
+void rt_hist_report(void)
+{
+	rt_hist *h;
+	unsigned long over_1ms;
+	int b, last;
+
+	pthread_mutex_lock(&hist_lock);
+	for (h = hist_list; h; h = h->next)
+	{
+		if (!h->count)
+			continue;
+
+		printf("\nLatency of %s: %lu samples, mean %.1f us, max %.1f us\n",
+				h->name, h->count,
+				h->total_ns / 1000.0 / h->count, h->max_ns / 1000.0);
+
+		last = 0;
+		over_1ms = 0;
+		for (b=0; b<RT_HIST_BUCKETS; b++) {
+			if (h->buckets[b])
+				last = b;
+			/* bucket 11 starts at 1024us */
+			if (b >= 11)
+				over_1ms += h->buckets[b];
+		}
+
+		for (b=0; b<=last; b++) {
+			if (b == 0)
+				printf("  %8s < %6dus %10lu\n", "", 1, h->buckets[b]);
+			else if (b == RT_HIST_BUCKETS-1)
+				printf("  %6s>= %6luus %10lu\n", "", 1ul<<(b-1), h->buckets[b]);
+			else
+				printf("  %6luus - %6luus %10lu\n", 1ul<<(b-1), 1ul<<b, h->buckets[b]);
+		}
+		printf("  outliers over 1ms: %lu\n", over_1ms);
+	}
+	pthread_mutex_unlock(&hist_lock);
+}
+
+void rt_hist_reset(void)
+{
+	rt_hist *h;
+
+	pthread_mutex_lock(&hist_lock);
+	for (h = hist_list; h; h = h->next)
+	{
+		memset(h->buckets, 0, sizeof(h->buckets));
+		h->count = 0;
+		h->total_ns = 0;
+		h->max_ns = 0;
+	}
+	pthread_mutex_unlock(&hist_lock);
+}
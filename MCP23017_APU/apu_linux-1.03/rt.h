@@ -0,0 +1,87 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _rt_h__
+#define _rt_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+/* Opt-in real-time mode for the bus critical loops (handshake busy
+ * waits, flip-flop strobes). Locks all memory, moves the process to
+ * one cpu and runs it SCHED_FIFO.
+ *
+ * cpu < 0 selects the last online cpu, which is the one usually
+ * isolated with isolcpus= on the kernel command line.
+ *
+ * The priority is kept below the kernel's threaded interrupt handlers
+ * (50) so the SPI/I2C drivers still get to run while we spin.
+ *
+ * returns 0 on success, -1 (with a message) if something could not be
+ * applied. The process keeps running in whatever state was reached. */
+int rt_enable(int cpu, int priority);
+
+#define RT_DEFAULT_PRIORITY	40
+
+/* Touch every page of a buffer so no page fault happens in a timed loop */
+void rt_prefault(void *buf, size_t len);
+
+/* Per operation latency histograms. Bucket n counts the samples
+ * between 2^(n-1) and 2^n microseconds (bucket 0 is below 1us), the
+ * last bucket collects everything longer. Histograms register
+ * themselves on their first sample and are printed by rt_hist_report.
+ * Any thread may add samples, a lock keeps the counters whole. */
+#define RT_HIST_BUCKETS	20
+
+typedef struct rt_hist {
+	const char *name;
+	unsigned long buckets[RT_HIST_BUCKETS];
+	unsigned long count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	struct rt_hist *next;
+	int registered;
+} rt_hist;
+
+#define RT_HIST_INIT(n)	{ (n), {0}, 0, 0, 0, NULL, 0 }
+
+/* set by -J, timestamps are only taken while it is set */
+extern int rt_measuring;
+
+void rt_hist_add(rt_hist *h, uint64_t ns);
+void rt_hist_report(void);
+void rt_hist_reset(void);
+
+/* returns 0 when not measuring, so rt_record can skip the sample */
+static inline uint64_t rt_stamp(void)
+{
+	struct timespec ts;
+
+	if (!rt_measuring)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void rt_record(rt_hist *h, uint64_t start)
+{
+	if (start)
+		rt_hist_add(h, rt_stamp() - start);
+}
+
+#endif // _rt_h__
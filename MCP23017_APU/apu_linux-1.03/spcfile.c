@@ -0,0 +1,170 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spcfile.h"
+#include "spczip.h"
+
+static void *mapFile(const char *path, size_t *len, int quiet)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		if (!quiet) { perror(path); }
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size == 0) {
+		if (!quiet) { fprintf(stderr, "%s: empty or unreadable\n", path); }
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	*len = st.st_size;
+	return map;
+}
+
+int spcfile_open(spcfile *f, const char *path)
+{
+	const char *hash = strrchr(path, '#');
+	char *zipname = NULL;
+	spczip z;
+	int index = 0;
+
+	memset(f, 0, sizeof(spcfile));
+
+	/* archive#member, unless the file really has that name */
+	if (hash && hash[1] && access(path, F_OK) < 0) {
+		index = atoi(hash + 1);
+		zipname = strndup(path, hash - path);
+		if (zipname == NULL) {
+			perror("strndup");
+			return -1;
+		}
+		path = zipname;
+	}
+
+	f->map = mapFile(path, &f->map_len, 0);
+	if (f->map == NULL) {
+		free(zipname);
+		return -1;
+	}
+	f->data = f->map;
+	f->len = f->map_len;
+
+	if (index)
+	{
+		if (spczip_open(&z, f->data, f->len) < 0) {
+			fprintf(stderr, "%s: not a zip archive\n", path);
+			free(zipname);
+			spcfile_close(f);
+			return -1;
+		}
+		f->buf = spczip_extract(&z, index, &f->len);
+		free(zipname);
+		if (f->buf == NULL) {
+			spcfile_close(f);
+			return -1;
+		}
+		/* the archive is not needed anymore */
+		munmap(f->map, f->map_len);
+		f->map = NULL;
+		f->data = f->buf;
+	}
+	return 0;
+}
+
+void spcfile_close(spcfile *f)
+{
+	if (f->map) {
+		munmap(f->map, f->map_len);
+	}
+	free(f->buf);
+	memset(f, 0, sizeof(spcfile));
+}
+
+int spcfile_members(const char *path)
+{
+	spczip z;
+	void *map;
+	size_t len;
+	int count = 0;
+
+	/* a zip starts with a local header, PK\3\4 */
+	map = mapFile(path, &len, 1);
+	if (map == NULL) {
+		return 0;
+	}
+	if (len >= 4 && memcmp(map, "PK\3\4", 4) == 0 &&
+			spczip_open(&z, map, len) == 0) {
+		count = spczip_count(&z);
+	}
+	munmap(map, len);
+	return count;
+}
+
+int spcfile_check(const unsigned char *data, size_t len)
+{
+	return len >= strlen(SPCFILE_MAGIC) &&
+		memcmp(data, SPCFILE_MAGIC, strlen(SPCFILE_MAGIC)) == 0;
+}
+
+char **spcfile_list(char **args, int count, int *nfiles)
+{
+	char **files, **grown;
+	char name[1024];
+	int i, m, members;
+
+	*nfiles = 0;
+	files = malloc(sizeof(char*));
+	if (files==NULL) { perror("malloc"); return NULL; }
+
+	for (i=0; i<count; i++)
+	{
+		members = spcfile_members(args[i]);
+		for (m = members ? 1 : 0; m <= members; m++)
+		{
+			grown = realloc(files, (*nfiles + 1) * sizeof(char*));
+			if (grown==NULL) { perror("realloc"); return NULL; }
+			files = grown;
+
+			if (members) {
+				snprintf(name, sizeof(name), "%s#%d", args[i], m);
+				files[*nfiles] = strdup(name);
+			} else {
+				files[*nfiles] = strdup(args[i]);
+			}
+			if (files[*nfiles]==NULL) { perror("strdup"); return NULL; }
+			(*nfiles)++;
+		}
+	}
+	return files;
+}
+
@@ -0,0 +1,56 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _spcfile_h__
+#define _spcfile_h__
+
+#include <stddef.h>
+
+/* An .spc file mapped read-only, or a member of a zip archive
+ * uncompressed in memory, parsed in place by spcimage_prepare() and
+ * parse_id666(). */
+typedef struct {
+	const unsigned char *data;
+	size_t len;
+
+	void *map;		/* the mapped file */
+	size_t map_len;
+	unsigned char *buf;	/* the zip member, malloc'ed */
+} spcfile;
+
+/* Open 'path'. "set.zip#3" is the third .spc member of set.zip.
+ *
+ * returns -1 on error, 0 otherwise */
+int spcfile_open(spcfile *f, const char *path);
+void spcfile_close(spcfile *f);
+
+/* number of .spc members if 'path' is a zip archive, 0 if it is not */
+int spcfile_members(const char *path);
+
+/* The paths to play for the command line arguments args[0..count-1],
+ * a zip archive standing for its .spc members.
+ *
+ * returns a malloc'ed list of strdup'ed names, NULL on error */
+char **spcfile_list(char **args, int count, int *nfiles);
+
+/* returns true if data starts with the .spc magic */
+int spcfile_check(const unsigned char *data, size_t len);
+
+/* the version after it varies between dumpers */
+#define SPCFILE_MAGIC	"SNES-SPC700 Sound File Data"
+
+#endif // _spcfile_h__
@@ -0,0 +1,254 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "apuplay.h"
+#include "bootcode.h"
+#include "dsprestore.h"
+#include "spcimage.h"
+
+extern int g_debug; // from main.c
+
+void spcarea_init(spcarea *a, int size)
+{
+	int j;
+
+	a->size = size;
+	a->value = -1;
+	a->count = 0;
+	for (j=0; j<256; j++) {
+		a->best[j] = -1;
+	}
+}
+
+void spcarea_add(spcarea *a, int ptr, unsigned char byte, int usable)
+{
+	if (!usable) {
+		a->count = 0;
+		return;
+	}
+	if (a->count && byte == a->value) {
+		a->count++;
+	} else {
+		a->value = byte;
+		a->count = 1;
+	}
+	/* the top 'size' bytes of the highest run */
+	if (a->count >= a->size) {
+		a->best[byte] = ptr - a->size + 1;
+	}
+}
+
+int spcarea_pick(const spcarea *a)
+{
+	int j;
+
+	for (j=255; j>=0; j--) {
+		if (a->best[j] >= 0) { return a->best[j]; }
+	}
+	return -1;
+}
+
+/* Look for 'size' consecutive identical bytes outside the echo region,
+ * page 0, page 1 and the rom area, in one pass. Returns -1 when there
+ * are none. */
+static int findFreeArea(const unsigned char *ram, int size, int echoregion, int echosize)
+{
+	spcarea a;
+	int ptr;
+
+	spcarea_init(&a, size);
+	for (ptr = 0x100; ptr <= 65471; ptr++) {
+		spcarea_add(&a, ptr, ram[ptr],
+			(ptr > echoregion + echosize) || (ptr < echoregion));
+	}
+	return spcarea_pick(&a);
+}
+
+int spcimage_prepare(spcimage *img, const unsigned char *spc, size_t len)
+{
+	unsigned char *file = NULL;
+	unsigned char *spcdata = img->ram, *dspdata = img->dsp;
+	unsigned char spc_pcl, spc_pch, spc_a, spc_x, spc_y, spc_sw, spc_sp;
+	/* the templates are shared, prefetch workers prepare images
+	 * at the same time as the player */
+	unsigned char boot[sizeof(bootcode)], restore[sizeof(dsprestore)];
+	int i, echoclear=2, bootsize, bootptr;
+
+	/* short files are padded, as fread left the rest alone */
+	if (len < SPCIMAGE_FILE_LEN) {
+		file = calloc(1, SPCIMAGE_FILE_LEN);
+		if (file == NULL) {
+			perror("calloc");
+			return -1;
+		}
+		memcpy(file, spc, len);
+		spc = file;
+	}
+
+	spc_pcl = spc[0x25];
+	spc_pch = spc[0x26];
+	spc_a = spc[0x27];
+	spc_x = spc[0x28];
+	spc_y = spc[0x29];
+	spc_sw = spc[0x2a];
+	spc_sp = spc[0x2b];
+
+	if (g_debug) {
+		printf("PC: %02x%02x\n", spc_pch, spc_pcl);
+		printf("A: %02X\n", spc_a);
+		printf("X: %02X\n", spc_x);
+		printf("Y: %02X\n", spc_y);
+		printf("SW: %02X\n", spc_sw);
+		printf("SP: %02X\n", spc_sp);
+	}
+
+	memcpy(spcdata, &spc[OFFSET_SPCDATA], 65536);
+	memcpy(dspdata, &spc[OFFSET_DSPDATA], 128);
+	/* the ram under the rom is sent instead of whatever the file has
+	 * at 0xffc0 */
+	memcpy(&spcdata[65472], &spc[OFFSET_SPCRAM], 64);
+	free(file);
+
+	memcpy(boot, bootcode, sizeof(boot));
+	memcpy(restore, dsprestore, sizeof(restore));
+
+	/* save a bunch of registers to be restored
+	 * later by the "bootcode" */
+	boot[BOOT_SPC_PORT0] = spcdata[SPC_PORT0];
+	boot[BOOT_SPC_PORT1] = spcdata[SPC_PORT1];
+	boot[BOOT_SPC_PORT2] = spcdata[SPC_PORT2];
+	boot[BOOT_SPC_PORT3] = spcdata[SPC_PORT3];
+	boot[0x01] = spcdata[0x00];
+	boot[0x04] = spcdata[0x01];
+	boot[BOOT_SPC_TIMER2] = spcdata[SPC_TIMER2];
+	boot[BOOT_SPC_TIMER1] = spcdata[SPC_TIMER1];
+	boot[BOOT_SPC_TIMER0] = spcdata[SPC_TIMER0];
+	boot[BOOT_SPC_CONTROL] = spcdata[SPC_CONTROL];
+	boot[BOOT_DSP_FLG] = dspdata[DSP_FLG];
+	boot[BOOT_DSP_KON] = dspdata[DSP_KON];
+	boot[BOOT_SPC_REGADD] = spcdata[SPC_REGADD];
+	boot[BOOT_A] = spc_a;
+	boot[BOOT_Y] = spc_y;
+	boot[BOOT_X] = spc_x;
+
+	/* push program counter and status ward on stack */
+	spcdata[0x100 + spc_sp - 0] = spc_pch;
+	spcdata[0x100 + spc_sp - 1] = spc_pcl;
+	spcdata[0x100 + spc_sp - 2] = spc_sw;
+	boot[BOOT_SP] = spc_sp - 3; // save new stack pointer
+
+	/* mute all voices */
+	dspdata[DSP_FLG] = DSP_FLG_MUTE|DSP_FLG_ECEN;
+	dspdata[DSP_KON] = 0x00; // Voice 0-7 off 
+
+	/* to produce an echo effect, the dsp uses a memory region.
+	 * ESA: Esa * 100h becomes the lead-off address of the echo
+	 * region. Calculate this address... */
+	img->echoregion = dspdata[DSP_ESA] * 256;
+
+	/* echo delay. The bigger the delay is, more memory is needed.
+	 * calculate how much memory used... */
+	img->echosize = dspdata[DSP_EDL] * 2048;
+	if (img->echosize==0) { img->echosize = 4; }
+
+	/* we need to find a place to install our boot code. It is
+	 * preceded by dsprestore and followed by the dsp registers if
+	 * there is room for all of that, otherwise the 77 bytes bootcode
+	 * alone.
+	 *
+	 * we attempt to find as many consecutive and identical bytes
+	 * anywhere in the memory, minus the bootrom area, minus the
+	 * page 0 (registers) and page 1 (stack), minus the
+	 * echo region. */
+	img->dspboot = 1;
+	bootsize = sizeof(dsprestore) + sizeof(bootcode) + 128;
+	bootptr = findFreeArea(spcdata, bootsize, img->echoregion, img->echosize);
+	if (bootptr < 0) {
+		img->dspboot = 0;
+		bootsize = sizeof(bootcode);
+		bootptr = findFreeArea(spcdata, bootsize, img->echoregion, img->echosize);
+	}
+
+	/* we did not find an area of consecutive identical byte values. */
+	if (bootptr < 0)
+	{
+		/* We will have to use the echo region. The region will need to be
+		 * at least 77 bytes... */
+		if (img->echosize < bootsize) {
+			fprintf(stderr, "This spc file does not have sufficient ram to be loaded");
+			return -1;
+		}
+		else {
+			/* we will use the echo region */
+			bootptr = img->echoregion;
+		}
+	}
+	img->bootptr = bootptr;
+
+	if (g_debug) { printf("Boot area: %d bytes%s\n", bootsize, img->dspboot ? ", with dsp registers" : ""); }
+
+	// echoclear = 0 : Clear echo region with 0's if enable in DSP_FLG
+	// echoclear = 1 : Clear echo region with 0's, regardless of DSP_FLG
+	// echoclear = 2 : Dont touch echo region
+#ifndef NO_ECHOCLEAR_STUFF
+	if (	(bootptr != img->echoregion) &&
+		(echoclear == 1 || (echoclear == 0 &&
+			(boot[BOOT_DSP_FLG] & DSP_FLG_ECEN) == 0)) )
+	{
+		i = img->echosize + 1;
+		if (img->echoregion + i > 65536) {
+			i = 65536 - img->echoregion;
+		}
+		memset(&spcdata[img->echoregion], 0, i);
+	}
+#endif
+
+	/* Copy our bootcode into the area we found */
+	if (img->dspboot) {
+		i = bootptr + sizeof(dsprestore) + sizeof(bootcode);
+		restore[DSPRESTORE_IMAGE_L] = i & 0xff;
+		restore[DSPRESTORE_IMAGE_H] = i >> 8;
+		memcpy(&spcdata[bootptr], restore, sizeof(restore));
+		memcpy(&spcdata[bootptr + sizeof(restore)], boot, sizeof(boot));
+		memcpy(&spcdata[i], dspdata, 128);
+	}
+	else {
+		memcpy(&spcdata[bootptr], boot, sizeof(boot));
+	}
+	return 0;
+}
+
+int spcimage_read(spcimage *img, FILE *fptr)
+{
+	unsigned char *spc;
+	size_t len;
+	int res;
+
+	spc = malloc(SPCIMAGE_FILE_LEN);
+	if (spc == NULL) {
+		perror("malloc");
+		return -1;
+	}
+	fseek(fptr, 0, SEEK_SET);
+	len = fread(spc, 1, SPCIMAGE_FILE_LEN, fptr);
+	res = spcimage_prepare(img, spc, len);
+	free(spc);
+	return res;
+}
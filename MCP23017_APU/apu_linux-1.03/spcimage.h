@@ -0,0 +1,66 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _spcimage_h__
+#define _spcimage_h__
+
+/* A .spc file turned into what LoadAPU_image sends: the bootcode is
+ * placed and patched, pc and psw pushed on the stack and the dsp
+ * muted. Building one takes a single pass over the ram. */
+typedef struct {
+	/* 0xffc0-0xffff hold the ram under the rom. 0xf0-0xff are
+	 * restored by the bootcode, not sent. */
+	unsigned char ram[65536];
+	/* with KON and FLG muted */
+	unsigned char dsp[128];
+	int bootptr;
+	/* the boot area starts with dsprestore.h and ends with the dsp
+	 * registers, otherwise it is the bootcode alone */
+	int dspboot;
+	int echoregion, echosize;
+} spcimage;
+
+/* Boot area search over ram bytes seen in address order: the highest
+ * run of 'size' identical bytes, a run of a higher byte value winning.
+ * Bytes passed as not usable (echo region, rom area) end a run. */
+typedef struct {
+	int size;
+	int best[256];
+	int value, count;
+} spcarea;
+
+void spcarea_init(spcarea *a, int size);
+void spcarea_add(spcarea *a, int ptr, unsigned char byte, int usable);
+
+/* returns the start of the area, -1 if there is none */
+int spcarea_pick(const spcarea *a);
+
+/* bytes of a .spc file up to the end of the ram under the rom */
+#define SPCIMAGE_FILE_LEN	0x10200
+
+/* Build the image from the .spc file in spc[0..len-1]. Missing bytes
+ * of short files are taken as 0.
+ *
+ * returns -1 if there is no room for the bootcode, 0 otherwise */
+int spcimage_prepare(spcimage *img, const unsigned char *spc, size_t len);
+
+/* the same from an open file.
+ *
+ * returns -1 on error, 0 otherwise */
+int spcimage_read(spcimage *img, FILE *fptr);
+
+#endif // _spcimage_h__
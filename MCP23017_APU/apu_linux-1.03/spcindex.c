@@ -0,0 +1,363 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spcindex.h"
+
+/* check every table lies inside the file before trusting it. The
+ * sizes are divided rather than multiplied, a damaged count times the
+ * entry size can wrap on 32 bits. */
+static int checkIndex(spcindex *idx)
+{
+	const spcindex_header *hdr = idx->map;
+	int i;
+
+	if (memcmp(hdr->magic, SPCINDEX_MAGIC, sizeof(hdr->magic)) ||
+			hdr->entries > idx->map_len ||
+			hdr->count > (idx->map_len - hdr->entries) / sizeof(spcindex_entry) ||
+			hdr->strings > idx->map_len ||
+			hdr->strings_len == 0 ||
+			hdr->strings_len > idx->map_len - hdr->strings) {
+		return -1;
+	}
+	for (i=0; i<SPCINDEX_KEYS; i++) {
+		if (hdr->sorted[i] > idx->map_len ||
+				hdr->count > (idx->map_len - hdr->sorted[i]) / sizeof(uint32_t)) {
+			return -1;
+		}
+		idx->sorted[i] = (const uint32_t*)((const char*)idx->map + hdr->sorted[i]);
+	}
+
+	idx->count = hdr->count;
+	idx->entries = (const spcindex_entry*)((const char*)idx->map + hdr->entries);
+	idx->strings = (const char*)idx->map + hdr->strings;
+	idx->strings_len = hdr->strings_len;
+
+	/* so that spcindex_string() never runs off the end */
+	if (idx->strings[idx->strings_len - 1] != 0) {
+		return -1;
+	}
+	return 0;
+}
+
+int spcindex_open(spcindex *idx, const char *path)
+{
+	struct stat st;
+	int fd;
+
+	memset(idx, 0, sizeof(spcindex));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(spcindex_header)) {
+		fprintf(stderr, "%s: not an index\n", path);
+		close(fd);
+		return -1;
+	}
+	idx->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (idx->map == MAP_FAILED) {
+		perror("mmap");
+		idx->map = NULL;
+		return -1;
+	}
+	idx->map_len = st.st_size;
+
+	if (checkIndex(idx) < 0) {
+		fprintf(stderr, "%s: damaged or not an index\n", path);
+		spcindex_close(idx);
+		return -1;
+	}
+	return 0;
+}
+
+void spcindex_close(spcindex *idx)
+{
+	if (idx->map) {
+		munmap(idx->map, idx->map_len);
+	}
+	memset(idx, 0, sizeof(spcindex));
+}
+
+const char *spcindex_string(const spcindex *idx, uint32_t offset)
+{
+	if (offset >= idx->strings_len) {
+		return "";
+	}
+	return idx->strings + offset;
+}
+
+static const char *keyAt(const spcindex *idx, int key, uint32_t pos)
+{
+	uint32_t entry = idx->sorted[key][pos];
+
+	if (entry >= idx->count) {
+		return "";
+	}
+	return spcindex_string(idx, idx->entries[entry].key[key]);
+}
+
+int spcindex_find(const spcindex *idx, int key, const char *prefix, uint32_t *first)
+{
+	size_t len = strlen(prefix);
+	uint32_t lo, hi, mid, start;
+
+	if (key < 0 || key >= SPCINDEX_KEYS) {
+		return 0;
+	}
+
+	/* the first key not below the prefix */
+	lo = 0;
+	hi = idx->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strcasecmp(keyAt(idx, key, mid), prefix) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	start = lo;
+
+	/* then the first one past the keys starting with it */
+	hi = idx->count;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strncasecmp(keyAt(idx, key, mid), prefix, len) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	*first = start;
+	return lo - start;
+}
+
+const spcindex_entry *spcindex_sorted(const spcindex *idx, int key, uint32_t pos)
+{
+	uint32_t entry;
+
+	if (key < 0 || key >= SPCINDEX_KEYS || pos >= idx->count) {
+		return NULL;
+	}
+	entry = idx->sorted[key][pos];
+	if (entry >= idx->count) {
+		return NULL;
+	}
+	return &idx->entries[entry];
+}
+
+/* qsort() has no context argument */
+static const spcindex_record *sort_records;
+static int sort_key;
+
+static const char *recordKey(const spcindex_record *r, int key)
+{
+	return r->key[key] ? r->key[key] : "";
+}
+
+static int compareRecords(const void *a, const void *b)
+{
+	uint32_t ia = *(const uint32_t*)a, ib = *(const uint32_t*)b;
+	int res;
+
+	res = strcasecmp(recordKey(&sort_records[ia], sort_key),
+			recordKey(&sort_records[ib], sort_key));
+	if (res == 0) {
+		res = ia < ib ? -1 : ia > ib;
+	}
+	return res;
+}
+
+/* Append s to the pool. The empty string is always at offset 0. */
+static uint32_t addString(char **pool, size_t *len, size_t *size, const char *s)
+{
+	size_t n = s ? strlen(s) : 0;
+	uint32_t offset;
+	char *grown;
+
+	if (n == 0) {
+		return 0;
+	}
+	if (*len + n + 1 > *size) {
+		*size = (*len + n + 1) * 2;
+		grown = realloc(*pool, *size);
+		if (grown == NULL) {
+			perror("realloc");
+			return (uint32_t)-1;
+		}
+		*pool = grown;
+	}
+	offset = *len;
+	memcpy(*pool + *len, s, n + 1);
+	*len += n + 1;
+	return offset;
+}
+
+static int writeTables(FILE *fptr, const spcindex_header *hdr,
+		const spcindex_entry *entries, uint32_t **sorted, const char *pool)
+{
+	int k;
+
+	if (fwrite(hdr, sizeof(spcindex_header), 1, fptr) != 1 ||
+			fwrite(entries, sizeof(spcindex_entry), hdr->count, fptr) != hdr->count) {
+		return -1;
+	}
+	for (k=0; k<SPCINDEX_KEYS; k++) {
+		if (fwrite(sorted[k], sizeof(uint32_t), hdr->count, fptr) != hdr->count) {
+			return -1;
+		}
+	}
+	if (fwrite(pool, 1, hdr->strings_len, fptr) != hdr->strings_len) {
+		return -1;
+	}
+	return 0;
+}
+
+static int writeFile(const char *path, const spcindex_header *hdr,
+		const spcindex_entry *entries, uint32_t **sorted, const char *pool)
+{
+	char *tmpname;
+	FILE *fptr;
+	int res;
+
+	tmpname = malloc(strlen(path) + 5);
+	if (tmpname == NULL) {
+		perror("malloc");
+		return -1;
+	}
+	sprintf(tmpname, "%s.tmp", path);
+
+	fptr = fopen(tmpname, "wb");
+	if (fptr == NULL) {
+		perror(tmpname);
+		free(tmpname);
+		return -1;
+	}
+	res = writeTables(fptr, hdr, entries, sorted, pool);
+	if (fclose(fptr) != 0) {
+		res = -1;
+	}
+	if (res < 0) {
+		perror(tmpname);
+	}
+	else if (rename(tmpname, path) < 0) {
+		perror("rename");
+		res = -1;
+	}
+	if (res < 0) {
+		unlink(tmpname);
+	}
+
+	free(tmpname);
+	return res;
+}
+
+static int fillEntries(spcindex_entry *entries, const spcindex_record *records,
+		int count, char **pool, size_t *pool_len)
+{
+	size_t pool_size = 1;
+	int i, k;
+
+	for (i=0; i<count; i++)
+	{
+		entries[i].path = addString(pool, pool_len, &pool_size, records[i].path);
+		if (entries[i].path == (uint32_t)-1) { return -1; }
+		for (k=0; k<SPCINDEX_KEYS; k++) {
+			entries[i].key[k] = addString(pool, pool_len, &pool_size,
+					records[i].key[k]);
+			if (entries[i].key[k] == (uint32_t)-1) { return -1; }
+		}
+		entries[i].duration_ms = records[i].duration_ms;
+		entries[i].flags = records[i].flags;
+	}
+	if (*pool_len > 0xffffffffu) {
+		fprintf(stderr, "Too many strings for one index\n");
+		return -1;
+	}
+	return 0;
+}
+
+int spcindex_write(const char *path, const spcindex_record *records, int count)
+{
+	spcindex_header hdr;
+	spcindex_entry *entries;
+	uint32_t *sorted[SPCINDEX_KEYS] = { NULL };
+	char *pool;
+	size_t pool_len = 1;
+	int i, k, res;
+
+	entries = calloc(count ? count : 1, sizeof(spcindex_entry));
+	pool = calloc(1, 1);
+	res = (entries == NULL || pool == NULL) ? -1 : 0;
+	for (k=0; k<SPCINDEX_KEYS; k++) {
+		sorted[k] = malloc((count ? count : 1) * sizeof(uint32_t));
+		if (sorted[k] == NULL) { res = -1; }
+	}
+	if (res < 0) {
+		perror("malloc");
+	}
+
+	if (res == 0) {
+		res = fillEntries(entries, records, count, &pool, &pool_len);
+	}
+
+	if (res == 0)
+	{
+		sort_records = records;
+		for (k=0; k<SPCINDEX_KEYS; k++)
+		{
+			for (i=0; i<count; i++) {
+				sorted[k][i] = i;
+			}
+			sort_key = k;
+			qsort(sorted[k], count, sizeof(uint32_t), compareRecords);
+		}
+
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, SPCINDEX_MAGIC, sizeof(hdr.magic));
+		hdr.count = count;
+		hdr.entries = sizeof(hdr);
+		hdr.sorted[0] = hdr.entries + count * sizeof(spcindex_entry);
+		for (k=1; k<SPCINDEX_KEYS; k++) {
+			hdr.sorted[k] = hdr.sorted[k-1] + count * sizeof(uint32_t);
+		}
+		hdr.strings = hdr.sorted[SPCINDEX_KEYS-1] + count * sizeof(uint32_t);
+		hdr.strings_len = pool_len;
+
+		res = writeFile(path, &hdr, entries, sorted, pool);
+	}
+
+	for (k=0; k<SPCINDEX_KEYS; k++) {
+		free(sorted[k]);
+	}
+	free(pool);
+	free(entries);
+	return res;
+}
+
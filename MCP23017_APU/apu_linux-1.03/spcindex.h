@@ -0,0 +1,105 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _spcindex_h__
+#define _spcindex_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A library index, written once by tools/spcindex and mapped
+ * read-only by players. Everything is in host byte order:
+ *
+ *   spcindex_header
+ *   spcindex_entry[count]
+ *   uint32_t[count] per key, entry numbers sorted by that key
+ *   the strings, nul terminated, addressed by offset
+ *
+ * The sorted tables make a prefix lookup a binary search. Keys
+ * compare like strcasecmp(). */
+
+#define SPCINDEX_MAGIC		"SPCIDX1"
+
+/* the keys that can be searched */
+#define SPCINDEX_TITLE		0
+#define SPCINDEX_GAME		1
+#define SPCINDEX_ARTIST		2
+#define SPCINDEX_KEYS		3
+
+/* spcindex_entry flags */
+#define SPCINDEX_TAGGED		0x01
+#define SPCINDEX_BINARY		0x02	/* binary ID666 */
+#define SPCINDEX_XID6		0x04
+
+typedef struct {
+	char magic[8];
+	uint32_t count;
+	uint32_t entries;	/* file offsets */
+	uint32_t sorted[SPCINDEX_KEYS];
+	uint32_t strings;
+	uint32_t strings_len;
+} spcindex_header;
+
+typedef struct {
+	uint32_t path;		/* string offsets */
+	uint32_t key[SPCINDEX_KEYS];
+	uint32_t duration_ms;	/* fade included, 0 when unknown */
+	uint32_t flags;
+} spcindex_entry;
+
+typedef struct {
+	void *map;
+	size_t map_len;
+	uint32_t count;
+	const spcindex_entry *entries;
+	const uint32_t *sorted[SPCINDEX_KEYS];
+	const char *strings;
+	uint32_t strings_len;
+} spcindex;
+
+/* What the scanner collected about one file, for spcindex_write() */
+typedef struct {
+	char *path;
+	char *key[SPCINDEX_KEYS];
+	unsigned int duration_ms;
+	unsigned int flags;
+} spcindex_record;
+
+/* returns -1 on error, 0 otherwise */
+int spcindex_open(spcindex *idx, const char *path);
+void spcindex_close(spcindex *idx);
+
+/* the string at an offset from an entry */
+const char *spcindex_string(const spcindex *idx, uint32_t offset);
+
+/* The entries whose key starts with prefix, ignoring case. They are
+ * spcindex_sorted(idx, key, *first) and the following ones.
+ *
+ * returns the number of matches */
+int spcindex_find(const spcindex *idx, int key, const char *prefix, uint32_t *first);
+
+/* the entry at position pos in key order */
+const spcindex_entry *spcindex_sorted(const spcindex *idx, int key, uint32_t pos);
+
+/* Build an index from count records. The file is written under a
+ * temporary name and renamed, so a player mapping the old one is
+ * not disturbed.
+ *
+ * returns -1 on error, 0 otherwise */
+int spcindex_write(const char *path, const spcindex_record *records, int count);
+
+#endif // _spcindex_h__
@@ -0,0 +1,146 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "spcpack.h"
+
+/* Greedy matching over hash chains. The whole 64k is the window, the
+ * chains are cut short instead: spc ram is mostly zeros, samples and a
+ * few repeated tables, and looking further hardly changes the size. */
+#define HASH_BITS	14
+#define MAX_CHAIN	128
+
+/* a copy costs 3 bytes, a run 2 */
+#define MIN_COPY	4
+#define MIN_RUN		3
+
+static int hash3(const unsigned char *p)
+{
+	unsigned int v = (p[0] << 16) | (p[1] << 8) | p[2];
+
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void insert(const unsigned char *src, int len, int pos, int *head, int *prev)
+{
+	int h;
+
+	if (pos + 3 > len)
+		return;
+	h = hash3(&src[pos]);
+	prev[pos] = head[h];
+	head[h] = pos;
+}
+
+static int flushLiterals(const unsigned char *lit, int count, unsigned char *dst)
+{
+	int out = 0, n;
+
+	while (count) {
+		n = count > SPCPACK_MAX_LITERAL ? SPCPACK_MAX_LITERAL : count;
+		dst[out++] = SPCPACK_LITERAL | (n - 1);
+		while (n--) {
+			dst[out++] = *lit++;
+			count--;
+		}
+	}
+	return out;
+}
+
+int spcpack_compress(const unsigned char *src, int len, unsigned char *dst, int copy_end)
+{
+	int *head, *prev;
+	int i, j, out = 0, lit = 0;
+	int max, run, best, best_pos, cand, chain, n;
+
+	head = malloc(sizeof(int) << HASH_BITS);
+	prev = malloc(sizeof(int) * len);
+	if (head == NULL || prev == NULL) {
+		free(head);
+		free(prev);
+		return -1;
+	}
+	for (i=0; i < (1 << HASH_BITS); i++) {
+		head[i] = -1;
+	}
+
+	for (i=0; i<len; )
+	{
+		max = len - i < SPCPACK_MAX_REPEAT ? len - i : SPCPACK_MAX_REPEAT;
+
+		for (run=1; run<max && src[i+run] == src[i]; run++)
+			;
+
+		best = 0;
+		best_pos = 0;
+		if (max >= MIN_COPY) {
+			cand = head[hash3(&src[i])];
+			for (chain=0; cand >= 0 && chain < MAX_CHAIN && best < max; chain++, cand = prev[cand])
+			{
+				n = copy_end - cand < max ? copy_end - cand : max;
+				for (j=0; j<n && src[cand+j] == src[i+j]; j++)
+					;
+				if (j > best) {
+					best = j;
+					best_pos = cand;
+				}
+			}
+		}
+
+		if (run >= MIN_RUN && run >= best) {
+			out += flushLiterals(&src[lit], i - lit, &dst[out]);
+			dst[out++] = SPCPACK_RUN | (run - 3);
+			dst[out++] = src[i];
+			n = run;
+		}
+		else if (best >= MIN_COPY) {
+			out += flushLiterals(&src[lit], i - lit, &dst[out]);
+			dst[out++] = SPCPACK_COPY | (best - 3);
+			dst[out++] = (i - best_pos) & 0xff;
+			dst[out++] = (i - best_pos) >> 8;
+			n = best;
+		}
+		else {
+			/* stays a literal, written with the next command */
+			insert(src, len, i++, head, prev);
+			continue;
+		}
+
+		/* positions inside runs and copies go into the chains too */
+		while (n--) {
+			insert(src, len, i++, head, prev);
+		}
+		lit = i;
+	}
+	out += flushLiterals(&src[lit], i - lit, &dst[out]);
+
+	free(head);
+	free(prev);
+	return out;
+}
+
+unsigned short spcpack_sum(const unsigned char *data, int len)
+{
+	unsigned short sum = 0;
+	int i;
+
+	for (i=0; i<len; i++) {
+		sum += data[i];
+	}
+	return sum;
+}
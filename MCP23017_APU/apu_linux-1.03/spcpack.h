@@ -0,0 +1,52 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _spcpack_h__
+#define _spcpack_h__
+
+/* Stream format expanded on the spc700 by lzloader.h. Every command
+ * starts with a control byte c:
+ *
+ *   00-7f  c+1 literal bytes follow
+ *   80-bf  (c & 3f) + 3 times the byte that follows
+ *   c0-ff  (c & 3f) + 3 bytes copied from 'distance' bytes back, the
+ *          distance follows, lsb first. Source and destination may
+ *          overlap.
+ *
+ * The stream has no end marker, the loader stops once it has written
+ * the whole range. */
+#define SPCPACK_LITERAL		0x00
+#define SPCPACK_RUN		0x80
+#define SPCPACK_COPY		0xc0
+
+#define SPCPACK_MAX_LITERAL	128
+#define SPCPACK_MAX_REPEAT	66	/* runs and copies */
+
+/* worst case stream length for len bytes of input */
+#define SPCPACK_BOUND(len)	((len) + ((len) + SPCPACK_MAX_LITERAL - 1) / SPCPACK_MAX_LITERAL)
+
+/* Compresses src[0..len-1] into dst, which must hold SPCPACK_BOUND(len)
+ * bytes. Copies only read from src[0..copy_end-1], for a region that
+ * does not read back what was written to it.
+ *
+ * returns the stream length or -1 if out of memory */
+int spcpack_compress(const unsigned char *src, int len, unsigned char *dst, int copy_end);
+
+/* the 16 bit sum lzloader.h reports for the same bytes */
+unsigned short spcpack_sum(const unsigned char *data, int len);
+
+#endif // _spcpack_h__
@@ -0,0 +1,216 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+#include "spczip.h"
+
+#define SIG_LOCAL	0x04034b50
+#define SIG_CENTRAL	0x02014b50
+#define SIG_END		0x06054b50
+
+/* end of central directory record, without the comment */
+#define END_LEN		22
+#define CENTRAL_LEN	46
+#define LOCAL_LEN	30
+
+#define METHOD_STORED	0
+#define METHOD_DEFLATED	8
+
+static unsigned int get16(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned long get32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+int spczip_open(spczip *z, const unsigned char *data, size_t len)
+{
+	const unsigned char *end = NULL;
+	unsigned long offset, size;
+	size_t i;
+
+	if (len < END_LEN) {
+		return -1;
+	}
+	/* the record is followed by a comment of up to 64k */
+	for (i = len - END_LEN; ; i--) {
+		if (get32(&data[i]) == SIG_END) {
+			end = &data[i];
+			break;
+		}
+		if (i == 0 || len - i > END_LEN + 0xffff) {
+			return -1;
+		}
+	}
+
+	/* compared by subtraction, sums of damaged fields can wrap on 32 bits */
+	offset = get32(&end[16]);
+	size = get32(&end[12]);
+	if (offset > (size_t)(end - data) || size > (size_t)(end - data) - offset) {
+		return -1;
+	}
+	z->data = data;
+	z->len = len;
+	z->cdir = &data[offset];
+	z->entries = get16(&end[10]);
+	return 0;
+}
+
+static int isSpc(const unsigned char *entry)
+{
+	unsigned int n = get16(&entry[28]);
+
+	return n > 4 && strncasecmp((const char*)&entry[CENTRAL_LEN + n - 4], ".spc", 4) == 0;
+}
+
+/* central directory entry of .spc member 'index', NULL if none */
+static const unsigned char *findEntry(const spczip *z, int index)
+{
+	const unsigned char *p = z->cdir;
+	size_t left = z->len - (z->cdir - z->data), n;
+	int i, found = 0;
+
+	for (i=0; i<z->entries; i++)
+	{
+		if (left < CENTRAL_LEN || get32(p) != SIG_CENTRAL) {
+			return NULL;
+		}
+		/* name, extra field and comment must be in the file too */
+		n = CENTRAL_LEN + get16(&p[28]) + get16(&p[30]) + get16(&p[32]);
+		if (n > left) {
+			return NULL;
+		}
+		if (isSpc(p) && ++found == index) {
+			return p;
+		}
+		p += n;
+		left -= n;
+	}
+	return NULL;
+}
+
+int spczip_count(const spczip *z)
+{
+	int count = 0;
+
+	while (findEntry(z, count + 1)) {
+		count++;
+	}
+	return count;
+}
+
+int spczip_name(const spczip *z, int index, char *name, size_t size)
+{
+	const unsigned char *e = findEntry(z, index);
+	size_t n;
+
+	if (e == NULL || size == 0) {
+		return -1;
+	}
+	n = get16(&e[28]);
+	if (n >= size) {
+		n = size - 1;
+	}
+	memcpy(name, &e[CENTRAL_LEN], n);
+	name[n] = 0;
+	return 0;
+}
+
+unsigned char *spczip_extract(const spczip *z, int index, size_t *len)
+{
+	const unsigned char *e = findEntry(z, index), *local, *src;
+	unsigned long csize, usize, offset, header;
+	unsigned char *out;
+	z_stream strm;
+	int res;
+
+	if (e == NULL) {
+		fprintf(stderr, "No member %d in the archive\n", index);
+		return NULL;
+	}
+	csize = get32(&e[20]);
+	usize = get32(&e[24]);
+	offset = get32(&e[42]);
+
+	if (offset > z->len || z->len - offset < LOCAL_LEN || get32(&z->data[offset]) != SIG_LOCAL) {
+		fprintf(stderr, "Bad zip member %d\n", index);
+		return NULL;
+	}
+	local = &z->data[offset];
+	header = LOCAL_LEN + get16(&local[26]) + get16(&local[28]);
+	if (header > z->len - offset || csize > z->len - offset - header) {
+		fprintf(stderr, "Truncated zip member %d\n", index);
+		return NULL;
+	}
+	src = local + header;
+
+	out = malloc(usize ? usize : 1);
+	if (out == NULL) {
+		perror("malloc");
+		return NULL;
+	}
+
+	switch (get16(&e[10]))
+	{
+		case METHOD_STORED:
+			if (csize != usize) {
+				res = Z_DATA_ERROR;
+				break;
+			}
+			memcpy(out, src, usize);
+			res = Z_STREAM_END;
+			break;
+
+		case METHOD_DEFLATED:
+			memset(&strm, 0, sizeof(strm));
+			/* raw deflate, no zlib header */
+			if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+				res = Z_MEM_ERROR;
+				break;
+			}
+			strm.next_in = (unsigned char*)src;
+			strm.avail_in = csize;
+			strm.next_out = out;
+			strm.avail_out = usize;
+			res = inflate(&strm, Z_FINISH);
+			if (strm.total_out != usize) {
+				res = Z_DATA_ERROR;
+			}
+			inflateEnd(&strm);
+			break;
+
+		default:
+			fprintf(stderr, "Zip member %d: unsupported method %d\n", index, get16(&e[10]));
+			free(out);
+			return NULL;
+	}
+
+	if (res != Z_STREAM_END || crc32(crc32(0, NULL, 0), out, usize) != get32(&e[16])) {
+		fprintf(stderr, "Zip member %d is damaged\n", index);
+		free(out);
+		return NULL;
+	}
+	*len = usize;
+	return out;
+}
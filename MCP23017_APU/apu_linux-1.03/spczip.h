@@ -0,0 +1,49 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifndef _spczip_h__
+#define _spczip_h__
+
+#include <stddef.h>
+
+/* Read-only access to the .spc members of a zip archive held in
+ * memory, usually a mapped file. Members are numbered from 1 in the
+ * order of the central directory; other members (info files,
+ * directories) are skipped. Stored and deflated members are supported,
+ * zip64 is not. */
+typedef struct {
+	const unsigned char *data;
+	size_t len;
+	const unsigned char *cdir;	/* first central directory entry */
+	int entries;			/* all of them, not only .spc */
+} spczip;
+
+/* returns 0 if data[0..len-1] is a zip archive, -1 otherwise */
+int spczip_open(spczip *z, const unsigned char *data, size_t len);
+
+/* number of .spc members */
+int spczip_count(const spczip *z);
+
+/* Copy the name of member 'index' into name (at most size bytes,
+ * always terminated). Returns -1 if there is no such member. */
+int spczip_name(const spczip *z, int index, char *name, size_t size);
+
+/* Uncompress member 'index' into a malloc'ed buffer, checking its crc.
+ * Returns the buffer and its length in *len, NULL on error. */
+unsigned char *spczip_extract(const spczip *z, int index, size_t *len);
+
+#endif // _spczip_h__
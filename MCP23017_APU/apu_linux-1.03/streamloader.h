@@ -0,0 +1,69 @@
+/* code loaded at 0x02. Receives 0x100-0xffff in blocks, without a
+ * handshake per byte: it takes three bytes from ports 1-3 whenever port
+ * 0 changes, and the host keeps to its pace. Each block ends with a
+ * checkpoint that reports sums of the block (see STREAMcode.asm). */
+static unsigned char streamloader[108] = {
+	0xcd, 0x00,		// start: MOV X, #00	; last port 0 value seen
+	0x3e, 0xf4,		// cal: CMP X, f4	; the rom left it non zero
+	0xd0, 0xfc,		// BNE cal
+	0x8f, 0x08, 0xe0,	// MOV e0, #08	; 12342 cycles
+	0x8d, 0x00,		// outer: MOV Y, #00
+	0xfe, 0xfe,		// inner: DBNZ Y, inner
+	0x6e, 0xe0, 0xf9,	// DBNZ e0, outer
+	0xd8, 0xf4,		// MOV f4, X	; the host times this
+	0x3e, 0xf4,		// block: CMP X, f4	; wait for port 0 to change
+	0xf0, 0xfc,		// BEQ block
+	0xf8, 0xf4,		// MOV X, f4
+	0xe4, 0xf7,		// MOV A, f7	; header: address, command
+	0xd0, 0x4d,		// BNE done
+	0xfa, 0xf5, 0x00,	// MOV 00, f5
+	0xfa, 0xf6, 0x01,	// MOV 01, f6
+	0x8d, 0x00,		// MOV Y, #00
+	0x8f, 0x00, 0xe2,	// MOV e2, #00	; running sums
+	0x8f, 0x00, 0xe3,	// MOV e3, #00
+	0x8f, 0x40, 0xe4,	// MOV e4, #40	; 64 data triples follow
+	0x3e, 0xf4,		// data: CMP X, f4
+	0xf0, 0xfc,		// BEQ data
+	0xf8, 0xf4,		// MOV X, f4
+	0x60,			// CLRC
+	0xe4, 0xf5,		// MOV A, f5
+	0xd7, 0x00,		// MOV [00]+Y, A
+	0xfc,			// INC Y
+	0x84, 0xe2,		// ADC A, e2
+	0xc4, 0xe2,		// MOV e2, A
+	0x84, 0xe3,		// ADC A, e3
+	0xc4, 0xe3,		// MOV e3, A
+	0xe4, 0xf6,		// MOV A, f6
+	0xd7, 0x00,		// MOV [00]+Y, A
+	0xfc,			// INC Y
+	0x84, 0xe2,		// ADC A, e2
+	0xc4, 0xe2,		// MOV e2, A
+	0x84, 0xe3,		// ADC A, e3
+	0xc4, 0xe3,		// MOV e3, A
+	0xe4, 0xf7,		// MOV A, f7
+	0xd7, 0x00,		// MOV [00]+Y, A
+	0xfc,			// INC Y
+	0x84, 0xe2,		// ADC A, e2
+	0xc4, 0xe2,		// MOV e2, A
+	0x84, 0xe3,		// ADC A, e3
+	0xc4, 0xe3,		// MOV e3, A
+	0x8b, 0xe4,		// DEC e4
+	0xd0, 0xce,		// BNE data
+	0xfa, 0xe2, 0xf5,	// MOV f5, e2	; checkpoint: sums on ports
+	0xfa, 0xe3, 0xf6,	// MOV f6, e3	; 1 and 2, then echo port 0
+	0xd8, 0xf4,		// MOV f4, X
+	0x2f, 0xa9,		// BRA block
+	0x5f, 0xc9, 0xff	// done: JMP ffc9	; back into the rom
+};
+
+/* a header and 64 data triples per block, 340 of them for 0x100-0xffff */
+#define STREAMLOADER_BLOCK	192
+#define STREAMLOADER_START	0x0100
+
+/* length of the timed delay, and the longest path from a port 0 change
+ * back to polling it, both in spc700 cycles */
+#define STREAMLOADER_CAL_CYCLES		12342
+#define STREAMLOADER_TRIPLE_CYCLES	103
+
+/* sending a block again, then giving up */
+#define STREAMLOADER_RETRIES	3
@@ -0,0 +1,413 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../apu.h"
+#include "../apuplay.h"
+#include "../apu_ppio.h"
+#include "../apu_ppdev.h"
+#include "../apu_mcp23x17.h"
+#include "../apu_sim.h"
+
+/* Time the bus layer of a backend: single port writes and reads,
+ * handshaked bytes through the IPL rom and whole uploads. Each
+ * operation is timed on its own, the report gives ops/s and the
+ * latency percentiles. Thresholds (-t) turn it into a regression check:
+ * the exit status is 1 when a benchmark is below its minimum. A
+ * benchmark that errors out fails the run too, threshold or not. */
+
+int g_verbose = 0;
+int g_debug = 0;
+int g_progress = 0;
+int g_exit_now = 0;
+int g_playing = 1;
+int g_upload_mode = UPLOAD_FAST;
+int g_verify = 0;
+
+#define BENCH_WRITE	0
+#define BENCH_READ	1
+#define BENCH_HANDSHAKE	2
+#define BENCH_LOAD	3
+#define BENCHES		4
+
+static const char *bench_names[BENCHES] = {
+	"write", "read", "handshake", "load"
+};
+
+typedef struct {
+	int ran;
+	int error;	/* it was started and failed */
+	int count;
+	uint64_t total_ns;
+	uint64_t p50, p90, p99, max;
+	double min_ops;		/* -t, 0 for none */
+} bench_result;
+
+static bench_result results[BENCHES];
+
+/* The apu layer alone: the ports read back what was last written to
+ * them, and $AA $BB after a reset as the IPL rom would show. That is
+ * enough for the handshakes, apu_initTransfer included, but there is
+ * no spc700 to run the loaders, so uploads cannot be timed with it.
+ * apu_sim.h is the simulated apu that can. */
+static unsigned char echo_ports[4];
+
+static unsigned char echo_read(int address)
+{
+	return echo_ports[address & 3];
+}
+
+static void echo_write(int address, unsigned char data)
+{
+	echo_ports[address & 3] = data;
+}
+
+static void echo_reset(void)
+{
+	memset(echo_ports, 0, sizeof(echo_ports));
+	echo_ports[0] = 0xaa;
+	echo_ports[1] = 0xbb;
+}
+
+static int echo_init(char *cmdline)
+{
+	echo_reset();
+	return 0;
+}
+
+static void echo_shutdown(void)
+{
+}
+
+static APU_ops echo_ops = {
+	echo_read,
+	echo_write,
+	echo_reset,
+	echo_init,
+	echo_shutdown,
+	NULL,
+	NULL
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int cmpSamples(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void finish(int bench, uint64_t *samples, int count, uint64_t total_ns)
+{
+	bench_result *r = &results[bench];
+
+	qsort(samples, count, sizeof(uint64_t), cmpSamples);
+	r->ran = 1;
+	r->count = count;
+	r->total_ns = total_ns;
+	r->p50 = samples[count * 50 / 100];
+	r->p90 = samples[count * 90 / 100];
+	r->p99 = samples[count * 99 / 100];
+	r->max = samples[count - 1];
+}
+
+static void benchPorts(uint64_t *samples, int count)
+{
+	uint64_t start, t;
+	int i;
+
+	start = now_ns();
+	for (i=0; i<count; i++) {
+		t = now_ns();
+		apu_write(1, i);
+		samples[i] = now_ns() - t;
+	}
+	finish(BENCH_WRITE, samples, count, now_ns() - start);
+
+	start = now_ns();
+	for (i=0; i<count; i++) {
+		t = now_ns();
+		apu_read(i & 3);
+		samples[i] = now_ns() - t;
+	}
+	finish(BENCH_READ, samples, count, now_ns() - start);
+}
+
+/* bytes to 0x0200 and up through the IPL rom, the way the zero page
+ * and the loaders are sent */
+static int benchHandshake(uint64_t *samples, int count)
+{
+	uint64_t start, t;
+	int i, n;
+
+	if (apu_resetIPL() < 0) {
+		fprintf(stderr, "The apu does not answer after a reset\n");
+		return -1;
+	}
+	if (apu_initTransfer(0x0200) < 0) {
+		fprintf(stderr, "apu_initTransfer failed\n");
+		return -1;
+	}
+
+	/* stay below the rom */
+	n = count < 0xfdc0 ? count : 0xfdc0;
+	start = now_ns();
+	for (i=0; i<n; i++) {
+		t = now_ns();
+		if (apu_writeHandshake(1, i & 0xff)) {
+			fprintf(stderr, "Handshake timeout after %d bytes\n", i);
+			return -1;
+		}
+		samples[i] = now_ns() - t;
+	}
+	finish(BENCH_HANDSHAKE, samples, n, now_ns() - start);
+	apu_reset();
+	return 0;
+}
+
+static int benchLoad(uint64_t *samples, const char *filename, int count)
+{
+	uint64_t start, t;
+	FILE *fptr;
+	int i;
+
+	fptr = fopen(filename, "rb");
+	if (fptr == NULL) {
+		perror(filename);
+		return -1;
+	}
+
+	start = now_ns();
+	for (i=0; i<count; i++) {
+		rewind(fptr);
+		t = now_ns();
+		if (LoadAPU(fptr) != 0) {
+			fprintf(stderr, "LoadAPU failed\n");
+			fclose(fptr);
+			return -1;
+		}
+		samples[i] = now_ns() - t;
+	}
+	finish(BENCH_LOAD, samples, count, now_ns() - start);
+	fclose(fptr);
+	apu_reset();
+	return 0;
+}
+
+static int setThreshold(char *arg)
+{
+	char *eq = strchr(arg, '=');
+	int i;
+
+	if (eq) {
+		*eq = 0;
+		for (i=0; i<BENCHES; i++) {
+			if (strcmp(arg, bench_names[i]) == 0) {
+				results[i].min_ops = atof(eq + 1);
+				return results[i].min_ops > 0 ? 0 : -1;
+			}
+		}
+	}
+	fprintf(stderr, "Bad threshold, use name=ops_per_second with name one of "
+			"write, read, handshake, load\n");
+	return -1;
+}
+
+/* returns the number of benchmarks below their threshold or failed */
+static int report(void)
+{
+	bench_result *r;
+	double ops;
+	int i, failed = 0;
+
+	printf("%-10s %8s %12s %9s %9s %9s %9s\n", "bench", "count", "ops/s",
+			"p50 us", "p90 us", "p99 us", "max us");
+	for (i=0; i<BENCHES; i++)
+	{
+		r = &results[i];
+		if (r->error) {
+			printf("%-10s error, FAIL\n", bench_names[i]);
+			failed++;
+			continue;
+		}
+		if (!r->ran) {
+			if (r->min_ops > 0) {
+				printf("%-10s not run, FAIL (minimum %.1f ops/s)\n",
+						bench_names[i], r->min_ops);
+				failed++;
+			}
+			continue;
+		}
+		ops = r->total_ns ? r->count * 1e9 / r->total_ns : 0;
+		printf("%-10s %8d %12.1f %9.2f %9.2f %9.2f %9.2f", bench_names[i],
+				r->count, ops, r->p50 / 1e3, r->p90 / 1e3, r->p99 / 1e3,
+				r->max / 1e3);
+		if (r->min_ops > 0 && ops < r->min_ops) {
+			printf("  FAIL (minimum %.1f)", r->min_ops);
+			failed++;
+		}
+		printf("\n");
+	}
+	return failed;
+}
+
+static void printhelp(void)
+{
+	printf("Usage: ./apubench [options] [spc_file]\n\n");
+	printf("Times apu_write, apu_read and apu_writeHandshake, and LoadAPU\n");
+	printf("when a file is given.\n\n");
+	printf("  -b bus   sim[:latency] (default, a simulated apu whose port\n");
+	printf("           accesses take latency us), echo (the apu layer\n");
+	printf("           alone, no uploads), spi[@addr], i2c[:dev][@addr] or\n");
+	printf("           gpio for the mcp23x17 board");
+#ifdef PPDEV_SUPPORTED
+	printf(",\n           ppdev");
+#endif
+#ifdef PPIO_SUPPORTED
+	printf(",\n           ppio");
+#endif
+	printf("\n");
+	printf("  -n n     Port writes, reads and handshakes (default 20000)\n");
+	printf("  -l n     Uploads (default 3)\n");
+	printf("  -u mode  Upload mode, as apuplay's -u (default fast)\n");
+	printf("  -t name=ops\n");
+	printf("           Fail (exit status 1) if 'name' does less than ops\n");
+	printf("           per second. Can be repeated.\n");
+	printf("           A benchmark that fails with an error also gives\n");
+	printf("           exit status 1.\n");
+	printf("  -h       Prints this info\n");
+}
+
+int main(int argc, char **argv)
+{
+	APU_ops *ops;
+	char *bus = "sim", *filename = NULL;
+	uint64_t *samples;
+	int res, count = 20000, loads = 3, failed;
+
+	while ((res = getopt(argc, argv, "hb:n:l:u:t:")) >= 0)
+	{
+		switch (res)
+		{
+			case 'b':
+				bus = optarg;
+				break;
+			case 'n':
+				count = atoi(optarg);
+				break;
+			case 'l':
+				loads = atoi(optarg);
+				break;
+			case 'u':
+				if (strcmp(optarg, "fast")==0) {
+					g_upload_mode = UPLOAD_FAST;
+				} else if (strcmp(optarg, "ipl")==0) {
+					g_upload_mode = UPLOAD_IPL;
+				} else if (strcmp(optarg, "lz")==0) {
+					g_upload_mode = UPLOAD_LZ;
+				} else if (strcmp(optarg, "stream")==0) {
+					g_upload_mode = UPLOAD_STREAM;
+				} else if (strcmp(optarg, "delta")==0) {
+					g_upload_mode = UPLOAD_DELTA;
+				} else {
+					fprintf(stderr, "Unknown upload mode '%s'. try -h\n", optarg);
+					return 2;
+				}
+				break;
+			case 't':
+				if (setThreshold(optarg) < 0) { return 2; }
+				break;
+			case 'h':
+				printhelp();
+				return 0;
+			default:
+				fprintf(stderr, "Unknown argument. try -h\n");
+				return 2;
+		}
+	}
+	if (count < 1 || loads < 1) {
+		fprintf(stderr, "Bad count\n");
+		return 2;
+	}
+	if (optind < argc) {
+		filename = argv[optind];
+	}
+
+	ops = apu_mcp23x17_getOps();
+	if (strcmp(bus, "echo") == 0) {
+		ops = &echo_ops;
+	}
+	if (strncmp(bus, "sim", 3) == 0) {
+		ops = apu_sim_getOps();
+	}
+#ifdef PPDEV_SUPPORTED
+	if (strcmp(bus, "ppdev") == 0) {
+		ops = apu_ppdev_getOps();
+	}
+#endif
+#ifdef PPIO_SUPPORTED
+	if (strcmp(bus, "ppio") == 0) {
+		ops = apu_ppio_getOps();
+	}
+#endif
+	apu_setOps(ops);
+	if (ops->init(ops == apu_mcp23x17_getOps() || ops == apu_sim_getOps() ? bus : "") < 0) {
+		return 2;
+	}
+
+	samples = malloc((count > loads ? count : loads) * sizeof(uint64_t));
+	if (samples == NULL) {
+		perror("malloc");
+		return 2;
+	}
+
+	benchPorts(samples, count);
+	if (benchHandshake(samples, count) < 0) {
+		results[BENCH_HANDSHAKE].error = 1;
+	}
+	if (filename) {
+		if (ops == &echo_ops) {
+			fprintf(stderr, "The echo backend cannot run uploads, "
+					"skipping '%s'\n", filename);
+		}
+		/* no upload can work on an apu that does not handshake */
+		else if (results[BENCH_HANDSHAKE].error ||
+				benchLoad(samples, filename, loads) < 0) {
+			results[BENCH_LOAD].error = 1;
+		}
+	}
+
+	failed = report();
+	free(samples);
+	ops->shutdown();
+
+	return failed ? 1 : 0;
+}
+
@@ -0,0 +1,291 @@
+/* hwapu - SPC music playback tools for real snes apu
+ * Copyright (C) 2004-2005  Raphael Assenat <raph@raphnet.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#define _XOPEN_SOURCE 500
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <pthread.h>
+
+#include "../id666.h"
+#include "../spcfile.h"
+#include "../spcindex.h"
+
+/* Build or search a library index. Tags are parsed by a pool of
+ * threads, each file being mapped, parsed in place and unmapped. */
+
+static char **g_paths;
+static int g_count, g_size;
+
+static spcindex_record *g_records;
+static int g_next;
+static pthread_mutex_t g_next_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void printhelp(void)
+{
+	printf("Usage: ./spcindex [-j threads] -o index dir_or_file...\n");
+	printf("       ./spcindex -f index [-t|-g|-a] prefix\n\n");
+	printf("  -o file  Scan the .spc files and zip archives given or\n");
+	printf("           found in the directories and write an index\n");
+	printf("  -j n     Threads parsing the tags (default: one per cpu)\n");
+	printf("  -f file  List the entries of an index whose title (-t,\n");
+	printf("           the default), game (-g) or artist (-a) starts\n");
+	printf("           with prefix, ignoring case\n");
+	printf("  -h       Prints this info\n");
+}
+
+static int addPath(const char *path)
+{
+	char **grown;
+
+	if (g_count == g_size) {
+		g_size = g_size ? g_size * 2 : 1024;
+		grown = realloc(g_paths, g_size * sizeof(char*));
+		if (grown == NULL) {
+			perror("realloc");
+			return -1;
+		}
+		g_paths = grown;
+	}
+	g_paths[g_count] = strdup(path);
+	if (g_paths[g_count] == NULL) {
+		perror("strdup");
+		return -1;
+	}
+	g_count++;
+	return 0;
+}
+
+static int hasSuffix(const char *path, const char *suffix)
+{
+	size_t len = strlen(path), slen = strlen(suffix);
+
+	return len >= slen && strcasecmp(path + len - slen, suffix) == 0;
+}
+
+/* zip archives add one path per .spc member */
+static int addFile(const char *path)
+{
+	char name[4096];
+	int i, members;
+
+	if (hasSuffix(path, ".zip"))
+	{
+		members = spcfile_members(path);
+		for (i=1; i<=members; i++) {
+			snprintf(name, sizeof(name), "%s#%d", path, i);
+			if (addPath(name) < 0) { return -1; }
+		}
+		return 0;
+	}
+	if (hasSuffix(path, ".spc")) {
+		return addPath(path);
+	}
+	return 0;
+}
+
+static int walkEntry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+	if (type != FTW_F) {
+		return 0;
+	}
+	return addFile(path);
+}
+
+static void scanFile(spcindex_record *r, const char *path)
+{
+	id666_tag tag;
+	spcfile f;
+
+	memset(r, 0, sizeof(spcindex_record));
+	r->path = (char*)path;
+
+	if (spcfile_open(&f, path) < 0) {
+		return;
+	}
+	if (spcfile_check(f.data, f.len) && parse_id666(f.data, f.len, &tag))
+	{
+		r->key[SPCINDEX_TITLE] = strdup(tag.title);
+		r->key[SPCINDEX_GAME] = strdup(tag.game_title);
+		r->key[SPCINDEX_ARTIST] = strdup(tag.artist);
+		r->duration_ms = id666_duration(&tag);
+		r->flags = SPCINDEX_TAGGED;
+		if (tag.binary) { r->flags |= SPCINDEX_BINARY; }
+		if (tag.has_xid6) { r->flags |= SPCINDEX_XID6; }
+	}
+	spcfile_close(&f);
+}
+
+static void *scanThread(void *arg)
+{
+	int i;
+
+	while (1)
+	{
+		pthread_mutex_lock(&g_next_lock);
+		i = g_next++;
+		pthread_mutex_unlock(&g_next_lock);
+
+		if (i >= g_count) { break; }
+		scanFile(&g_records[i], g_paths[i]);
+	}
+	return NULL;
+}
+
+static int buildIndex(const char *output, char **args, int nargs, int threads)
+{
+	pthread_t *tids;
+	struct stat st;
+	int i, k, res, tagged = 0;
+
+	for (i=0; i<nargs; i++)
+	{
+		if (stat(args[i], &st) < 0) {
+			perror(args[i]);
+			return -1;
+		}
+		if (S_ISDIR(st.st_mode)) {
+			res = nftw(args[i], walkEntry, 32, FTW_PHYS);
+		} else {
+			res = addFile(args[i]);
+		}
+		if (res < 0) { return -1; }
+	}
+
+	g_records = calloc(g_count ? g_count : 1, sizeof(spcindex_record));
+	tids = calloc(threads, sizeof(pthread_t));
+	if (g_records == NULL || tids == NULL) {
+		perror("calloc");
+		return -1;
+	}
+
+	for (i=0; i<threads; i++) {
+		if (pthread_create(&tids[i], NULL, scanThread, NULL) != 0) {
+			fprintf(stderr, "pthread_create failed\n");
+			break;
+		}
+	}
+	/* at least the calling thread works */
+	if (i == 0) {
+		scanThread(NULL);
+	}
+	while (i--) {
+		pthread_join(tids[i], NULL);
+	}
+	free(tids);
+
+	for (i=0; i<g_count; i++) {
+		if (g_records[i].flags & SPCINDEX_TAGGED) { tagged++; }
+	}
+	printf("%d files, %d tagged\n", g_count, tagged);
+
+	res = spcindex_write(output, g_records, g_count);
+
+	for (i=0; i<g_count; i++) {
+		for (k=0; k<SPCINDEX_KEYS; k++) {
+			free(g_records[i].key[k]);
+		}
+		free(g_paths[i]);
+	}
+	free(g_records);
+	free(g_paths);
+	return res;
+}
+
+static int searchIndex(const char *input, int key, const char *prefix)
+{
+	const spcindex_entry *e;
+	spcindex idx;
+	uint32_t first, i;
+	int count;
+
+	if (spcindex_open(&idx, input) < 0) {
+		return -1;
+	}
+
+	count = spcindex_find(&idx, key, prefix, &first);
+	for (i=first; i<first+count; i++)
+	{
+		e = spcindex_sorted(&idx, key, i);
+		printf("%3u:%02u  %s - %s (%s)  %s\n",
+				e->duration_ms / 60000, (e->duration_ms / 1000) % 60,
+				spcindex_string(&idx, e->key[SPCINDEX_GAME]),
+				spcindex_string(&idx, e->key[SPCINDEX_TITLE]),
+				spcindex_string(&idx, e->key[SPCINDEX_ARTIST]),
+				spcindex_string(&idx, e->path));
+	}
+
+	spcindex_close(&idx);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	char *output = NULL, *input = NULL;
+	int res, threads, key = SPCINDEX_TITLE;
+
+	threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1) { threads = 1; }
+
+	while ((res = getopt(argc, argv, "o:j:f:tgah")) >= 0)
+	{
+		switch (res)
+		{
+			case 'o':
+				output = optarg;
+				break;
+			case 'j':
+				threads = atoi(optarg);
+				if (threads < 1) {
+					fprintf(stderr, "Bad thread count\n");
+					return 1;
+				}
+				break;
+			case 'f':
+				input = optarg;
+				break;
+			case 't':
+				key = SPCINDEX_TITLE;
+				break;
+			case 'g':
+				key = SPCINDEX_GAME;
+				break;
+			case 'a':
+				key = SPCINDEX_ARTIST;
+				break;
+			case 'h':
+				printhelp();
+				return 0;
+			case '?':
+				fprintf(stderr, "Unknown argument. try -h\n");
+				return 1;
+		}
+	}
+
+	if (input) {
+		return searchIndex(input, key, optind < argc ? argv[optind] : "") < 0;
+	}
+	if (output == NULL || optind >= argc) {
+		printhelp();
+		return 1;
+	}
+	return buildIndex(output, &argv[optind], argc - optind, threads) < 0;
+}
+
@@ -0,0 +1,37 @@
+/* code loaded at 0x02. Sums the pages of the spc ram the host asks for
+ * and reports each sum on ports 1 and 2, so only damaged pages need to
+ * be sent again. Page 0 makes it go back to the IPL rom (see
+ * VERIFYcode.asm). The carry of each add is kept for the next one, see
+ * pageSum() in apuplay.c. */
+static unsigned char verifyloader[55] = {
+	0xcd, 0x00,		// start: MOV X, #00	; handshake counter
+	0x8f, 0x00, 0x00,	// MOV 00, #00	; pages start at xx00
+	0x3e, 0xf4,		// cmd: CMP X, f4
+	0xd0, 0xfc,		// BNE cmd
+	0xe4, 0xf5,		// MOV A, f5	; page, 0 to finish
+	0xf0, 0x27,		// BEQ done
+	0xc4, 0x01,		// MOV 01, A
+	0xfa, 0xf6, 0xe6,	// MOV e6, f6	; byte pairs, 1 to $80
+	0x8d, 0x00,		// MOV Y, #00
+	0xe8, 0x00,		// MOV A, #00
+	0xc4, 0xe7,		// MOV e7, A
+	0x60,			// CLRC
+	0x97, 0x00,		// sum: ADC A, [00]+Y	; the carry is not cleared,
+	0x90, 0x02,		// BCC +2	; it counts in the next add
+	0xab, 0xe7,		// INC e7
+	0xfc,			// INC Y
+	0x97, 0x00,		// ADC A, [00]+Y
+	0x90, 0x02,		// BCC +2
+	0xab, 0xe7,		// INC e7
+	0xfc,			// INC Y
+	0x6e, 0xe6, 0xef,	// DBNZ e6, sum	; keeps the flags
+	0xc4, 0xf5,		// MOV f5, A
+	0xfa, 0xe7, 0xf6,	// MOV f6, e7
+	0xd8, 0xf4,		// MOV f4, X	; sum ready
+	0x3d,			// INC X
+	0x2f, 0xd1,		// BRA cmd
+	0x5f, 0xc9, 0xff	// done: JMP ffc9	; back into the rom
+};
+
+/* passes over the damaged pages before giving up */
+#define VERIFYLOADER_PASSES	3
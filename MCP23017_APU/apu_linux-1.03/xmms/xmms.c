@@ -31,6 +31,7 @@
 #include "../apu_ppdev.h"
 
 #include "../id666.h"
+#include "../spcfile.h"
 
 
 static APU_ops *apu_ops;
@@ -62,37 +63,24 @@ static void hwapu_init(void)
 
 static int hwapu_is_our_file(char *filename)
 {
-	FILE *fptr;
-	unsigned char *magic = "SNES-SPC700 Sound File Data v0.30";
-	unsigned char tmpbuf[34];
-
-	fptr = fopen(filename, "rb");
-	if (!fptr) { return 0; }
-
-	tmpbuf[33] = 0;
-	if (!fread(tmpbuf, 33, 1, fptr)) {
-		fclose(fptr);
-		perror("fread");
-		return 0;
-	}
+	spcfile f;
+	int res;
 
-	if (strcmp(tmpbuf, magic)==0) { 
-		fclose(fptr);
-//		printf("Is our file!\n");
-		return 1; 
-	}
+	if (spcfile_open(&f, filename)<0) { return 0; }
+
+	res = spcfile_check(f.data, f.len);
+//	if (res) printf("Is our file!\n");
 	
-	fclose(fptr);
+	spcfile_close(&f);
 
-	return 0;
+	return res;
 }
 
 static void hwapu_play_file(char *filename)
 {
-	FILE *fptr;
+	spcfile f;
 	id666_tag tag;
-	int len;
-	char *s;
+	int len, res;
 
 	apu_ops = apu_ppdev_getOps();
 	apu_setOps(apu_ops);
@@ -101,33 +89,29 @@ static void hwapu_play_file(char *filename)
 		return;
 	}
 	
-	fptr = fopen(filename, "rb");
-	if (!fptr) { return; }
+	if (spcfile_open(&f, filename)<0) { return; }
 	
 //	printf("Loading %s\n", filename);
 
-	if (read_id666(fptr, &tag)) {
-		len = strtol(
-				(char*)tag.seconds_til_fadeout, 
-				&s, 
-				0);
-		if ((unsigned char*)s == tag.seconds_til_fadeout) {
+	if (parse_id666(f.data, f.len, &tag)) {
+		len = id666_duration(&tag);
+		if (len == 0) {
 			g_length = DEFAULT_LENGTH_SECONDS * 1000;
 		}
 		else {
-			g_length = len * 1000;
+			g_length = len;
 		}
 	}
 	
-	if (LoadAPU(fptr)<0) {
+	res = LoadAPU_buffer(f.data, f.len);
+	spcfile_close(&f);
+	if (res<0) {
 		fprintf(stderr, "Problem\n");
 		return;
 	}
 
 	gettimeofday(&g_playstart_tv, NULL);
 	g_playing = 1;
-	
-	fclose(fptr);
 }
 
 static void hwapu_stop(void)
@@ -164,31 +148,26 @@ static int hwapu_get_time(void)
 
 static void hwapu_get_song_info(char *filename, char **title, int *length)
 {
-	FILE *fptr;
-	char *s;
+	spcfile f;
 	int len;
 	id666_tag tag;
 
 	
-	fptr = fopen(filename, "rb");
-	if (!fptr) { return; }
+	if (spcfile_open(&f, filename)<0) { return; }
 
-	if (read_id666(fptr, &tag)) {
+	if (parse_id666(f.data, f.len, &tag)) {
 		*title = strdup(tag.title);
-		len = strtol(
-				(char*)tag.seconds_til_fadeout, 
-				&s, 
-				0);
-		if ((unsigned char*)s == tag.seconds_til_fadeout) {
+		len = id666_duration(&tag);
+		if (len == 0) {
 			*length = DEFAULT_LENGTH_SECONDS * 1000;
 		}
 		else {
-			*length = len * 1000;
+			*length = len;
 		}
 	}
 //	printf("get_song_info %s, %d\n", *title, *length);
 	
-	fclose(fptr);
+	spcfile_close(&f);
 }
 
 static void hwapu_about()
@@ -8,96 +8,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <wiringPi.h>
-#include <mcp23s17.h>
 #include <stdint.h>
 #include <math.h>
 #include <string.h>
-#include "wiringPiSPI.h"
 #include <time.h>
+#include <unistd.h>
+#include "cartbus.h"
+#include "bustrace.h"
+#include "i2cbus.h"
+#include "rt.h"
 
-#define BASE    123
-// ------------ Setup Register Definitions ------------------------------------------
-
-#define GPIO_OUT_0 4
-#define GPIO_OUT_1 3
-#define GPIO_OUT_2 2
-#define GPIO_OUT_3 1
-#define GPIO_OUT_4 0
-#define GPIO_OUT_5 7
-#define GPIO_OUT_6 9
-#define GPIO_OUT_7 8
-
-#define GPIO_DATA_DIR 14
-#define GPIO_DATA_0 29
-#define GPIO_DATA_1 28
-#define GPIO_DATA_2 25
-#define GPIO_DATA_3 27
-#define GPIO_DATA_4 26
-#define GPIO_DATA_5 11
-#define GPIO_DATA_6 6
-#define GPIO_DATA_7 5
-
-
-#define GPIO_TRIG_DATA_OUT 12
-#define GPIO_OE_DATA_OUT 13
-
-#define GPIO_TRIG_HIGH_ADDR 21
-#define GPIO_TRIG_LOW_ADDR 22
-#define GPIO_TRIG_BANK 23
-#define GPIO_TRIG_CTRL 24
-
-#define GPIO_OE_CTRL 10
-
-
-
-#define _SNESAddressPins 0x20 // MCP23017 Chip with SNES Address Pins
-#define _SNESBankAndData 0x22 // MCP23017 Chip with SNES Bank and Data
-#define _IOControls 0x23        // MCP23017 Chip to control SNES IO Controls including MOSFET Power
-
-#define IODIRA 0X00
-#define IODIRB 0X01
-#define GPIOA 0X12
-#define GPIOB 0X13
-#define GPINTENB 0x05
-#define DEFVALB 0x07
-#define INTCONB x09
-#define IOCON_B 0x0B
-#define GPPUB 0x0D
-
-/*
-# GPA0: /RD
-# GPA1: /RESET
-# GPA2: /WR
-# GPA3: /CS
-# GPA4: CART MOSFET
-# GPA7: /IRQ 
-*/	
-
-#define _RD    0b00000001
-#define _RESET 0b00000010
-#define _WR    0b00000100
-#define _CS    0b00001000
-#define _POWER 0b00010000
-
-int16_t currentBank = -1;
 uint32_t ROMchecksum = 0;
 uint32_t totalChecksum = 0;
-uint32_t LowByteWrites = 0;
-uint32_t HighByteWrites = 0;
-uint32_t BankWrites = 0;
-uint32_t DataReads = 0;
-int useSPI = 1;
-int currentDataDir = 1;
-
-
-uint8_t readData(void);
-void gotoAddr(int32_t, int);
-void gotoBank(uint8_t);
-uint8_t readAddr(int32_t, int);
-uint8_t readAddrBank(int32_t, uint8_t);
-void gotoOffset(uint32_t,int);
-uint8_t readOffset(uint32_t,int);
+
+
 uint8_t getUpNibble(uint8_t);
 uint8_t getLowNibble(uint8_t);
 int power(int, unsigned int);
@@ -106,218 +30,9 @@ int16_t getNumberOfPages(int16_t,int);
 const char * returnNULLheader(void);
 void CX4setROMsize(int16_t);
 void ripROM (uint8_t, int, int16_t, uint8_t *);
-void setIOControl(uint8_t );
-void initInterface_SPI(void);
-void shutdownInterface_SPI(void);
-void writeFlipflops(uint8_t,int);
-void changeDataDir(int direction);
 
 
 
-#define      CMD_WRITE       0x40
-#define CMD_READ     0x41
-/*
- * writeByte:
- *	Write a byte to a register on the MCP23s17 on the SPI bus.
- *********************************************************************************
- */
-
-void writeByte (uint8_t spiPort, uint8_t devId, uint8_t reg, uint8_t data)
-{
-  uint8_t spiData [4] ;
-
-  spiData [0] = CMD_WRITE | ((devId & 7) << 1) ;
-  spiData [1] = reg ;
-  spiData [2] = data ;
-
-  wiringPiSPIDataRW (spiPort, spiData, 3) ;
-}
-
-/*
- * readByte:
- *	Read a byte from a register on the MCP23s17 on the SPI bus.
- *********************************************************************************
- */
-
-uint8_t readByte (uint8_t spiPort, uint8_t devId, uint8_t reg){
-  uint8_t spiData [4] ;
-
-  spiData [0] = CMD_READ | ((devId & 7) << 1) ;
-  spiData [1] = reg ;
-
-  wiringPiSPIDataRW (spiPort, spiData, 3) ;
-
-  return spiData [2] ;
-}
-
-uint8_t readData(void){
-	DataReads++;
-	uint8_t data = 0;
-	
-	if (useSPI == 1){
-		return readByte (0, _SNESBankAndData, GPIOB); // SNESBankAndData._readRegister(GPIOB);
-	}
-	//use GPIO
-	else{
-		//delayMicroseconds(10);
-		
-		if (digitalRead (GPIO_DATA_7) )
-			data = data| 0x80;
-		delayMicroseconds(4);
-		if (digitalRead (GPIO_DATA_6) )
-			data = data| 0x40;
-		delayMicroseconds(4);
-		if (digitalRead (GPIO_DATA_5) )
-			data = data| 0x20;
-		delayMicroseconds(4);		
-		if (digitalRead (GPIO_DATA_4) )
-			data = data| 0x10;
-		delayMicroseconds(4);		
-		if (digitalRead (GPIO_DATA_3) )
-			data = data| 0x08;
-		delayMicroseconds(4);		
-		if (digitalRead (GPIO_DATA_2) )
-			data = data| 0x04;
-		delayMicroseconds(4);		
-		if (digitalRead (GPIO_DATA_1) )
-			data = data| 0x02;
-		delayMicroseconds(4);		
-		if (digitalRead (GPIO_DATA_0) )
-			data = data| 0x01;
-		delayMicroseconds(4);		
-
-		return data;		
-	}
-}
-
-void gotoAddr(int32_t addr, int isLowROM){
-	static int32_t currentAddr = -1;
-	static int32_t currentUpByte = -1;
-	static int32_t currentLowByte = -1;
-	uint16_t upByte;
-	uint16_t lowByte;
-	
-	if (addr <= 0xffff){
-		upByte = (uint8_t)(addr/256);
-		lowByte = (uint8_t)(addr - (upByte * 256));
-		currentAddr = addr;
-	
-  
-		if (isLowROM != 0){
-			upByte = (upByte | 0x80); // ORs a 1 to A15 if LoROM
-		}
-
-		if (currentUpByte != upByte){
-			
-			if (useSPI == 1){
-				writeByte (0, _SNESAddressPins, GPIOB, upByte); //SNESAddressPins._writeRegister(GPIOB,upByte);			
-			}
-			//use GPIO
-			else{
-				
-				writeFlipflops(upByte, GPIO_TRIG_HIGH_ADDR);
-				
-			}
-			
-			currentUpByte = upByte;
-			HighByteWrites++;
-		}
-   
-		if (currentLowByte != lowByte){
-			if (useSPI ==1){
-				writeByte (0, _SNESAddressPins, GPIOA, lowByte);//SNESAddressPins._writeRegister(GPIOA,lowByte)
-			}
-			//use GPIO
-			else{
-				
-				writeFlipflops(lowByte, GPIO_TRIG_LOW_ADDR);
-				
-			}
-			
-			currentLowByte = lowByte;  
-			LowByteWrites++;
-		}
-	}
-	
-	else{
-		
-		if (useSPI == 1){
-			writeByte (0, _SNESAddressPins, GPIOA, 0x00);//SNESAddressPins._writeRegister(GPIOA,0x00)
-			writeByte (0, _SNESAddressPins, GPIOB, 0x00);//SNESAddressPins._writeRegister(GPIOB,0x00)		
-		}
-		//use GPIO
-		else{
-				
-				writeFlipflops(0x00, GPIO_TRIG_LOW_ADDR);
-				writeFlipflops(0x00, GPIO_TRIG_HIGH_ADDR);
-				
-		}
-		
-		currentAddr = 0;
- }
-		
-	
-}
-
-void gotoBank(uint8_t bank){
-	//static int16_t currentBank = -1;
-	
-	if (bank != currentBank){
-		
-		if (useSPI == 1){
-			writeByte (0, _SNESBankAndData, GPIOA, bank);//SNESBankAndData._writeRegister(GPIOA,bank)
-		}
-		//use GPIO
-		else{
-				
-				writeFlipflops(bank, GPIO_TRIG_BANK);
-			
-		}
-		currentBank = bank;
-		BankWrites++;
-	}
-	
-}
-
-uint8_t readAddr(int32_t addr, int isLowROM){
-	gotoAddr(addr,isLowROM); 
-	return readData();	
-}
-
-uint8_t readAddrBank(int32_t addr, uint8_t bank){
-	gotoBank(bank); 
-	gotoAddr(addr,0);
-	return readData();
-}
- 
-void gotoOffset(uint32_t offset,int isLowROM){
-	//static uint32_t currentOffset = 0;
-	//	printf("Forth\n");
-	uint8_t bank = 0;
-	uint32_t addr = 0;
-
-	if (isLowROM == 0){
-		bank = (uint8_t)( offset / 65536); //64Kilobyte pages
-		addr = offset - (bank * 65536); //64kilobyte pages
-	}
-
-	else{
-		bank = (uint8_t)( offset / 32768); //32kilobyte pages
-		addr = offset - (bank * 32768); //32kilobyte pages
-	}
-    //printf("Fifth\n");
-	gotoBank(bank);
-	gotoAddr(addr,isLowROM);
-  //  printf("BANK: %d, ADDR: %d\n",bank, addr);
-	//currentOffset = offset;
-}
-
-uint8_t readOffset(uint32_t offset,int isLowROM){
-	//printf("Seventh\n");
-	gotoOffset(offset,isLowROM);
-	return readData();
-}
- 
 int compareROMchecksums(header,isLowROM){
 	uint32_t currentOffset;
 	uint32_t inverseChecksum;
@@ -477,242 +192,63 @@ void ripROM (uint8_t startBank, int isLowROM, int16_t numberOfPages, uint8_t *RO
  
 }
 
-void changeDataDir(int direction){
-	if (useSPI == 1){
-	
-		if (direction == 1){
-			writeByte (0, _SNESBankAndData, IODIRB, 0xFF);
-			currentDataDir = 1;
-		}
-		
-		else{		
-			writeByte (0, _SNESBankAndData, IODIRB, 0x00);//SNESBankAndData._writeRegister(IODIRB,0x00) # Set MCP bank B to outputs  (SNES Data 0-7)
-			currentDataDir = 0;
-		}
-		
-	}
-	else{
-		
-		//TO DO -------------------------------------------------------------------------------------------------------
-		if (direction == 1){
-			currentDataDir = 1;
-		    digitalWrite(GPIO_OE_DATA_OUT, 1);//disable
-			
-			
-		}
-		
-		else{		
-			
-			currentDataDir = 0;
-			digitalWrite(GPIO_OE_DATA_OUT, 0);//enable
-		}
-		
-	}
-	
-	
-}
-/* def ripSRAM(SRAMsize, ROMsize, isLowROM):
- SRAMdump = ""
- pageChecksum = 0
- currentByte = 0
- bank = 0 
-
- startBank = 0
- startAddr = 0
- endAddr   = 0x7FFF 
- 
- if isLowROM == 1:
-  startBank = 0x70  
-  startAddr = 0x0000
-  endAddr   = 0x7FFF
- else: #Else, is HiROM
-  startBank = 0x30
-  startAddr = 0x6000
-  endAddr   = 0x7FFF
-  IOControls._writeRegister(GPIOA,0x0E)# RESET + /WR + /CS high
-  # GPA7: /IRQ | GPA4: CART MOSFET | GPA3: /CS | GPA2: /WR | GPA1: /RESET  | GPA0: /RD
-  
- SRAMsize = (SRAMsize / 8.0) * 1024
- gotoBank(startBank)
- gotoAddr(startAddr,0)
-
- while SRAMsize > currentByte:
-  currentByte += 1
-  SRAMdump += chr( readData() )
-
-  if gotoAddr.currentAddr >= endAddr:
-   gotoBank( gotoBank.currentBank + 1)
-   gotoAddr(startAddr,0)
-  else:  
-   gotoAddr( gotoAddr.currentAddr +1, 0)
-
- IOControls._writeRegister(GPIOA,0x06)#reset + /WR high
- # GPA7: /IRQ | GPA4: CART MOSFET | GPA3: /CS | GPA2: /WR | GPA1: /RESET  | GPA0: /RD
-
- print str(currentByte) + " SRAM bytes read"
-
- return SRAMdump
-*/ 
-
-void setIOControl(uint8_t IOControls){
-/*
-# GPA0: /RD
-# GPA1: /RESET
-# GPA2: /WR
-# GPA3: /CS
-# GPA4: CART MOSFET
-# GPA7: /IRQ 
-*/	
-
-//Inverses Control Bits. Bits are pulled low to enable
-IOControls = IOControls ^ 0x0F; 
-
-if (useSPI == 1){
-	
-	//Inverses Power (pull mosfet low to enable)
-	IOControls = IOControls ^ _POWER;
-	writeByte (0, _IOControls, GPIOA, IOControls);
-}
-//else use direct GPIO
-else{
-				
-	writeFlipflops(IOControls, GPIO_TRIG_CTRL);
-				
-}
-	
-}
-
-void initInterface_SPI(void){
-	
-	useSPI = 1;
-	
-	wiringPiSetup () ;
-	mcp23s17Setup (BASE, 0, _IOControls) ;
-	mcp23s17Setup (BASE+100, 0,_SNESAddressPins) ;
-	mcp23s17Setup (BASE+200, 0, _SNESBankAndData) ;
-	
-	writeByte (0, _IOControls, IOCON_B, 0x08);//IOControls._writeRegister(IOCON_B,0x08)
-
-	writeByte (0, _SNESAddressPins, IODIRA, 0x00);//SNESAddressPins._writeRegister(IODIRA,0x00) # Set MCP bank A to outputs (SNES Addr 0-7)
-	writeByte (0, _SNESAddressPins, IODIRB, 0x00);//SNESAddressPins._writeRegister(IODIRB,0x00) # Set MCP bank B to outputs (SNES Addr 8-15)
-
-	writeByte (0, _SNESBankAndData, IODIRA, 0x00);//SNESBankAndData._writeRegister(IODIRA,0x00) # Set MCP bank A to outputs (SNES Bank 0-7)
-	changeDataDir(1);//writeByte (0, _SNESBankAndData, IODIRB, 0xFF);//SNESBankAndData._writeRegister(IODIRB,0xFF) # Set MCP bank B to inputs  (SNES Data 0-7)
-
-	writeByte (0, _SNESBankAndData, GPPUB, 0xFF);//SNESBankAndData._writeRegister(GPPUB,0xFF) # Enables Pull-Up Resistors on MCP SNES Data 0-7		
-	
-	writeByte (0, _IOControls, IODIRA, 0x80);//IOControls._writeRegister(IODIRA,0x80) # Set MCP bank A to outputs; WITH EXCEPTION TO IRQ
-	writeByte (0, _IOControls, IODIRB, 0x00);//IOControls._writeRegister(IODIRB,0x00) # Set MCP bank B to outputs 
-
-}
-
-void initInterface_GPIO(void){
-	useSPI = 0;
-	
-	wiringPiSetup();
-	pinMode(GPIO_DATA_DIR, OUTPUT);
-	digitalWrite(GPIO_DATA_DIR, 0);//set up DATA pins as inputs
-	
-	pinMode(GPIO_DATA_0, INPUT);
-	pinMode(GPIO_DATA_1, INPUT);
-	pinMode(GPIO_DATA_2, INPUT);
-	pinMode(GPIO_DATA_3, INPUT);
-	pinMode(GPIO_DATA_4, INPUT);
-	pinMode(GPIO_DATA_5, INPUT);
-	pinMode(GPIO_DATA_6, INPUT);
-	pinMode(GPIO_DATA_7, INPUT);
-	
-	pinMode(GPIO_OUT_0, OUTPUT);
-    pinMode(GPIO_OUT_1, OUTPUT);
-    pinMode(GPIO_OUT_2, OUTPUT);
-    pinMode(GPIO_OUT_3, OUTPUT);
-    pinMode(GPIO_OUT_4, OUTPUT);
-    pinMode(GPIO_OUT_5, OUTPUT);
-    pinMode(GPIO_OUT_6, OUTPUT);
-    pinMode(GPIO_OUT_7, OUTPUT);
-	
-	pinMode(GPIO_TRIG_BANK, OUTPUT);
-    pinMode(GPIO_TRIG_CTRL, OUTPUT);
-    pinMode(GPIO_TRIG_DATA_OUT, OUTPUT);
-    pinMode(GPIO_TRIG_HIGH_ADDR, OUTPUT);
-    pinMode(GPIO_TRIG_LOW_ADDR, OUTPUT);
-	
-	digitalWrite(GPIO_TRIG_BANK, 0);
-	digitalWrite(GPIO_TRIG_CTRL, 0);
-	digitalWrite(GPIO_TRIG_DATA_OUT, 0);
-	digitalWrite(GPIO_TRIG_HIGH_ADDR, 0);
-	digitalWrite(GPIO_TRIG_LOW_ADDR, 0);	
-	
-	pinMode(GPIO_OE_CTRL, OUTPUT);
-	digitalWrite(GPIO_OE_CTRL, 0);
-	
-	pinMode(GPIO_OE_DATA_OUT, OUTPUT);
-	digitalWrite(GPIO_OE_DATA_OUT, 1);
-	//changeDataDir(1);
-	
-	delayMicroseconds(100);
-	
-}
-
-void shutdownInterface_SPI(void){
-	
-	gotoAddr(00,0);
-	gotoBank(00);
-
-	writeByte (0, _SNESBankAndData, GPPUB, 0x00);//SNESBankAndData._writeRegister(GPPUB,0x00) # Disables Pull-Up Resistors on MCP SNES Data 0-7
-	writeByte (0, _SNESBankAndData, DEFVALB, 0xFF);//SNESBankAndData._writeRegister(DEFVALB,0xFF) # Expect MCP SNES Data 0-7 to default to 0xFF
-	writeByte (0, _SNESBankAndData, GPINTENB, 0x00);//SNESBankAndData._writeRegister(GPINTENB,0x00) # Sets up all of SNES Data 0-7 to be interrupt disabled
-
-	writeByte (0, _SNESAddressPins, IODIRA, 0xFF);//SNESAddressPins._writeRegister(IODIRA,0xFF) # Set MCP bank A to outputs (SNES Addr 0-7)
-	writeByte (0, _SNESAddressPins, IODIRB, 0xFF);//SNESAddressPins._writeRegister(IODIRB,0xFF) # Set MCP bank B to outputs (SNES Addr 8-15)
-
-	writeByte (0, _SNESBankAndData, IODIRA, 0xFF);//SNESBankAndData._writeRegister(IODIRA,0xFF) # Set MCP bank A to outputs (SNES Bank 0-7)
-	changeDataDir(1);//writeByte (0, _SNESBankAndData, IODIRB, 0xFF);//SNESBankAndData._writeRegister(IODIRB,0xFF) # Set MCP bank B to inputs (SNES Data 0-7)
-
-	writeByte (0, _IOControls, IODIRA, 0xEF);//IOControls._writeRegister(IODIRA,0xEF) # Set MCP bank A to inputs; WITH EXCEPTION TO MOSFET
-
-	setIOControl(0); //writeByte (0, _IOControls, GPIOA, 0x10);//IOControls._writeRegister(GPIOA,0x10) #Turn off MOSFET	
-	
-}
-
-void shutdownInterface_GPIO(void){
-	setIOControl(0);
-	gotoAddr(0,0);
-	gotoBank(0);
-	digitalWrite(GPIO_OE_CTRL, 1);//Turn Off Flip flops
-	digitalWrite(GPIO_OE_DATA_OUT, 1);
-
+void printhelp(void){
+	printf("Usage: ./cart_reader [options]\n\n");
+	printf("  -i bus   Use the MCP23017 board on /dev/i2c-<bus> instead of SPI\n");
+	printf("  -b rate  I2C clock the bus should run at: 100000, 400000 or 1700000\n");
+	printf("           (default 400000)\n");
+	printf("           The clock is set with dtparam=i2c_arm_baudrate in /boot/config.txt.\n");
+	printf("           The Pi has no high-speed mode master code, 1.7 MHz is clocked in\n");
+	printf("           fast-mode signalling: keep the wires short and the pull-ups strong.\n");
+	printf("  -t file  Record the bus traffic to a trace file (see trace_replay)\n");
+	printf("  -R       Real-time mode: SCHED_FIFO, locked memory, single cpu (needs root)\n");
+	printf("  -C cpu   Cpu to run on in real-time mode (default: the last one)\n");
+	printf("  -J       Print a latency histogram of the bus operations after the rip\n");
+	printf("  -h       Prints this info\n");
 }
 
-void writeFlipflops(uint8_t dataOut,int clkTrigger){
-	
-int i = 0;
-int bits[8] = {0};
-
-for (i=0;i<8;i++)
- if( (dataOut & (1<<i) ) == (1<<i) )
-   bits[i] = 1;   
-
-digitalWrite(GPIO_OUT_0, bits[0]); 
-digitalWrite(GPIO_OUT_1, bits[1]);
-digitalWrite(GPIO_OUT_2, bits[2]);
-digitalWrite(GPIO_OUT_3, bits[3]);
-digitalWrite(GPIO_OUT_4, bits[4]);
-digitalWrite(GPIO_OUT_5, bits[5]);
-digitalWrite(GPIO_OUT_6, bits[6]);
-digitalWrite(GPIO_OUT_7, bits[7]);
-
-//delayMicroseconds(4000);	
-digitalWrite(clkTrigger, 1);
-delayMicroseconds(100);//for (i=0;i<85000;i++);
-digitalWrite(clkTrigger, 0);
-//delayMicroseconds(5);
-	
-}
-
-
-
-int main(void){
+int main(int argc, char **argv){
+	
+	char *traceFile = NULL;
+	int i2cBus = -1;
+	uint32_t i2cRate = 400000;
+	int realtime = 0;
+	int rtCpu = -1;
+	int opt;
+	
+	while ((opt = getopt(argc, argv, "i:b:t:RC:Jh")) >= 0){
+		switch (opt){
+			case 'i':
+				i2cBus = atoi(optarg);
+				useI2C = 1;
+				break;
+			case 'b':
+				i2cRate = strtoul(optarg, NULL, 0);
+				if (i2cRate != 100000 && i2cRate != 400000 && i2cRate != 1700000){
+					fprintf(stderr, "Supported I2C clocks are 100000, 400000 and 1700000\n");
+					return 1;
+				}
+				break;
+			case 't':
+				traceFile = optarg;
+				break;
+			case 'R':
+				realtime = 1;
+				break;
+			case 'C':
+				rtCpu = atoi(optarg);
+				break;
+			case 'J':
+				rt_measuring = 1;
+				break;
+			case 'h':
+				printhelp();
+				return 0;
+			default:
+				fprintf(stderr, "Unknown argument. try -h\n");
+				return 1;
+		}
+	}
 	
 	printf("START\n");
 	
@@ -737,7 +273,21 @@ int main(void){
 
 
 
-	initInterface_SPI();
+	if (realtime)
+		rt_enable(rtCpu, RT_DEFAULT_PRIORITY);
+
+	// open the trace first so the expander setup is part of it
+	if (traceFile != NULL){
+		if (bustraceOpen(traceFile, useI2C ? BT_BACKEND_I2C : useSPI ? BT_BACKEND_SPI : BT_BACKEND_GPIO) < 0)
+			return 1;
+	}
+
+	if (useI2C){
+		i2cbusCheckRate(i2cBus, i2cRate);
+		initInterface_I2C(i2cBus);
+	}
+	else
+		initInterface_SPI();
 	//initInterface_GPIO();
 
 //----------------------------------------------------------------------------------------------------
@@ -940,6 +490,7 @@ if (isValid == 1){
 
    sizeOfCartInBytes = numberOfPages * 32768;  
    dump = calloc(sizeOfCartInBytes, sizeof(uint8_t) );
+   rt_prefault(dump, sizeOfCartInBytes);
    printf("Reading %d Low ROM pages.\n", numberOfPages);
 
    //ROM Ripper
@@ -949,6 +500,7 @@ if (isValid == 1){
   else{
 	  sizeOfCartInBytes = numberOfPages * 65536;
 	  dump = calloc(sizeOfCartInBytes, sizeof(uint8_t) );
+	  rt_prefault(dump, sizeOfCartInBytes);
    if (numberOfPages > 64){
     numberOfRemainPages = ( numberOfPages - 64 ); //# number of pages over 64
     printf("Reading first 64 of %d Hi ROM pages.\n",  numberOfPages);
@@ -1010,7 +562,15 @@ else{
 
 //#--- Clean Up & End Script ------------------------------------------------------
 
-shutdownInterface_SPI();
+if (useI2C)
+	shutdownInterface_I2C();
+else
+	shutdownInterface_SPI();
 //shutdownInterface_GPIO();
 
+bustraceClose();
+
+if (rt_measuring)
+	rt_hist_report();
+
 }
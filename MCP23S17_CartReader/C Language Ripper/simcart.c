@@ -0,0 +1,170 @@
+/*
+ * simcart.c:
+ *      Simulated cart backend: models the three MCP23x17 expanders of
+ *      the cart reader and a cartridge built from a ROM image.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "simcart.h"
+
+// Same wiring as cart_reader.c
+#define _SNESAddressPins 0x20 // GPIOA: A0-A7, GPIOB: A8-A15
+#define _SNESBankAndData 0x22 // GPIOA: BA0-BA7, GPIOB: D0-D7
+#define _IOControls 0x23      // GPIOA: /RD /RESET /WR /CS MOSFET
+
+#define IODIRB 0X01
+#define GPIOA 0X12
+#define GPIOB 0X13
+
+#define _RD    0b00000001
+#define _WR    0b00000100
+#define _CS    0b00001000
+#define _POWER 0b00010000
+
+#define SRAM_SIZE 0x20000
+
+// One register file per expander, indexed by devId & 7
+static uint8_t regs[8][0x16];
+static uint8_t *rom = NULL;
+static uint32_t romSize = 0;
+static uint8_t sram[SRAM_SIZE];
+static int isLowROM = 1;
+
+static int validHeader(uint32_t header){
+	uint16_t checksum, inverse;
+
+	if (header + 32 > romSize)
+		return 0;
+	inverse = rom[header + 28] | (rom[header + 29] << 8);
+	checksum = rom[header + 30] | (rom[header + 31] << 8);
+	return (inverse ^ checksum) == 0xFFFF;
+}
+
+int simcartLoad(const char *romPath){
+	FILE *fptr;
+	long size;
+
+	fptr = fopen(romPath, "rb");
+	if (fptr == NULL){
+		perror(romPath);
+		return -1;
+	}
+
+	fseek(fptr, 0, SEEK_END);
+	size = ftell(fptr);
+	fseek(fptr, 0, SEEK_SET);
+	if (size <= 0){
+		fprintf(stderr, "%s: empty ROM image\n", romPath);
+		fclose(fptr);
+		return -1;
+	}
+
+	simcartFree();
+	rom = malloc(size);
+	if (rom == NULL || fread(rom, size, 1, fptr) != 1){
+		fprintf(stderr, "%s: could not read ROM image\n", romPath);
+		fclose(fptr);
+		simcartFree();
+		return -1;
+	}
+	fclose(fptr);
+	romSize = (uint32_t)size;
+
+	// cart_reader checks the LoROM header first, do the same
+	if (validHeader(0x7FC0))
+		isLowROM = 1;
+	else if (validHeader(0xFFC0))
+		isLowROM = 0;
+	else
+		isLowROM = 1;
+
+	memset(regs, 0, sizeof(regs));
+	memset(sram, 0xFF, sizeof(sram));
+	return 0;
+}
+
+void simcartFree(void){
+	free(rom);
+	rom = NULL;
+	romSize = 0;
+}
+
+int simcartIsLowROM(void){
+	return isLowROM;
+}
+
+// Decodes the bank/address lines into a ROM or SRAM location.
+// Returns a pointer to the byte, or NULL for open bus.
+static uint8_t *decode(void){
+	uint8_t bank = regs[_SNESBankAndData & 7][GPIOA];
+	uint16_t addr = regs[_SNESAddressPins & 7][GPIOA] |
+		(regs[_SNESAddressPins & 7][GPIOB] << 8);
+	uint32_t offset;
+
+	if (rom == NULL)
+		return NULL;
+
+	if (isLowROM){
+		if (addr & 0x8000){
+			offset = (bank & 0x7F) * 0x8000 + (addr & 0x7FFF);
+			return &rom[offset % romSize];
+		}
+		if ((bank & 0x7F) >= 0x70 && (bank & 0x7F) < 0x7E)
+			return &sram[(((bank & 0x0F) * 0x8000) + addr) % SRAM_SIZE];
+		return NULL;
+	}
+
+	if ((bank & 0x40) || (addr & 0x8000)){
+		offset = (bank & 0x3F) * 0x10000 + addr;
+		return &rom[offset % romSize];
+	}
+	if ((bank & 0x60) == 0x20 && addr >= 0x6000)
+		return &sram[(((bank & 0x1F) * 0x2000) + (addr - 0x6000)) % SRAM_SIZE];
+	return NULL;
+}
+
+void simcartWrite(uint8_t devId, uint8_t reg, uint8_t data){
+	uint8_t *cell;
+
+	if (reg >= sizeof(regs[0]))
+		return;
+	regs[devId & 7][reg] = data;
+
+	// A falling /WR with the data port driven by the expander stores
+	// into SRAM (ROM ignores it). Control lines and the MOSFET gate
+	// are all active low on GPIOA.
+	if ((devId & 7) == (_IOControls & 7) && reg == GPIOA){
+		if (!(data & _WR) && !(data & _POWER) &&
+				regs[_SNESBankAndData & 7][IODIRB] == 0x00){
+			cell = decode();
+			if (cell >= sram && cell < sram + SRAM_SIZE)
+				*cell = regs[_SNESBankAndData & 7][GPIOB];
+		}
+	}
+}
+
+uint8_t simcartRead(uint8_t devId, uint8_t reg){
+	uint8_t ctrl = regs[_IOControls & 7][GPIOA];
+	uint8_t *cell;
+
+	if (reg >= sizeof(regs[0]))
+		return 0xFF;
+
+	if ((devId & 7) != (_SNESBankAndData & 7) || reg != GPIOB)
+		return regs[devId & 7][reg];
+
+	// Data port: output latch when driven by the expander, otherwise
+	// the cart drives it while powered and /RD is low. Pull-ups
+	// give 0xFF on an idle bus.
+	if (regs[devId & 7][IODIRB] == 0x00)
+		return regs[devId & 7][GPIOB];
+	if ((ctrl & _RD) || (ctrl & _POWER))
+		return 0xFF;
+
+	cell = decode();
+	return cell ? *cell : 0xFF;
+}
@@ -0,0 +1,26 @@
+/*
+ * simcart.h:
+ *      Simulated cart backend: models the three MCP23x17 expanders of
+ *      the cart reader and a cartridge built from a ROM image, so bus
+ *      traces can be replayed without hardware.
+ ***********************************************************************
+ */
+
+#ifndef _simcart_h__
+#define _simcart_h__
+
+#include <stdint.h>
+
+// Loads a headerless ROM image (.smc as written by cart_reader).
+// The mapping (LoROM or HiROM) is guessed from the internal header.
+// Returns 0 on success, -1 on error.
+int simcartLoad(const char *romPath);
+void simcartFree(void);
+
+int simcartIsLowROM(void);
+
+// Register level access, same addressing as writeByte()/readByte()
+void simcartWrite(uint8_t devId, uint8_t reg, uint8_t data);
+uint8_t simcartRead(uint8_t devId, uint8_t reg);
+
+#endif // _simcart_h__
@@ -0,0 +1,284 @@
+/*
+ * trace_replay.c:
+ *      Offline tools for bus traces recorded with cart_reader -t.
+ *
+ *      trace_replay -r game.smc trace.bin
+ *              Re-drives the recorded register traffic against the
+ *              simulated cart and checks every read against it.
+ *
+ *      trace_replay -d old.bin new.bin
+ *              Compares the register traffic of two ripper versions.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "bustrace.h"
+#include "simcart.h"
+
+#define MAX_REPORTED_MISMATCHES 10
+
+static const char *backendNames[] = { "SPI", "GPIO", "I2C" };
+
+// Per device/register/operation totals. Only the low 3 address bits of
+// the device are significant (0x20 - 0x27).
+struct trafficStats {
+	uint32_t count[8][0x16][2];
+	uint64_t time_us[8][0x16][2];
+	uint32_t records;
+	uint32_t marks;
+	uint64_t total_us;
+};
+
+static const char *regName(uint8_t reg){
+	static char buf[8];
+
+	switch (reg){
+		case 0x00: return "IODIRA";
+		case 0x01: return "IODIRB";
+		case 0x05: return "GPINTENB";
+		case 0x07: return "DEFVALB";
+		case 0x0B: return "IOCON";
+		case 0x0D: return "GPPUB";
+		case 0x12: return "GPIOA";
+		case 0x13: return "GPIOB";
+	}
+	snprintf(buf, sizeof(buf), "0x%02X", reg);
+	return buf;
+}
+
+static FILE *openTrace(const char *path, struct bustraceHeader *hdr){
+	FILE *fptr;
+
+	fptr = fopen(path, "rb");
+	if (fptr == NULL){
+		perror(path);
+		return NULL;
+	}
+	if (bustraceReadHeader(fptr, hdr) < 0){
+		fprintf(stderr, "%s: not a bus trace\n", path);
+		fclose(fptr);
+		return NULL;
+	}
+	return fptr;
+}
+
+static void account(struct trafficStats *stats, struct bustraceRecord *rec){
+	stats->records++;
+	stats->total_us += rec->delta_us;
+
+	if (rec->op == BT_MARK){
+		stats->marks++;
+		return;
+	}
+	if (rec->reg >= 0x16 || rec->op > BT_READ)
+		return;
+
+	stats->count[rec->devId & 7][rec->reg][rec->op]++;
+	stats->time_us[rec->devId & 7][rec->reg][rec->op] += rec->delta_us;
+}
+
+static int replay(const char *romPath, const char *tracePath){
+	struct bustraceHeader hdr;
+	struct bustraceRecord rec;
+	struct trafficStats *stats;
+	FILE *fptr;
+	uint8_t simulated;
+	uint32_t reads = 0, mismatches = 0;
+	int res, dev, reg;
+
+	if (simcartLoad(romPath) < 0)
+		return 1;
+
+	fptr = openTrace(tracePath, &hdr);
+	if (fptr == NULL)
+		return 1;
+
+	stats = calloc(1, sizeof(*stats));
+	if (stats == NULL){
+		fclose(fptr);
+		return 1;
+	}
+
+	printf("Replaying %s trace against %s (%s)\n",
+		hdr.backend < 3 ? backendNames[hdr.backend] : "unknown",
+		romPath, simcartIsLowROM() ? "LoROM" : "HiROM");
+
+	while ((res = bustraceNext(fptr, &rec)) > 0){
+		account(stats, &rec);
+
+		if (rec.op == BT_WRITE){
+			simcartWrite(rec.devId, rec.reg, rec.data);
+		}
+		else if (rec.op == BT_READ){
+			reads++;
+			simulated = simcartRead(rec.devId, rec.reg);
+			if (simulated != rec.data){
+				if (mismatches < MAX_REPORTED_MISMATCHES)
+					printf("Record %u: read 0x%02X %s returned %02X, simulator says %02X\n",
+						stats->records - 1, rec.devId, regName(rec.reg),
+						rec.data, simulated);
+				mismatches++;
+			}
+		}
+	}
+	if (res < 0)
+		printf("Warning: trace is truncated\n");
+
+	printf("\n%u records, %u reads, %u mismatches\n", stats->records, reads, mismatches);
+	printf("Recorded bus time: %.3f s\n\n", stats->total_us / 1000000.0);
+	printf("Device Register  Op      Count   Avg us\n");
+	for (dev = 0; dev < 8; dev++){
+		for (reg = 0; reg < 0x16; reg++){
+			for (res = BT_WRITE; res <= BT_READ; res++){
+				if (!stats->count[dev][reg][res])
+					continue;
+				printf("  0x%02X %-9s %-5s %9u %8.1f\n", 0x20 | dev, regName(reg),
+					res == BT_WRITE ? "write" : "read",
+					stats->count[dev][reg][res],
+					(double)stats->time_us[dev][reg][res] / stats->count[dev][reg][res]);
+			}
+		}
+	}
+
+	free(stats);
+	fclose(fptr);
+	simcartFree();
+
+	return mismatches ? 2 : 0;
+}
+
+static int diffTraces(const char *pathA, const char *pathB){
+	struct bustraceHeader hdrA, hdrB;
+	struct bustraceRecord recA, recB;
+	struct trafficStats *a, *b;
+	FILE *fa, *fb;
+	int resA = 1, resB = 1, dev, reg, op;
+	int64_t firstDivergence = -1, index = 0;
+	int differences = 0;
+
+	fa = openTrace(pathA, &hdrA);
+	if (fa == NULL)
+		return 1;
+	fb = openTrace(pathB, &hdrB);
+	if (fb == NULL){
+		fclose(fa);
+		return 1;
+	}
+
+	a = calloc(1, sizeof(*a));
+	b = calloc(1, sizeof(*b));
+	if (a == NULL || b == NULL){
+		free(a);
+		free(b);
+		fclose(fa);
+		fclose(fb);
+		return 1;
+	}
+
+	// Walk both traces in lock step to find where the sequences part,
+	// then keep accounting the longer one.
+	while (resA > 0 || resB > 0){
+		if (resA > 0)
+			resA = bustraceNext(fa, &recA);
+		if (resB > 0)
+			resB = bustraceNext(fb, &recB);
+		if (resA > 0)
+			account(a, &recA);
+		if (resB > 0)
+			account(b, &recB);
+
+		if (firstDivergence < 0){
+			if ((resA > 0) != (resB > 0) ||
+				(resA > 0 && (recA.op != recB.op || recA.devId != recB.devId ||
+					recA.reg != recB.reg || recA.data != recB.data))){
+				firstDivergence = index;
+			}
+		}
+		index++;
+	}
+
+	printf("             %12s %12s\n", "A", "B");
+	printf("Records:     %12u %12u\n", a->records, b->records);
+	printf("Bus time s:  %12.3f %12.3f\n", a->total_us / 1000000.0, b->total_us / 1000000.0);
+	if (firstDivergence < 0)
+		printf("\nRegister traffic is identical\n");
+	else
+		printf("\nSequences diverge at record %lld\n", (long long)firstDivergence);
+
+	printf("\nDevice Register  Op          A          B    Avg us A   Avg us B\n");
+	for (dev = 0; dev < 8; dev++){
+		for (reg = 0; reg < 0x16; reg++){
+			for (op = BT_WRITE; op <= BT_READ; op++){
+				uint32_t ca = a->count[dev][reg][op];
+				uint32_t cb = b->count[dev][reg][op];
+
+				if (!ca && !cb)
+					continue;
+				if (ca != cb)
+					differences++;
+				printf("%c 0x%02X %-9s %-5s %10u %10u %10.1f %10.1f\n",
+					ca != cb ? '*' : ' ', 0x20 | dev, regName(reg),
+					op == BT_WRITE ? "write" : "read", ca, cb,
+					ca ? (double)a->time_us[dev][reg][op] / ca : 0.0,
+					cb ? (double)b->time_us[dev][reg][op] / cb : 0.0);
+			}
+		}
+	}
+
+	free(a);
+	free(b);
+	fclose(fa);
+	fclose(fb);
+
+	return (firstDivergence < 0 && !differences) ? 0 : 2;
+}
+
+static void printhelp(void){
+	printf("Usage: trace_replay -r rom.smc trace.bin\n");
+	printf("       trace_replay -d old.bin new.bin\n\n");
+	printf("  -r rom   Replay a trace against a simulated cart built from rom\n");
+	printf("  -d       Compare the register traffic of two traces\n");
+	printf("  -h       Prints this info\n\n");
+	printf("Exit status is 2 when reads mismatch or traces differ.\n");
+}
+
+int main(int argc, char **argv){
+	char *romPath = NULL;
+	int diff = 0;
+	int res;
+
+	while ((res = getopt(argc, argv, "r:dh")) >= 0){
+		switch (res){
+			case 'r':
+				romPath = optarg;
+				break;
+			case 'd':
+				diff = 1;
+				break;
+			case 'h':
+				printhelp();
+				return 0;
+			default:
+				fprintf(stderr, "Unknown argument. try -h\n");
+				return 1;
+		}
+	}
+
+	if (diff){
+		if (argc - optind != 2){
+			fprintf(stderr, "-d needs two traces. try -h\n");
+			return 1;
+		}
+		return diffTraces(argv[optind], argv[optind + 1]);
+	}
+
+	if (romPath == NULL || argc - optind != 1){
+		fprintf(stderr, "Need a ROM image and a trace. try -h\n");
+		return 1;
+	}
+	return replay(romPath, argv[optind]);
+}
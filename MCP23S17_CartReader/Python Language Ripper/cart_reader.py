@@ -3,44 +3,20 @@ import sys
 import os 
 import getopt
 import codecs
-from RPiMCP23S17.MCP23S17 import MCP23S17
+
+# every byte moves in libsnespi, see ../../libsnespi/snespi.py
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "..", "libsnespi"))
+import snespi
 
 
 def readData():
- return SNESBankAndData._readRegister(GPIOB)
+ return snespi.read_data()
 
 def gotoAddr(addr,isLowROM):
- if addr <= 0xffff: 
-  upByte = int(addr/256)
-  lowByte = addr - (upByte * 256)
-  gotoAddr.currentAddr = addr
-  
-  if isLowROM != 0:
-   upByte = upByte | 0x80 # ORs a 1 to A15 if LoROM
-
-  if gotoAddr.currentUpByte != upByte:
-   SNESAddressPins._writeRegister(GPIOB,upByte)
-   gotoAddr.currentUpByte = upByte
-   
-  if gotoAddr.currentLowByte != lowByte: 
-   SNESAddressPins._writeRegister(GPIOA,lowByte)
-   gotoAddr.currentLowByte = lowByte  
-   
- else:
-  SNESAddressPins._writeRegister(GPIOA,0x00)
-  SNESAddressPins._writeRegister(GPIOB,0x00)
-  gotoAddr.currentAddr = 0
-
-gotoAddr.currentAddr = -1
-gotoAddr.currentUpByte = -1
-gotoAddr.currentLowByte = -1
+ snespi.goto_addr(addr,isLowROM)
 
 def gotoBank(bank):
- if bank != gotoBank.currentBank:
-  SNESBankAndData._writeRegister(GPIOA,bank)
-  gotoBank.currentBank = bank
-  
-gotoBank.currentBank = -1
+ snespi.goto_bank(bank)
 
 def readAddr(addr,isLowROM):
  gotoAddr(addr,isLowROM) 
@@ -63,16 +39,9 @@ def gotoOffset(offset,isLowROM):
 
  gotoBank(bank)
  gotoAddr(addr,isLowROM)
-  
- gotoOffset.currentOffset = offset
- 
-gotoOffset.currentOffset = 0
-
 
-  
 def readOffset(offset,isLowROM):
- gotoOffset(offset,isLowROM)
- return readData()
+ return snespi.read_offset(offset,isLowROM)
 
 def compareROMchecksums(header,isLowROM):
  if isLowROM == 1:
@@ -163,35 +132,26 @@ def CX4setROMsize(ROMsize):
  
  
 def ripROM (startBank, isLowROM,numberOfPages):
-  #cart.write_byte_data(_IOControls,GPIOA,0x04)
  ROMdump = ""
  pageChecksum = 0
- currentByte = 0
- bank = 0
  
  if isLowROM == 1:
-  startOffset = startBank * 0x8000
+  bankSize = 0x8000
  else:
-  startOffset = startBank * 0x10000
- 
- offset = startOffset  # Set current Offset to starting offset
- gotoOffset(startOffset,isLowROM)# Change current bank & address to offset
+  bankSize = 0x10000
 
  print "----Start Cart Read------" 
  print ""
- #Start at current bank, and increment the number of banks needed
+ #Start at current bank, and read whole banks at a time
  for bank in range(startBank, (numberOfPages + startBank)  ): 
-  print "Current Bank:  DEC: " + str( gotoBank.currentBank ) + "; HEX: " + str( hex(gotoBank.currentBank ))
+  print "Current Bank:  DEC: " + str( bank ) + "; HEX: " + str( hex( bank ))
   
-  #If bank increments, exit the following inner loop, else keep scanning
-  while bank == gotoBank.currentBank:
-   currentByte = readData()
-   ROMdump += chr(currentByte)
-   pageChecksum += currentByte 
-   offset += 1 #Increment offset
-   gotoOffset(offset,isLowROM) #goto new offset
+  bankData = snespi.read(bank * bankSize, isLowROM, bankSize)
+  ROMdump += bankData
+  pageChecksum += sum( bytearray(bankData) )
  
-  if isLowROM == 0 or (isLowROM == 1 and gotoBank.currentBank % 2 == 0):
+  # LoROM pages are 64K: report after every second 32K bank
+  if isLowROM == 0 or (isLowROM == 1 and (bank + 1) % 2 == 0):
    print " - Page Checksum:       " + str( pageChecksum ) 
    ripROM.totalChecksum += pageChecksum
    pageChecksum = 0
@@ -205,44 +165,10 @@ def ripROM (startBank, isLowROM,numberOfPages):
 ripROM.totalChecksum = 0
 
 def ripSRAM(SRAMsize, ROMsize, isLowROM):
- SRAMdump = ""
- pageChecksum = 0
- currentByte = 0
- bank = 0 
+ SRAMsize = int( (SRAMsize / 8.0) * 1024 )
+ SRAMdump = snespi.sram_read(isLowROM, SRAMsize)
 
- startBank = 0
- startAddr = 0
- endAddr   = 0x7FFF 
- 
- if isLowROM == 1:
-  startBank = 0x70  
-  startAddr = 0x0000
-  endAddr   = 0x7FFF
- else: #Else, is HiROM
-  startBank = 0x30
-  startAddr = 0x6000
-  endAddr   = 0x7FFF
-  IOControls._writeRegister(GPIOA,0x0E)# RESET + /WR + /CS high
-  # GPA7: /IRQ | GPA4: CART MOSFET | GPA3: /CS | GPA2: /WR | GPA1: /RESET  | GPA0: /RD
-  
- SRAMsize = (SRAMsize / 8.0) * 1024
- gotoBank(startBank)
- gotoAddr(startAddr,0)
-
- while SRAMsize > currentByte:
-  currentByte += 1
-  SRAMdump += chr( readData() )
-
-  if gotoAddr.currentAddr >= endAddr:
-   gotoBank( gotoBank.currentBank + 1)
-   gotoAddr(startAddr,0)
-  else:  
-   gotoAddr( gotoAddr.currentAddr +1, 0)
-
- IOControls._writeRegister(GPIOA,0x06)#reset + /WR high
- # GPA7: /IRQ | GPA4: CART MOSFET | GPA3: /CS | GPA2: /WR | GPA1: /RESET  | GPA0: /RD
-
- print str(currentByte) + " SRAM bytes read"
+ print str(len(SRAMdump)) + " SRAM bytes read"
 
  return SRAMdump
 
@@ -298,13 +224,11 @@ IOCON_B = 0x0B
 GPPUB   = 0x0D
 # ------------- Set Registers -----------------------------------------------------
 
-IOControls      = MCP23S17(bus=0x00, ce=0x00, deviceID=0x03)
-SNESAddressPins = MCP23S17(bus=0x00, ce=0x00, deviceID=0x00)
-SNESBankAndData = MCP23S17(bus=0x00, ce=0x00, deviceID=0x02)
+snespi.cart_open(snespi.BUS_SPI)
 
-IOControls.open()
-SNESAddressPins.open()
-SNESBankAndData.open()
+IOControls      = snespi.MCP23S17(0x23)
+SNESAddressPins = snespi.MCP23S17(0x20)
+SNESBankAndData = snespi.MCP23S17(0x22)
 
 #IOControls._writeRegister(IOCON_B,0x08)
 
@@ -544,28 +468,4 @@ else:
 
 
 #--- Clean Up & End Script ------------------------------------------------------
-gotoAddr(00,0)
-gotoBank(00)
-
-SNESBankAndData._writeRegister(GPPUB,0x00) # Disables Pull-Up Resistors on MCP SNES Data 0-7
-SNESBankAndData._writeRegister(DEFVALB,0xFF) # Expect MCP SNES Data 0-7 to default to 0xFF
-SNESBankAndData._writeRegister(GPINTENB,0x00) # Sets up all of SNES Data 0-7 to be interrupt disabled
-
-SNESAddressPins._writeRegister(IODIRA,0xFF) # Set MCP bank A to outputs (SNES Addr 0-7)
-SNESAddressPins._writeRegister(IODIRB,0xFF) # Set MCP bank B to outputs (SNES Addr 8-15)
-
-SNESBankAndData._writeRegister(IODIRA,0xFF) # Set MCP bank A to outputs (SNES Bank 0-7)
-SNESBankAndData._writeRegister(IODIRB,0xFF) # Set MCP bank B to inputs (SNES Data 0-7)
-
-
-
-
-IOControls._writeRegister(IODIRA,0xEF) # Set MCP bank A to inputs; WITH EXCEPTION TO MOSFET
-
-IOControls._writeRegister(GPIOA,0x10) #Turn off MOSFET
-#cart.write_byte_data(_IOControls,IODIRA,0xFF) # Set MCP bank A to outputs; WITH EXCEPTION TO IRQ
-
-SNESAddressPins.close()
-SNESBankAndData.close()
-IOControls.close()
- 
+snespi.cart_close() # address and data ports back to inputs, MOSFET off
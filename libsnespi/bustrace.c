@@ -0,0 +1,155 @@
+/*
+ * bustrace.c:
+ *      Compact binary recording of the expander register traffic
+ *      generated by the cart reader. See bustrace.h for the format.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "bustrace.h"
+
+// Recording must not slow the rip down noticeably, so records go
+// through a large stdio buffer and are only flushed on close.
+#define TRACE_BUFFER_SIZE (256 * 1024)
+
+static FILE *traceFile = NULL;
+static char *traceBuffer = NULL;
+static struct timespec lastStamp;
+
+static uint32_t elapsedMicros(void){
+	struct timespec now;
+	uint64_t delta;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	delta = (uint64_t)(now.tv_sec - lastStamp.tv_sec) * 1000000;
+	delta += (now.tv_nsec - lastStamp.tv_nsec) / 1000;
+	lastStamp = now;
+
+	if (delta > 0xFFFFFFFF)
+		delta = 0xFFFFFFFF;
+	return (uint32_t)delta;
+}
+
+static void putRecord(uint8_t op, uint8_t devId, uint8_t reg, uint8_t data){
+	uint8_t rec[8];
+	uint32_t delta;
+	int len = 0;
+
+	if (traceFile == NULL)
+		return;
+
+	delta = elapsedMicros();
+
+	rec[len++] = (op << 4) | (devId & 7);
+	rec[len++] = reg;
+	rec[len++] = data;
+	// LEB128: most register accesses are less than 128us apart
+	do {
+		rec[len] = delta & 0x7F;
+		delta >>= 7;
+		if (delta)
+			rec[len] |= 0x80;
+		len++;
+	} while (delta);
+
+	fwrite(rec, 1, len, traceFile);
+}
+
+int bustraceOpen(const char *path, int backend){
+	uint8_t header[8];
+
+	traceFile = fopen(path, "wb");
+	if (traceFile == NULL){
+		perror("bustrace");
+		return -1;
+	}
+
+	traceBuffer = malloc(TRACE_BUFFER_SIZE);
+	if (traceBuffer)
+		setvbuf(traceFile, traceBuffer, _IOFBF, TRACE_BUFFER_SIZE);
+
+	memcpy(header, BUSTRACE_MAGIC, 4);
+	header[4] = BUSTRACE_VERSION;
+	header[5] = (uint8_t)backend;
+	header[6] = 0;
+	header[7] = 0;
+	fwrite(header, 1, sizeof(header), traceFile);
+
+	clock_gettime(CLOCK_MONOTONIC, &lastStamp);
+	return 0;
+}
+
+void bustraceClose(void){
+	if (traceFile == NULL)
+		return;
+
+	fclose(traceFile);
+	traceFile = NULL;
+	free(traceBuffer);
+	traceBuffer = NULL;
+}
+
+int bustraceActive(void){
+	return traceFile != NULL;
+}
+
+void bustraceWrite(uint8_t devId, uint8_t reg, uint8_t data){
+	putRecord(BT_WRITE, devId, reg, data);
+}
+
+void bustraceRead(uint8_t devId, uint8_t reg, uint8_t data){
+	putRecord(BT_READ, devId, reg, data);
+}
+
+void bustraceMark(uint8_t tag, uint8_t value){
+	putRecord(BT_MARK, 0, tag, value);
+}
+
+int bustraceReadHeader(FILE *fptr, struct bustraceHeader *hdr){
+	uint8_t header[8];
+
+	if (fread(header, sizeof(header), 1, fptr) != 1)
+		return -1;
+	if (memcmp(header, BUSTRACE_MAGIC, 4) != 0)
+		return -1;
+	if (header[4] != BUSTRACE_VERSION){
+		fprintf(stderr, "Unsupported trace version %d\n", header[4]);
+		return -1;
+	}
+
+	hdr->version = header[4];
+	hdr->backend = header[5];
+	return 0;
+}
+
+int bustraceNext(FILE *fptr, struct bustraceRecord *rec){
+	uint8_t head[3];
+	size_t got;
+	int c, shift = 0;
+
+	got = fread(head, 1, 3, fptr);
+	if (got == 0 && feof(fptr))
+		return 0;
+	if (got != 3)
+		return -1;
+
+	rec->op = head[0] >> 4;
+	rec->devId = 0x20 | (head[0] & 7);
+	rec->reg = head[1];
+	rec->data = head[2];
+	rec->delta_us = 0;
+
+	do {
+		c = fgetc(fptr);
+		if (c == EOF || shift > 28)
+			return -1;
+		rec->delta_us |= (uint32_t)(c & 0x7F) << shift;
+		shift += 7;
+	} while (c & 0x80);
+
+	return 1;
+}
@@ -0,0 +1,68 @@
+/*
+ * bustrace.h:
+ *      Compact binary recording of the expander register traffic
+ *      generated by the cart reader.
+ *
+ * A trace starts with an 8 byte header:
+ *
+ *   "SNTR" | version | backend | 2 reserved bytes
+ *
+ * followed by one record per register access:
+ *
+ *   op << 4 | (devId & 7) | reg | data | delta-time (LEB128, microseconds)
+ *
+ * The device is stored as the MCP23x17 hardware address (0x20 + A2..A0),
+ * so SPI, I2C and GPIO flip-flop traffic all map onto the same three
+ * logical chips and can be replayed or diffed against each other.
+ ***********************************************************************
+ */
+
+#ifndef _bustrace_h__
+#define _bustrace_h__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define BUSTRACE_MAGIC		"SNTR"
+#define BUSTRACE_VERSION	1
+
+/* record operations */
+#define BT_WRITE	0
+#define BT_READ		1
+#define BT_MARK		2	// free form marker, reg/data carry the tag
+
+/* backend that produced the trace */
+#define BT_BACKEND_SPI	0
+#define BT_BACKEND_GPIO	1
+#define BT_BACKEND_I2C	2
+
+struct bustraceHeader {
+	uint8_t version;
+	uint8_t backend;
+};
+
+struct bustraceRecord {
+	uint8_t op;
+	uint8_t devId;		// 0x20 - 0x27
+	uint8_t reg;
+	uint8_t data;
+	uint32_t delta_us;	// time elapsed since the previous record
+};
+
+/* Recording side. Every call is a no-op until bustraceOpen() succeeds,
+ * so the hooks can stay in the bus functions unconditionally. */
+int bustraceOpen(const char *path, int backend);
+void bustraceClose(void);
+int bustraceActive(void);
+void bustraceWrite(uint8_t devId, uint8_t reg, uint8_t data);
+void bustraceRead(uint8_t devId, uint8_t reg, uint8_t data);
+void bustraceMark(uint8_t tag, uint8_t value);
+
+/* Reading side, used by trace_replay.
+ * bustraceReadHeader returns 0 on success, -1 if the file is not a trace.
+ * bustraceNext returns 1 when a record was read, 0 at end of file and
+ * -1 on a truncated record. */
+int bustraceReadHeader(FILE *fptr, struct bustraceHeader *hdr);
+int bustraceNext(FILE *fptr, struct bustraceRecord *rec);
+
+#endif // _bustrace_h__
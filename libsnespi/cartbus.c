@@ -0,0 +1,612 @@
+/*
+ * cartbus.c:
+ *      Expander level access to the cart bus, shared by cart_reader and
+ *      libsnespi. Talks to the MCP23S17 board over SPI, the MCP23017
+ *      board over I2C or the flip-flop board over GPIO.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <wiringPi.h>
+#include <mcp23s17.h>
+#include <stdint.h>
+#include "wiringPiSPI.h"
+#include "cartbus.h"
+#include "bustrace.h"
+#include "i2cbus.h"
+#include "rt.h"
+
+#define BASE    123
+
+static rt_hist histRead = RT_HIST_INIT("cart readData");
+static rt_hist histWrite = RT_HIST_INIT("cart writeByte");
+static rt_hist histStrobe = RT_HIST_INIT("cart writeFlipflops");
+
+int16_t currentBank = -1;
+uint32_t LowByteWrites = 0;
+uint32_t HighByteWrites = 0;
+uint32_t BankWrites = 0;
+uint32_t DataReads = 0;
+int useSPI = 1;
+int useI2C = 0;
+int currentDataDir = 1;
+
+#define      CMD_WRITE       0x40
+#define CMD_READ     0x41
+/*
+ * writeByte:
+ *	Write a byte to a register on the MCP23s17 on the SPI bus, or on the
+ *	MCP23017 on the I2C bus.
+ *********************************************************************************
+ */
+
+void writeByte (uint8_t spiPort, uint8_t devId, uint8_t reg, uint8_t data)
+{
+  uint8_t spiData [4] ;
+  uint64_t start = rt_stamp () ;
+
+  if (useI2C)
+  {
+    i2cbusWrite (devId, reg, data) ;
+    bustraceWrite (devId, reg, data) ;
+    return ;
+  }
+
+  spiData [0] = CMD_WRITE | ((devId & 7) << 1) ;
+  spiData [1] = reg ;
+  spiData [2] = data ;
+
+  wiringPiSPIDataRW (spiPort, spiData, 3) ;
+  rt_record (&histWrite, start) ;
+  bustraceWrite (devId, reg, data) ;
+}
+
+/*
+ * writeWord:
+ *	Write reg and reg + 1 in one sequential mode transfer (IOCON.SEQOP = 0,
+ *	the power-on default). Used to set both address ports at once.
+ *********************************************************************************
+ */
+
+void writeWord (uint8_t spiPort, uint8_t devId, uint8_t reg, uint8_t first, uint8_t second)
+{
+  uint8_t spiData [4] ;
+
+  if (useI2C)
+    i2cbusWrite2 (devId, reg, first, second) ;
+  else
+  {
+    spiData [0] = CMD_WRITE | ((devId & 7) << 1) ;
+    spiData [1] = reg ;
+    spiData [2] = first ;
+    spiData [3] = second ;
+
+    wiringPiSPIDataRW (spiPort, spiData, 4) ;
+  }
+  bustraceWrite (devId, reg, first) ;
+  bustraceWrite (devId, reg + 1, second) ;
+}
+
+/*
+ * readByte:
+ *	Read a byte from a register on the MCP23s17 on the SPI bus. On the I2C
+ *	bus any queued writes go out in the same transaction.
+ *********************************************************************************
+ */
+
+uint8_t readByte (uint8_t spiPort, uint8_t devId, uint8_t reg){
+  uint8_t spiData [4] ;
+
+  if (useI2C)
+  {
+    spiData [2] = i2cbusRead (devId, reg) ;
+    bustraceRead (devId, reg, spiData [2]) ;
+    return spiData [2] ;
+  }
+
+  spiData [0] = CMD_READ | ((devId & 7) << 1) ;
+  spiData [1] = reg ;
+
+  wiringPiSPIDataRW (spiPort, spiData, 3) ;
+  bustraceRead (devId, reg, spiData [2]) ;
+
+  return spiData [2] ;
+}
+
+uint8_t readData(void){
+	DataReads++;
+	uint8_t data = 0;
+	uint64_t start = rt_stamp();
+	
+	if (useSPI == 1){
+		data = readByte (0, _SNESBankAndData, GPIOB); // SNESBankAndData._readRegister(GPIOB);
+		rt_record(&histRead, start);
+		return data;
+	}
+	//use GPIO
+	else{
+		//delayMicroseconds(10);
+		
+		if (digitalRead (GPIO_DATA_7) )
+			data = data| 0x80;
+		delayMicroseconds(4);
+		if (digitalRead (GPIO_DATA_6) )
+			data = data| 0x40;
+		delayMicroseconds(4);
+		if (digitalRead (GPIO_DATA_5) )
+			data = data| 0x20;
+		delayMicroseconds(4);		
+		if (digitalRead (GPIO_DATA_4) )
+			data = data| 0x10;
+		delayMicroseconds(4);		
+		if (digitalRead (GPIO_DATA_3) )
+			data = data| 0x08;
+		delayMicroseconds(4);		
+		if (digitalRead (GPIO_DATA_2) )
+			data = data| 0x04;
+		delayMicroseconds(4);		
+		if (digitalRead (GPIO_DATA_1) )
+			data = data| 0x02;
+		delayMicroseconds(4);		
+		if (digitalRead (GPIO_DATA_0) )
+			data = data| 0x01;
+		delayMicroseconds(4);		
+
+		rt_record(&histRead, start);
+		bustraceRead(_SNESBankAndData, GPIOB, data);
+		return data;		
+	}
+}
+
+void gotoAddr(int32_t addr, int isLowROM){
+	static int32_t currentAddr = -1;
+	static int32_t currentUpByte = -1;
+	static int32_t currentLowByte = -1;
+	uint16_t upByte;
+	uint16_t lowByte;
+	
+	if (addr <= 0xffff){
+		upByte = (uint8_t)(addr/256);
+		lowByte = (uint8_t)(addr - (upByte * 256));
+		currentAddr = addr;
+	
+  
+		if (isLowROM != 0){
+			upByte = (upByte | 0x80); // ORs a 1 to A15 if LoROM
+		}
+
+		// both ports in one transfer, GPIOA (low) then GPIOB (high)
+		if (useSPI == 1 && currentUpByte != upByte && currentLowByte != lowByte){
+			writeWord (0, _SNESAddressPins, GPIOA, lowByte, upByte);
+			currentUpByte = upByte;
+			currentLowByte = lowByte;
+			HighByteWrites++;
+			LowByteWrites++;
+		}
+
+		if (currentUpByte != upByte){
+			
+			if (useSPI == 1){
+				writeByte (0, _SNESAddressPins, GPIOB, upByte); //SNESAddressPins._writeRegister(GPIOB,upByte);			
+			}
+			//use GPIO
+			else{
+				
+				writeFlipflops(upByte, GPIO_TRIG_HIGH_ADDR);
+				
+			}
+			
+			currentUpByte = upByte;
+			HighByteWrites++;
+		}
+   
+		if (currentLowByte != lowByte){
+			if (useSPI ==1){
+				writeByte (0, _SNESAddressPins, GPIOA, lowByte);//SNESAddressPins._writeRegister(GPIOA,lowByte)
+			}
+			//use GPIO
+			else{
+				
+				writeFlipflops(lowByte, GPIO_TRIG_LOW_ADDR);
+				
+			}
+			
+			currentLowByte = lowByte;  
+			LowByteWrites++;
+		}
+	}
+	
+	else{
+		
+		if (useSPI == 1){
+			writeWord (0, _SNESAddressPins, GPIOA, 0x00, 0x00);//SNESAddressPins._writeRegister(GPIOA,0x00) + (GPIOB,0x00)
+		}
+		//use GPIO
+		else{
+				
+				writeFlipflops(0x00, GPIO_TRIG_LOW_ADDR);
+				writeFlipflops(0x00, GPIO_TRIG_HIGH_ADDR);
+				
+		}
+		
+		currentAddr = 0;
+ }
+		
+	
+}
+
+void gotoBank(uint8_t bank){
+	//static int16_t currentBank = -1;
+	
+	if (bank != currentBank){
+		
+		if (useSPI == 1){
+			writeByte (0, _SNESBankAndData, GPIOA, bank);//SNESBankAndData._writeRegister(GPIOA,bank)
+		}
+		//use GPIO
+		else{
+				
+				writeFlipflops(bank, GPIO_TRIG_BANK);
+			
+		}
+		currentBank = bank;
+		BankWrites++;
+	}
+	
+}
+
+uint8_t readAddr(int32_t addr, int isLowROM){
+	gotoAddr(addr,isLowROM); 
+	return readData();	
+}
+
+uint8_t readAddrBank(int32_t addr, uint8_t bank){
+	gotoBank(bank); 
+	gotoAddr(addr,0);
+	return readData();
+}
+ 
+void gotoOffset(uint32_t offset,int isLowROM){
+	//static uint32_t currentOffset = 0;
+	//	printf("Forth\n");
+	uint8_t bank = 0;
+	uint32_t addr = 0;
+
+	if (isLowROM == 0){
+		bank = (uint8_t)( offset / 65536); //64Kilobyte pages
+		addr = offset - (bank * 65536); //64kilobyte pages
+	}
+
+	else{
+		bank = (uint8_t)( offset / 32768); //32kilobyte pages
+		addr = offset - (bank * 32768); //32kilobyte pages
+	}
+    //printf("Fifth\n");
+	gotoBank(bank);
+	gotoAddr(addr,isLowROM);
+  //  printf("BANK: %d, ADDR: %d\n",bank, addr);
+	//currentOffset = offset;
+}
+
+uint8_t readOffset(uint32_t offset,int isLowROM){
+	//printf("Seventh\n");
+	gotoOffset(offset,isLowROM);
+	return readData();
+}
+
+void readOffsets(uint32_t offset, int isLowROM, uint8_t *dest, uint32_t length){
+	uint32_t i;
+
+	for (i = 0; i < length; i++)
+		dest[i] = readOffset(offset + i, isLowROM);
+}
+
+// SRAM sits at $70:0000-$7FFF on LoROM carts (/CS asserted) and at
+// $30:6000-$7FFF on HiROM carts (/CS high), continuing in the next banks.
+static void SRAMlayout(int isLowROM, uint8_t *startBank, int32_t *startAddr, uint8_t *controls){
+	if (isLowROM == 1){
+		*startBank = 0x70;
+		*startAddr = 0x0000;
+		*controls = _CS + _POWER;
+	}
+	else{
+		*startBank = 0x30;
+		*startAddr = 0x6000;
+		*controls = _POWER;
+	}
+}
+
+void readSRAM(int isLowROM, uint8_t *dest, uint32_t length){
+	uint8_t bank, controls;
+	int32_t startAddr, addr;
+	uint32_t i;
+
+	SRAMlayout(isLowROM, &bank, &startAddr, &controls);
+	setIOControl(_RD + controls);
+
+	addr = startAddr;
+	for (i = 0; i < length; i++){
+		dest[i] = readAddrBank(addr, bank);
+		if (++addr > 0x7FFF){
+			bank++;
+			addr = startAddr;
+		}
+	}
+
+	setIOControl(_RD + _CS + _POWER);
+}
+
+void writeSRAM(int isLowROM, const uint8_t *src, uint32_t length){
+	uint8_t bank, controls;
+	int32_t startAddr, addr;
+	uint32_t i;
+
+	SRAMlayout(isLowROM, &bank, &startAddr, &controls);
+	setIOControl(controls);
+	writeByte (0, _SNESBankAndData, GPPUB, 0x00);
+	changeDataDir(0);
+
+	// one /WR strobe per byte, address and data are stable before it falls
+	addr = startAddr;
+	for (i = 0; i < length; i++){
+		gotoBank(bank);
+		gotoAddr(addr, 0);
+		if (useSPI == 1)
+			writeByte (0, _SNESBankAndData, GPIOB, src[i]);
+		else
+			writeFlipflops(src[i], GPIO_TRIG_DATA_OUT);
+		setIOControl(_WR + controls);
+		setIOControl(controls);
+		if (++addr > 0x7FFF){
+			bank++;
+			addr = startAddr;
+		}
+	}
+
+	changeDataDir(1);
+	writeByte (0, _SNESBankAndData, GPPUB, 0xFF);
+	setIOControl(_RD + _CS + _POWER);
+}
+ 
+
+void changeDataDir(int direction){
+	if (useSPI == 1){
+	
+		if (direction == 1){
+			writeByte (0, _SNESBankAndData, IODIRB, 0xFF);
+			currentDataDir = 1;
+		}
+		
+		else{		
+			writeByte (0, _SNESBankAndData, IODIRB, 0x00);//SNESBankAndData._writeRegister(IODIRB,0x00) # Set MCP bank B to outputs  (SNES Data 0-7)
+			currentDataDir = 0;
+		}
+		
+	}
+	else{
+		
+		//TO DO -------------------------------------------------------------------------------------------------------
+		if (direction == 1){
+			currentDataDir = 1;
+		    digitalWrite(GPIO_OE_DATA_OUT, 1);//disable
+			bustraceWrite(_SNESBankAndData, IODIRB, 0xFF);
+			
+		}
+		
+		else{		
+			
+			currentDataDir = 0;
+			digitalWrite(GPIO_OE_DATA_OUT, 0);//enable
+			bustraceWrite(_SNESBankAndData, IODIRB, 0x00);
+		}
+		
+	}
+	
+	
+}
+
+void setIOControl(uint8_t IOControls){
+/*
+# GPA0: /RD
+# GPA1: /RESET
+# GPA2: /WR
+# GPA3: /CS
+# GPA4: CART MOSFET
+# GPA7: /IRQ 
+*/	
+
+//Inverses Control Bits. Bits are pulled low to enable
+IOControls = IOControls ^ 0x0F; 
+
+if (useSPI == 1){
+	
+	//Inverses Power (pull mosfet low to enable)
+	IOControls = IOControls ^ _POWER;
+	writeByte (0, _IOControls, GPIOA, IOControls);
+}
+//else use direct GPIO
+else{
+				
+	writeFlipflops(IOControls, GPIO_TRIG_CTRL);
+				
+}
+	
+}
+
+void initInterface_SPI(void){
+	
+	useSPI = 1;
+	
+	wiringPiSetup () ;
+	mcp23s17Setup (BASE, 0, _IOControls) ;
+	mcp23s17Setup (BASE+100, 0,_SNESAddressPins) ;
+	mcp23s17Setup (BASE+200, 0, _SNESBankAndData) ;
+	
+	initExpanders();
+}
+
+void initInterface_I2C(int busNumber){
+	
+	useSPI = 1; // same register level access as the SPI board
+	useI2C = 1;
+	
+	if (i2cbusOpen(busNumber) < 0)
+		exit(1);
+	
+	initExpanders();
+	i2cbusFlush();
+}
+
+// Register setup shared by the SPI (MCP23S17) and I2C (MCP23017) boards
+void initExpanders(void){
+	
+	writeByte (0, _IOControls, IOCON_B, 0x08);//IOControls._writeRegister(IOCON_B,0x08)
+
+	writeByte (0, _SNESAddressPins, IODIRA, 0x00);//SNESAddressPins._writeRegister(IODIRA,0x00) # Set MCP bank A to outputs (SNES Addr 0-7)
+	writeByte (0, _SNESAddressPins, IODIRB, 0x00);//SNESAddressPins._writeRegister(IODIRB,0x00) # Set MCP bank B to outputs (SNES Addr 8-15)
+
+	writeByte (0, _SNESBankAndData, IODIRA, 0x00);//SNESBankAndData._writeRegister(IODIRA,0x00) # Set MCP bank A to outputs (SNES Bank 0-7)
+	changeDataDir(1);//writeByte (0, _SNESBankAndData, IODIRB, 0xFF);//SNESBankAndData._writeRegister(IODIRB,0xFF) # Set MCP bank B to inputs  (SNES Data 0-7)
+
+	writeByte (0, _SNESBankAndData, GPPUB, 0xFF);//SNESBankAndData._writeRegister(GPPUB,0xFF) # Enables Pull-Up Resistors on MCP SNES Data 0-7		
+	
+	writeByte (0, _IOControls, IODIRA, 0x80);//IOControls._writeRegister(IODIRA,0x80) # Set MCP bank A to outputs; WITH EXCEPTION TO IRQ
+	writeByte (0, _IOControls, IODIRB, 0x00);//IOControls._writeRegister(IODIRB,0x00) # Set MCP bank B to outputs 
+
+}
+
+void initInterface_GPIO(void){
+	useSPI = 0;
+	
+	wiringPiSetup();
+	pinMode(GPIO_DATA_DIR, OUTPUT);
+	digitalWrite(GPIO_DATA_DIR, 0);//set up DATA pins as inputs
+	
+	pinMode(GPIO_DATA_0, INPUT);
+	pinMode(GPIO_DATA_1, INPUT);
+	pinMode(GPIO_DATA_2, INPUT);
+	pinMode(GPIO_DATA_3, INPUT);
+	pinMode(GPIO_DATA_4, INPUT);
+	pinMode(GPIO_DATA_5, INPUT);
+	pinMode(GPIO_DATA_6, INPUT);
+	pinMode(GPIO_DATA_7, INPUT);
+	
+	pinMode(GPIO_OUT_0, OUTPUT);
+    pinMode(GPIO_OUT_1, OUTPUT);
+    pinMode(GPIO_OUT_2, OUTPUT);
+    pinMode(GPIO_OUT_3, OUTPUT);
+    pinMode(GPIO_OUT_4, OUTPUT);
+    pinMode(GPIO_OUT_5, OUTPUT);
+    pinMode(GPIO_OUT_6, OUTPUT);
+    pinMode(GPIO_OUT_7, OUTPUT);
+	
+	pinMode(GPIO_TRIG_BANK, OUTPUT);
+    pinMode(GPIO_TRIG_CTRL, OUTPUT);
+    pinMode(GPIO_TRIG_DATA_OUT, OUTPUT);
+    pinMode(GPIO_TRIG_HIGH_ADDR, OUTPUT);
+    pinMode(GPIO_TRIG_LOW_ADDR, OUTPUT);
+	
+	digitalWrite(GPIO_TRIG_BANK, 0);
+	digitalWrite(GPIO_TRIG_CTRL, 0);
+	digitalWrite(GPIO_TRIG_DATA_OUT, 0);
+	digitalWrite(GPIO_TRIG_HIGH_ADDR, 0);
+	digitalWrite(GPIO_TRIG_LOW_ADDR, 0);	
+	
+	pinMode(GPIO_OE_CTRL, OUTPUT);
+	digitalWrite(GPIO_OE_CTRL, 0);
+	
+	pinMode(GPIO_OE_DATA_OUT, OUTPUT);
+	digitalWrite(GPIO_OE_DATA_OUT, 1);
+	//changeDataDir(1);
+	
+	delayMicroseconds(100);
+	
+}
+
+void shutdownInterface_SPI(void){
+	
+	gotoAddr(00,0);
+	gotoBank(00);
+
+	writeByte (0, _SNESBankAndData, GPPUB, 0x00);//SNESBankAndData._writeRegister(GPPUB,0x00) # Disables Pull-Up Resistors on MCP SNES Data 0-7
+	writeByte (0, _SNESBankAndData, DEFVALB, 0xFF);//SNESBankAndData._writeRegister(DEFVALB,0xFF) # Expect MCP SNES Data 0-7 to default to 0xFF
+	writeByte (0, _SNESBankAndData, GPINTENB, 0x00);//SNESBankAndData._writeRegister(GPINTENB,0x00) # Sets up all of SNES Data 0-7 to be interrupt disabled
+
+	writeByte (0, _SNESAddressPins, IODIRA, 0xFF);//SNESAddressPins._writeRegister(IODIRA,0xFF) # Set MCP bank A to outputs (SNES Addr 0-7)
+	writeByte (0, _SNESAddressPins, IODIRB, 0xFF);//SNESAddressPins._writeRegister(IODIRB,0xFF) # Set MCP bank B to outputs (SNES Addr 8-15)
+
+	writeByte (0, _SNESBankAndData, IODIRA, 0xFF);//SNESBankAndData._writeRegister(IODIRA,0xFF) # Set MCP bank A to outputs (SNES Bank 0-7)
+	changeDataDir(1);//writeByte (0, _SNESBankAndData, IODIRB, 0xFF);//SNESBankAndData._writeRegister(IODIRB,0xFF) # Set MCP bank B to inputs (SNES Data 0-7)
+
+	writeByte (0, _IOControls, IODIRA, 0xEF);//IOControls._writeRegister(IODIRA,0xEF) # Set MCP bank A to inputs; WITH EXCEPTION TO MOSFET
+
+	setIOControl(0); //writeByte (0, _IOControls, GPIOA, 0x10);//IOControls._writeRegister(GPIOA,0x10) #Turn off MOSFET	
+	
+}
+
+void shutdownInterface_I2C(void){
+	shutdownInterface_SPI();
+	i2cbusClose();
+}
+
+void shutdownInterface_GPIO(void){
+	setIOControl(0);
+	gotoAddr(0,0);
+	gotoBank(0);
+	digitalWrite(GPIO_OE_CTRL, 1);//Turn Off Flip flops
+	digitalWrite(GPIO_OE_DATA_OUT, 1);
+
+}
+
+void writeFlipflops(uint8_t dataOut,int clkTrigger){
+	
+int i = 0;
+int bits[8] = {0};
+uint64_t start = rt_stamp();
+
+for (i=0;i<8;i++)
+ if( (dataOut & (1<<i) ) == (1<<i) )
+   bits[i] = 1;   
+
+digitalWrite(GPIO_OUT_0, bits[0]); 
+digitalWrite(GPIO_OUT_1, bits[1]);
+digitalWrite(GPIO_OUT_2, bits[2]);
+digitalWrite(GPIO_OUT_3, bits[3]);
+digitalWrite(GPIO_OUT_4, bits[4]);
+digitalWrite(GPIO_OUT_5, bits[5]);
+digitalWrite(GPIO_OUT_6, bits[6]);
+digitalWrite(GPIO_OUT_7, bits[7]);
+
+//delayMicroseconds(4000);	
+digitalWrite(clkTrigger, 1);
+delayMicroseconds(100);//for (i=0;i<85000;i++);
+digitalWrite(clkTrigger, 0);
+//delayMicroseconds(5);
+
+rt_record(&histStrobe, start);
+
+traceFlipflops(dataOut, clkTrigger);
+	
+}
+
+// Records a flip-flop strobe as the expander register it replaces, so
+// GPIO traces can be replayed and diffed against SPI ones.
+void traceFlipflops(uint8_t dataOut,int clkTrigger){
+	
+	if (!bustraceActive())
+		return;
+	
+	switch (clkTrigger){
+		case GPIO_TRIG_LOW_ADDR:  bustraceWrite(_SNESAddressPins, GPIOA, dataOut); break;
+		case GPIO_TRIG_HIGH_ADDR: bustraceWrite(_SNESAddressPins, GPIOB, dataOut); break;
+		case GPIO_TRIG_BANK:      bustraceWrite(_SNESBankAndData, GPIOA, dataOut); break;
+		case GPIO_TRIG_DATA_OUT:  bustraceWrite(_SNESBankAndData, GPIOB, dataOut); break;
+		// the MOSFET gate is inverted in hardware on the flip-flop board
+		case GPIO_TRIG_CTRL:      bustraceWrite(_IOControls, GPIOA, dataOut ^ _POWER); break;
+	}
+	
+}
+
+
+
@@ -0,0 +1,114 @@
+/*
+ * cartbus.h:
+ *      Expander level access to the cart bus, shared by cart_reader and
+ *      libsnespi. Talks to the MCP23S17 board over SPI, the MCP23017
+ *      board over I2C or the flip-flop board over GPIO.
+ ***********************************************************************
+ */
+
+#ifndef _cartbus_h__
+#define _cartbus_h__
+
+#include <stdint.h>
+
+// ------------ Setup Register Definitions ------------------------------------------
+
+#define GPIO_OUT_0 4
+#define GPIO_OUT_1 3
+#define GPIO_OUT_2 2
+#define GPIO_OUT_3 1
+#define GPIO_OUT_4 0
+#define GPIO_OUT_5 7
+#define GPIO_OUT_6 9
+#define GPIO_OUT_7 8
+
+#define GPIO_DATA_DIR 14
+#define GPIO_DATA_0 29
+#define GPIO_DATA_1 28
+#define GPIO_DATA_2 25
+#define GPIO_DATA_3 27
+#define GPIO_DATA_4 26
+#define GPIO_DATA_5 11
+#define GPIO_DATA_6 6
+#define GPIO_DATA_7 5
+
+
+#define GPIO_TRIG_DATA_OUT 12
+#define GPIO_OE_DATA_OUT 13
+
+#define GPIO_TRIG_HIGH_ADDR 21
+#define GPIO_TRIG_LOW_ADDR 22
+#define GPIO_TRIG_BANK 23
+#define GPIO_TRIG_CTRL 24
+
+#define GPIO_OE_CTRL 10
+
+
+
+#define _SNESAddressPins 0x20 // MCP23017 Chip with SNES Address Pins
+#define _SNESBankAndData 0x22 // MCP23017 Chip with SNES Bank and Data
+#define _IOControls 0x23        // MCP23017 Chip to control SNES IO Controls including MOSFET Power
+
+#define IODIRA 0X00
+#define IODIRB 0X01
+#define GPIOA 0X12
+#define GPIOB 0X13
+#define GPINTENB 0x05
+#define DEFVALB 0x07
+#define INTCONB 0x09
+#define IOCON_B 0x0B
+#define GPPUB 0x0D
+
+/*
+# GPA0: /RD
+# GPA1: /RESET
+# GPA2: /WR
+# GPA3: /CS
+# GPA4: CART MOSFET
+# GPA7: /IRQ 
+*/	
+
+#define _RD    0b00000001
+#define _RESET 0b00000010
+#define _WR    0b00000100
+#define _CS    0b00001000
+#define _POWER 0b00010000
+
+
+extern int16_t currentBank;
+extern uint32_t LowByteWrites;
+extern uint32_t HighByteWrites;
+extern uint32_t BankWrites;
+extern uint32_t DataReads;
+extern int useSPI;
+extern int useI2C;
+extern int currentDataDir;
+
+void writeByte(uint8_t spiPort, uint8_t devId, uint8_t reg, uint8_t data);
+void writeWord(uint8_t spiPort, uint8_t devId, uint8_t reg, uint8_t first, uint8_t second);
+uint8_t readByte(uint8_t spiPort, uint8_t devId, uint8_t reg);
+
+uint8_t readData(void);
+void gotoAddr(int32_t, int);
+void gotoBank(uint8_t);
+uint8_t readAddr(int32_t, int);
+uint8_t readAddrBank(int32_t, uint8_t);
+void gotoOffset(uint32_t,int);
+uint8_t readOffset(uint32_t,int);
+void readOffsets(uint32_t, int, uint8_t *, uint32_t);
+void readSRAM(int, uint8_t *, uint32_t);
+void writeSRAM(int, const uint8_t *, uint32_t);
+void setIOControl(uint8_t );
+void changeDataDir(int direction);
+
+void initInterface_SPI(void);
+void initInterface_I2C(int);
+void initInterface_GPIO(void);
+void initExpanders(void);
+void shutdownInterface_SPI(void);
+void shutdownInterface_I2C(void);
+void shutdownInterface_GPIO(void);
+void writeFlipflops(uint8_t,int);
+void traceFlipflops(uint8_t,int);
+
+#endif // _cartbus_h__
@@ -0,0 +1,176 @@
+/*
+ * i2cbus.c:
+ *      Native /dev/i2c-N access to the MCP23017 expanders of the I2C
+ *      cart reader boards. See i2cbus.h.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "i2cbus.h"
+
+// The kernel accepts up to I2C_RDWR_IOCTL_MAX_MSGS (42) messages per
+// call. Two are kept free for the register read that ends a set.
+#define MAX_QUEUED_WRITES 32
+
+static int i2cFd = -1;
+static struct i2c_msg queue[MAX_QUEUED_WRITES + 2];
+static uint8_t queueData[MAX_QUEUED_WRITES + 1][3];
+static int queued = 0;
+static int reportedError = 0;
+
+int i2cbusOpen(int busNumber){
+	char path[32];
+
+	snprintf(path, sizeof(path), "/dev/i2c-%d", busNumber);
+	i2cFd = open(path, O_RDWR);
+	if (i2cFd < 0){
+		perror(path);
+		return -1;
+	}
+
+	queued = 0;
+	reportedError = 0;
+	return 0;
+}
+
+void i2cbusClose(void){
+	if (i2cFd < 0)
+		return;
+
+	i2cbusFlush();
+	close(i2cFd);
+	i2cFd = -1;
+}
+
+// Sends the queued writes, followed by the read described by the last
+// two messages when withRead is set. The kernel issues a repeated start
+// between messages, so the whole set is one bus transaction.
+static int transfer(int withRead){
+	struct i2c_rdwr_ioctl_data set;
+	int res;
+
+	set.msgs = queue;
+	set.nmsgs = queued + (withRead ? 2 : 0);
+	if (set.nmsgs == 0)
+		return 0;
+
+	res = ioctl(i2cFd, I2C_RDWR, &set);
+	queued = 0;
+
+	if (res < 0){
+		// a missing cart or loose cable fails every transfer, say it once
+		if (!reportedError)
+			perror("I2C_RDWR");
+		reportedError = 1;
+		return -1;
+	}
+	return 0;
+}
+
+static void queueWrite(uint8_t devId, uint8_t *data, int len){
+	if (queued == MAX_QUEUED_WRITES)
+		transfer(0);
+
+	memcpy(queueData[queued], data, len);
+	queue[queued].addr = devId;
+	queue[queued].flags = 0;
+	queue[queued].len = len;
+	queue[queued].buf = queueData[queued];
+	queued++;
+}
+
+void i2cbusWrite(uint8_t devId, uint8_t reg, uint8_t data){
+	uint8_t msg[2] = { reg, data };
+
+	queueWrite(devId, msg, 2);
+}
+
+void i2cbusWrite2(uint8_t devId, uint8_t reg, uint8_t first, uint8_t second){
+	uint8_t msg[3] = { reg, first, second };
+
+	queueWrite(devId, msg, 3);
+}
+
+uint8_t i2cbusRead(uint8_t devId, uint8_t reg){
+	uint8_t value = 0xFF;
+
+	// register pointer write, then the data byte after a repeated start
+	queueData[queued][0] = reg;
+	queue[queued].addr = devId;
+	queue[queued].flags = 0;
+	queue[queued].len = 1;
+	queue[queued].buf = queueData[queued];
+
+	queue[queued + 1].addr = devId;
+	queue[queued + 1].flags = I2C_M_RD;
+	queue[queued + 1].len = 1;
+	queue[queued + 1].buf = &value;
+
+	if (transfer(1) < 0)
+		return 0xFF;
+	return value;
+}
+
+int i2cbusFlush(void){
+	if (i2cFd < 0)
+		return -1;
+	return transfer(0);
+}
+
+// Device tree adapters expose the rate as a big endian 32 bit cell,
+// older Raspbian kernels as a module parameter.
+static int configuredRate(int busNumber, uint32_t *rateHz){
+	char path[80];
+	uint8_t cell[4];
+	unsigned long rate;
+	FILE *fptr;
+
+	snprintf(path, sizeof(path), "/sys/class/i2c-adapter/i2c-%d/of_node/clock-frequency", busNumber);
+	fptr = fopen(path, "rb");
+	if (fptr != NULL){
+		if (fread(cell, 1, 4, fptr) == 4){
+			fclose(fptr);
+			*rateHz = (cell[0] << 24) | (cell[1] << 16) | (cell[2] << 8) | cell[3];
+			return 0;
+		}
+		fclose(fptr);
+	}
+
+	fptr = fopen("/sys/module/i2c_bcm2708/parameters/baudrate", "r");
+	if (fptr != NULL){
+		if (fscanf(fptr, "%lu", &rate) == 1){
+			fclose(fptr);
+			*rateHz = (uint32_t)rate;
+			return 0;
+		}
+		fclose(fptr);
+	}
+
+	return -1;
+}
+
+int i2cbusCheckRate(int busNumber, uint32_t rateHz){
+	uint32_t current;
+
+	if (configuredRate(busNumber, &current) < 0){
+		printf("Could not determine the I2C clock of bus %d, assuming %u Hz\n", busNumber, rateHz);
+		return -1;
+	}
+
+	if (current == rateHz){
+		printf("I2C bus %d clock: %u Hz\n", busNumber, current);
+		return 0;
+	}
+
+	printf("I2C bus %d is clocked at %u Hz, %u Hz was requested.\n", busNumber, current, rateHz);
+	printf("Add \"dtparam=i2c_arm_baudrate=%u\" to /boot/config.txt and reboot.\n", rateHz);
+	return 1;
+}
@@ -0,0 +1,42 @@
+/*
+ * i2cbus.h:
+ *      Native /dev/i2c-N access to the MCP23017 expanders of the I2C
+ *      cart reader boards.
+ *
+ * Register writes are queued and sent together with the next register
+ * read as a single I2C_RDWR message set, so the usual "set low address,
+ * read data" step of a rip costs one kernel call instead of three
+ * smbus transactions. Both ports of a chip can be written in one
+ * message using the MCP23017 sequential mode (IOCON.SEQOP = 0, BANK = 0,
+ * the power-on default).
+ ***********************************************************************
+ */
+
+#ifndef _i2cbus_h__
+#define _i2cbus_h__
+
+#include <stdint.h>
+
+// Opens /dev/i2c-<busNumber>. Returns 0 on success, -1 on error.
+int i2cbusOpen(int busNumber);
+// Sends any queued writes and closes the bus.
+void i2cbusClose(void);
+
+// Compares the SCL rate configured for the adapter with rateHz and
+// explains how to change it when they differ. The rate is set by the
+// device tree on the Pi, userspace cannot change it.
+// Returns 0 if the rate matches, 1 if it differs and -1 if unknown.
+int i2cbusCheckRate(int busNumber, uint32_t rateHz);
+
+// Queued register writes. i2cbusWrite2 writes reg and reg + 1 in a
+// single sequential-mode transfer.
+void i2cbusWrite(uint8_t devId, uint8_t reg, uint8_t data);
+void i2cbusWrite2(uint8_t devId, uint8_t reg, uint8_t first, uint8_t second);
+
+// Reads a register. Pending writes go out in the same I2C_RDWR call.
+uint8_t i2cbusRead(uint8_t devId, uint8_t reg);
+
+// Sends pending writes now. Returns 0 on success, -1 on error.
+int i2cbusFlush(void);
+
+#endif // _i2cbus_h__
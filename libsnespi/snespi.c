@@ -0,0 +1,240 @@
+/*
+ * snespi.c:
+ *      libsnespi - cart reader and APU access for the SNES-Pi boards.
+ *      Thin stable wrappers around cartbus.c and the hwapu sources.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "snespi.h"
+#include "cartbus.h"
+#include "bustrace.h"
+#include "i2cbus.h"
+
+#include "apu.h"
+#include "apuplay.h"
+#include "spcfile.h"
+#include "apu_mcp23x17.h"
+
+/* apuplay.c and apu.c expect these from apuplay's main.c */
+int g_verbose = 0;
+int g_playing = 1;
+int g_progress = 0;
+int g_debug = 0;
+int g_exit_now = 0;
+int g_upload_mode = UPLOAD_FAST;
+int g_verify = 0;
+
+static int cartBus = -1;
+static char *tracePath = NULL;
+static APU_ops *apu_ops = NULL;
+
+unsigned int snespi_abi_version(void){
+	return SNESPI_ABI_VERSION;
+}
+
+const char *snespi_version_string(void){
+	return "libsnespi 1.1";
+}
+
+static int openTrace(int bus){
+	static const int backends[] = { BT_BACKEND_SPI, BT_BACKEND_I2C, BT_BACKEND_GPIO };
+
+	if (tracePath == NULL || bustraceActive())
+		return 0;
+	return bustraceOpen(tracePath, backends[bus]);
+}
+
+int snespi_cart_open(int bus, int channel){
+	if (cartBus >= 0)
+		snespi_cart_close();
+
+	if (bus < SNESPI_BUS_SPI || bus > SNESPI_BUS_GPIO){
+		fprintf(stderr, "snespi: unknown bus %d\n", bus);
+		return -1;
+	}
+	if (openTrace(bus) < 0)
+		return -1;
+
+	switch (bus){
+		case SNESPI_BUS_SPI:
+			initInterface_SPI();
+			break;
+		case SNESPI_BUS_I2C:
+			useI2C = 1;
+			if (i2cbusOpen(channel) < 0){
+				useI2C = 0;
+				bustraceClose();
+				return -1;
+			}
+			useSPI = 1;
+			initExpanders();
+			break;
+		case SNESPI_BUS_GPIO:
+			initInterface_GPIO();
+			break;
+	}
+
+	// only a bus that is fully set up is driven or shut down later
+	cartBus = bus;
+	return 0;
+}
+
+void snespi_cart_close(void){
+	switch (cartBus){
+		case SNESPI_BUS_SPI:	shutdownInterface_SPI(); break;
+		case SNESPI_BUS_I2C:	shutdownInterface_I2C(); break;
+		case SNESPI_BUS_GPIO:	shutdownInterface_GPIO(); break;
+		default:		return;
+	}
+	useI2C = 0;
+	cartBus = -1;
+	bustraceClose();
+}
+
+int snespi_cart_trace(const char *path){
+	free(tracePath);
+	tracePath = path ? strdup(path) : NULL;
+
+	// already running: the trace starts now instead of at the setup
+	if (cartBus >= 0)
+		return openTrace(cartBus);
+	return 0;
+}
+
+/* the I2C backend queues writes until the next read, a write entry
+ * point returns only once they are on the bus */
+static void flushWrites(void){
+	if (cartBus == SNESPI_BUS_I2C)
+		i2cbusFlush();
+}
+
+void snespi_cart_controls(uint8_t lines){
+	setIOControl(lines);
+	flushWrites();
+}
+
+void snespi_cart_goto_bank(uint8_t bank){
+	gotoBank(bank);
+}
+
+void snespi_cart_goto_addr(int32_t addr, int isLowROM){
+	gotoAddr(addr, isLowROM);
+}
+
+uint8_t snespi_cart_read_data(void){
+	return readData();
+}
+
+uint8_t snespi_cart_read_offset(uint32_t offset, int isLowROM){
+	return readOffset(offset, isLowROM);
+}
+
+int snespi_cart_read(uint32_t offset, int isLowROM, uint8_t *buf, uint32_t length){
+	if (cartBus < 0 || buf == NULL)
+		return -1;
+
+	readOffsets(offset, isLowROM, buf, length);
+	return 0;
+}
+
+int snespi_sram_read(int isLowROM, uint8_t *buf, uint32_t length){
+	if (cartBus < 0 || buf == NULL)
+		return -1;
+
+	readSRAM(isLowROM, buf, length);
+	return 0;
+}
+
+int snespi_sram_write(int isLowROM, const uint8_t *buf, uint32_t length){
+	if (cartBus < 0 || buf == NULL)
+		return -1;
+
+	writeSRAM(isLowROM, buf, length);
+	flushWrites();
+	return 0;
+}
+
+void snespi_cart_write_reg(uint8_t chip, uint8_t reg, uint8_t value){
+	writeByte(0, chip, reg, value);
+	flushWrites();
+}
+
+uint8_t snespi_cart_read_reg(uint8_t chip, uint8_t reg){
+	return readByte(0, chip, reg);
+}
+
+int snespi_apu_open_bus(const char *bus){
+	if (apu_ops != NULL)
+		return 0;
+
+	apu_ops = apu_mcp23x17_getOps();
+	apu_setOps(apu_ops);
+	if (apu_ops->init((char*)(bus ? bus : "")) < 0){
+		apu_ops = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+int snespi_apu_open(void){
+	return snespi_apu_open_bus("");
+}
+
+void snespi_apu_close(void){
+	if (apu_ops == NULL)
+		return;
+
+	apu_ops->shutdown();
+	apu_ops = NULL;
+}
+
+void snespi_apu_reset(void){
+	if (apu_ops != NULL)
+		apu_reset();
+}
+
+uint8_t snespi_apu_read(int port){
+	if (apu_ops == NULL)
+		return 0xFF;
+	return apu_read(port & 3);
+}
+
+void snespi_apu_write(int port, uint8_t value){
+	if (apu_ops != NULL)
+		apu_write(port & 3, value);
+}
+
+static int loadBuffer(const uint8_t *spc, size_t length){
+	int res;
+
+	if (apu_ops == NULL && snespi_apu_open() < 0)
+		return -1;
+
+	g_playing = 1;
+	g_exit_now = 0;
+	res = LoadAPU_buffer(spc, length);
+	return res < 0 ? -1 : 0;
+}
+
+int snespi_apu_load(const char *spcPath){
+	spcfile f;
+	int res;
+
+	if (spcfile_open(&f, spcPath) < 0)
+		return -1;
+	res = loadBuffer(f.data, f.len);
+	spcfile_close(&f);
+	return res;
+}
+
+int snespi_apu_load_buffer(const uint8_t *spc, size_t length){
+	return loadBuffer(spc, length);
+}
+
+void snespi_set_verbose(int verbose){
+	g_verbose = verbose;
+}
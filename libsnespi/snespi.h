@@ -0,0 +1,93 @@
+/*
+ * snespi.h:
+ *      libsnespi - cart reader and APU access for the SNES-Pi boards.
+ *
+ * This is the stable C ABI used by the Python bindings (snespi.py) and
+ * other programs. Only plain integers, byte buffers and strings cross
+ * it. Functions are only ever added; SNESPI_ABI_VERSION is bumped when
+ * that happens, and snespi_abi_version() reports the version of the
+ * library actually loaded.
+ *
+ * The library keeps a single cart bus and a single APU, it is not
+ * thread safe.
+ ***********************************************************************
+ */
+
+#ifndef _snespi_h__
+#define _snespi_h__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNESPI_ABI_VERSION	2
+
+#if defined(__GNUC__)
+#define SNESPI_API __attribute__((visibility("default")))
+#else
+#define SNESPI_API
+#endif
+
+/* cart reader boards */
+#define SNESPI_BUS_SPI	0	/* MCP23S17 board, SPI channel 0 */
+#define SNESPI_BUS_I2C	1	/* MCP23017 board, /dev/i2c-<channel> */
+#define SNESPI_BUS_GPIO	2	/* flip-flop board */
+
+/* cart control lines for snespi_cart_controls(). A set bit asserts the
+ * line (drives /RD, /RESET, /WR, /CS low, switches the cart power on). */
+#define SNESPI_RD	0x01
+#define SNESPI_RESET	0x02
+#define SNESPI_WR	0x04
+#define SNESPI_CS	0x08
+#define SNESPI_POWER	0x10
+
+SNESPI_API unsigned int snespi_abi_version(void);
+SNESPI_API const char *snespi_version_string(void);
+
+/* Cart reader. All functions returning int return 0 on success and -1
+ * on error. The mapping argument is 1 for LoROM and 0 for HiROM, as
+ * used by the rippers. snespi_cart_controls, snespi_sram_write and
+ * snespi_cart_write_reg return once their writes are on the bus, the
+ * address setting calls may leave them queued until the next read. */
+SNESPI_API int snespi_cart_open(int bus, int channel);
+SNESPI_API void snespi_cart_close(void);
+SNESPI_API int snespi_cart_trace(const char *path);
+SNESPI_API void snespi_cart_controls(uint8_t lines);
+
+SNESPI_API void snespi_cart_goto_bank(uint8_t bank);
+SNESPI_API void snespi_cart_goto_addr(int32_t addr, int isLowROM);
+SNESPI_API uint8_t snespi_cart_read_data(void);
+SNESPI_API uint8_t snespi_cart_read_offset(uint32_t offset, int isLowROM);
+SNESPI_API int snespi_cart_read(uint32_t offset, int isLowROM, uint8_t *buf, uint32_t length);
+
+SNESPI_API int snespi_sram_read(int isLowROM, uint8_t *buf, uint32_t length);
+SNESPI_API int snespi_sram_write(int isLowROM, const uint8_t *buf, uint32_t length);
+
+/* Raw expander registers, for setup code that is not worth moving into
+ * the library (chip is the hardware address, 0x20 - 0x27). */
+SNESPI_API void snespi_cart_write_reg(uint8_t chip, uint8_t reg, uint8_t value);
+SNESPI_API uint8_t snespi_cart_read_reg(uint8_t chip, uint8_t reg);
+
+/* APU, through the same io layer apuplay uses. snespi_apu_open() uses
+ * the GPIO board, snespi_apu_open_bus() takes the bus names of
+ * apuplay -m ("spi", "i2c[:dev]", "gpio"). Since ABI 2. Before an
+ * open, snespi_apu_read() returns 0xFF and the reset and write do
+ * nothing. */
+SNESPI_API int snespi_apu_open(void);
+SNESPI_API int snespi_apu_open_bus(const char *bus);
+SNESPI_API void snespi_apu_close(void);
+SNESPI_API void snespi_apu_reset(void);
+SNESPI_API uint8_t snespi_apu_read(int port);
+SNESPI_API void snespi_apu_write(int port, uint8_t value);
+SNESPI_API int snespi_apu_load(const char *spcPath);
+SNESPI_API int snespi_apu_load_buffer(const uint8_t *spc, size_t length);
+SNESPI_API void snespi_set_verbose(int verbose);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _snespi_h__
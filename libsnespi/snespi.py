@@ -0,0 +1,190 @@
+"""
+snespi.py - ctypes bindings for libsnespi (see snespi.h)
+
+Every byte of a rip, an SRAM transfer or an APU upload moves inside the
+C library; Python only issues one call per bank or per file.
+
+The library is looked up next to this file first, then through the
+normal dynamic loader path. SNESPI_LIB overrides both.
+"""
+
+import ctypes
+import os
+
+ABI_VERSION = 2
+
+BUS_SPI = 0
+BUS_I2C = 1
+BUS_GPIO = 2
+
+RD = 0x01
+RESET = 0x02
+WR = 0x04
+CS = 0x08
+POWER = 0x10
+
+
+def _load():
+ here = os.path.dirname(os.path.abspath(__file__))
+ candidates = [os.environ.get("SNESPI_LIB"),
+               os.path.join(here, "libsnespi.so.1"),
+               "libsnespi.so.1"]
+ for name in candidates:
+  if not name:
+   continue
+  try:
+   lib = ctypes.CDLL(name)
+  except OSError:
+   continue
+  if lib.snespi_abi_version() < ABI_VERSION:
+   raise ImportError("%s is too old (ABI %d, need %d)" % (name, lib.snespi_abi_version(), ABI_VERSION))
+  return lib
+ raise ImportError("libsnespi.so.1 not found, run make in libsnespi/")
+
+_lib = _load()
+
+_u8 = ctypes.c_uint8
+_u32 = ctypes.c_uint32
+_buf = ctypes.c_char_p
+
+_protos = {
+ "snespi_abi_version":      (ctypes.c_uint, []),
+ "snespi_version_string":   (ctypes.c_char_p, []),
+ "snespi_cart_open":        (ctypes.c_int, [ctypes.c_int, ctypes.c_int]),
+ "snespi_cart_close":       (None, []),
+ "snespi_cart_trace":       (ctypes.c_int, [ctypes.c_char_p]),
+ "snespi_cart_controls":    (None, [_u8]),
+ "snespi_cart_goto_bank":   (None, [_u8]),
+ "snespi_cart_goto_addr":   (None, [ctypes.c_int32, ctypes.c_int]),
+ "snespi_cart_read_data":   (_u8, []),
+ "snespi_cart_read_offset": (_u8, [_u32, ctypes.c_int]),
+ "snespi_cart_read":        (ctypes.c_int, [_u32, ctypes.c_int, _buf, _u32]),
+ "snespi_sram_read":        (ctypes.c_int, [ctypes.c_int, _buf, _u32]),
+ "snespi_sram_write":       (ctypes.c_int, [ctypes.c_int, _buf, _u32]),
+ "snespi_cart_write_reg":   (None, [_u8, _u8, _u8]),
+ "snespi_cart_read_reg":    (_u8, [_u8, _u8]),
+ "snespi_apu_open":         (ctypes.c_int, []),
+ "snespi_apu_open_bus":     (ctypes.c_int, [ctypes.c_char_p]),
+ "snespi_apu_close":        (None, []),
+ "snespi_apu_reset":        (None, []),
+ "snespi_apu_read":         (_u8, [ctypes.c_int]),
+ "snespi_apu_write":        (None, [ctypes.c_int, _u8]),
+ "snespi_apu_load":         (ctypes.c_int, [ctypes.c_char_p]),
+ "snespi_apu_load_buffer":  (ctypes.c_int, [_buf, ctypes.c_size_t]),
+ "snespi_set_verbose":      (None, [ctypes.c_int]),
+}
+
+for _name, (_res, _args) in _protos.items():
+ _func = getattr(_lib, _name)
+ _func.restype = _res
+ _func.argtypes = _args
+
+
+def _path(path):
+ if not isinstance(path, bytes):
+  path = path.encode()
+ return path
+
+def _check(res, what):
+ if res < 0:
+  raise IOError("snespi: " + what + " failed")
+
+def version():
+ return _lib.snespi_version_string().decode()
+
+# ------------ Cart reader ------------------------------------------------
+
+def cart_open(bus, channel=0):
+ _check(_lib.snespi_cart_open(bus, channel), "cart_open")
+
+def cart_close():
+ _lib.snespi_cart_close()
+
+def cart_trace(path):
+ _check(_lib.snespi_cart_trace(_path(path)), "cart_trace")
+
+def controls(lines):
+ _lib.snespi_cart_controls(lines)
+
+def goto_bank(bank):
+ _lib.snespi_cart_goto_bank(bank)
+
+def goto_addr(addr, isLowROM):
+ _lib.snespi_cart_goto_addr(addr, isLowROM)
+
+def read_data():
+ return _lib.snespi_cart_read_data()
+
+def read_offset(offset, isLowROM):
+ return _lib.snespi_cart_read_offset(offset, isLowROM)
+
+def read(offset, isLowROM, length):
+ """Reads length bytes of ROM starting at a linear offset."""
+ buf = ctypes.create_string_buffer(length)
+ _check(_lib.snespi_cart_read(offset, isLowROM, buf, length), "cart_read")
+ return buf.raw
+
+def sram_read(isLowROM, length):
+ buf = ctypes.create_string_buffer(length)
+ _check(_lib.snespi_sram_read(isLowROM, buf, length), "sram_read")
+ return buf.raw
+
+def sram_write(isLowROM, data):
+ _check(_lib.snespi_sram_write(isLowROM, data, len(data)), "sram_write")
+
+def write_reg(chip, reg, value):
+ _lib.snespi_cart_write_reg(chip, reg, value)
+
+def read_reg(chip, reg):
+ return _lib.snespi_cart_read_reg(chip, reg)
+
+
+class SMBus(object):
+ """Drop-in for the smbus.SMBus calls of the MCP23017 scripts."""
+ def __init__(self, bus=1):
+  self.bus = bus
+
+ def write_byte_data(self, chip, reg, value):
+  write_reg(chip, reg, value)
+
+ def read_byte_data(self, chip, reg):
+  return read_reg(chip, reg)
+
+
+class MCP23S17(object):
+ """Drop-in for the RPiMCP23S17 register calls of the SPI script."""
+ def __init__(self, chip):
+  self.chip = chip
+
+ def _writeRegister(self, reg, value):
+  write_reg(self.chip, reg, value)
+
+ def _readRegister(self, reg):
+  return read_reg(self.chip, reg)
+
+# ------------ APU --------------------------------------------------------
+
+def apu_open(bus=""):
+ """bus is "spi", "i2c[:dev]" or "gpio"; empty selects the GPIO board."""
+ _check(_lib.snespi_apu_open_bus(_path(bus)), "apu_open")
+
+def apu_close():
+ _lib.snespi_apu_close()
+
+def apu_reset():
+ _lib.snespi_apu_reset()
+
+def apu_read(port):
+ return _lib.snespi_apu_read(port)
+
+def apu_write(port, value):
+ _lib.snespi_apu_write(port, value)
+
+def apu_load(path):
+ _check(_lib.snespi_apu_load(_path(path)), "apu_load")
+
+def apu_load_buffer(data):
+ _check(_lib.snespi_apu_load_buffer(data, len(data)), "apu_load_buffer")
+
+def set_verbose(verbose):
+ _lib.snespi_set_verbose(1 if verbose else 0)